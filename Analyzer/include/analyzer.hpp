@@ -17,8 +17,10 @@
 //! - Variable lifetime (last_use)
 // - Use / Export declarations.
 // - Check for iterator (must be list / dict)
-// Optimizes:
-// -
+// Optimizes (see optimizer.hpp):
+// - Constant expressions folding
+// - Algebraic identities
+// - Compile time evaluation of pure functions
 class Analyzer
 {
     // Stores the main file name.
@@ -0,0 +1,59 @@
+#ifndef EVALUATOR_HPP
+#define EVALUATOR_HPP
+
+#include "../../Parser/include/rules.hpp"
+#include "../../Parser/include/block.hpp"
+
+// Defines the maximum number of statements and expressions an evaluated call can run.
+#define EVALUATE_MAX_STEPS 100000
+// Defines the maximum number of nested calls of an evaluated call.
+#define EVALUATE_MAX_DEPTH 64
+// Defines the maximum number of elements of a list returned by an evaluated call.
+#define EVALUATE_MAX_ELEMENTS 1024
+
+// Forward declaration.
+class Optimizer;
+
+// The Evaluator class runs the calls to the pure functions of a module at compile time.
+// The values are literals (and lists of values), and the operations are folded by the
+// optimizer, so they give the same result as the virtual machine. A call is only
+// evaluated if everything it runs is supported and can't fail: printing, globals,
+// objects, dictionaries or an error at runtime make the evaluation fail. The list literals
+// are shared constants that the calls that run at runtime could modify, so they are only
+// read in place (the lists that are stored are the ones created by the call).
+class Evaluator
+{
+    // Stores the optimizer (to fold the operations).
+    Optimizer &optimizer;
+    // Stores the top level functions of the module.
+    const std::unordered_map<symbol_t, std::shared_ptr<FunctionValue>> &functions;
+    // Stores the variables of each scope and the first scope of the current call.
+    std::vector<std::unordered_map<symbol_t, std::shared_ptr<Expression>>> scopes;
+    size_t base = 0;
+    // Stores the lists that are constants of the program (the virtual machine shares them, so they can't be modified).
+    std::vector<std::shared_ptr<Expression>> constants;
+    // Stores the number of steps and the nested calls.
+    size_t steps = 0, depth = 0;
+    // Stores the value returned by the current call (it's returning if set).
+    bool returning = false;
+    std::shared_ptr<Expression> returned;
+    // Returns the variable of the current call (nullptr if it's not set).
+    std::shared_ptr<Expression> *get_variable(const symbol_t symbol);
+    // Calls a function. Returns false if it fails.
+    bool call(const std::shared_ptr<FunctionValue> &fun, const std::vector<std::shared_ptr<Expression>> &arguments, std::shared_ptr<Expression> &result);
+    bool call(const std::shared_ptr<Call> &call, std::shared_ptr<Expression> &result);
+    // Runs the statements in a new scope. Returns false if it fails.
+    bool execute(const std::vector<std::shared_ptr<Statement>> &code);
+    bool execute(const std::shared_ptr<Statement> &statement);
+    // Returns the value of an expression (nullptr if it fails).
+    std::shared_ptr<Expression> evaluate(const std::shared_ptr<Expression> &expression);
+    // Returns the value of an expression whose value isn't stored, so it can be a list literal (nullptr if it fails).
+    std::shared_ptr<Expression> evaluate_literal(const std::shared_ptr<Expression> &expression);
+    public:
+        Evaluator(Optimizer &optimizer, const std::unordered_map<symbol_t, std::shared_ptr<FunctionValue>> &functions)
+            : optimizer(optimizer), functions(functions) {}
+        // Returns the value a function returns given the arguments, if it can be stored as a constant (nullptr otherwise).
+        std::shared_ptr<Expression> evaluate(const std::shared_ptr<FunctionValue> &fun, const std::vector<std::shared_ptr<Expression>> &arguments);
+};
+
+#endif
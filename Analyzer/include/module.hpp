@@ -5,6 +5,10 @@
 #include "../../Parser/include/type.hpp"
 #include "../../Parser/include/block.hpp"
 
+// Defines the maximum number of instances of a generic function (it stops the instances
+// of a generic function that calls itself with a different type from never ending).
+#define GENERIC_MAX_INSTANCES 64
+
 // The Module class is used to analyze a module.
 class Module
 {
@@ -14,9 +18,17 @@ class Module
     std::shared_ptr<std::vector<std::shared_ptr<Statement>>> code;
     // Stores the blocks used while analyzing the module.
     std::vector<std::shared_ptr<Block>> blocks;
+    // Determines if the module is precompiled but the interface of a module it uses changed.
+    bool outdated = false;
+    // Stores the instances of the generic functions declared in the module that were
+    // analyzed while the module was analyzed. They're added to its code at the end.
+    std::vector<std::shared_ptr<Statement>> instances;
     // Return variable if needs to be checked. Only 1 can exist since
     // it can only analyze 1 function at a time.
     std::shared_ptr<Type> return_type;
+    // Determines if the body of a generic function is being checked. The checks
+    // that depend on its type parameters are left to its instances.
+    bool generic = false;
     // Analyzes the TLDs given a list of top level delcarations.
     void analyze_tld();
     // Analyzes the given top level declaration.
@@ -47,6 +59,14 @@ class Module
         const std::shared_ptr<FunctionValue> &fun,
         const std::vector<std::shared_ptr<Declaration>> &additionals = std::vector<std::shared_ptr<Declaration>>()
     );
+    // Checks the declaration and the body of a generic function (the parts that don't depend
+    // on its type parameters, the rest is checked for each instance).
+    void analyze_generic(const std::shared_ptr<FunctionValue> &fun);
+    // Infers the types of the type parameters of the generic function a call targets
+    // from its arguments and makes the call target the instance of those types.
+    void instantiate(const std::shared_ptr<Call> &call, const std::shared_ptr<FunctionValue> &generic);
+    // Analyzes an instance of a generic function declared in the module.
+    void analyze_instance(const std::shared_ptr<FunctionValue> &fun);
     // Declares a variable to the most top level block.
     void declare(const std::shared_ptr<Declaration> &dec, const std::shared_ptr<Node> &node = std::shared_ptr<Node>());
     // Check if the given module have all the classes defined.
@@ -54,11 +74,13 @@ class Module
     public:
         // Stores the main block of that module.
         std::shared_ptr<Block> main_block = std::make_shared<Block>();
+        // Stores the hash of the exported signatures of the module.
+        uint64_t interface = 0;
         // Main module constructor
-        Module(std::shared_ptr<const std::string> &file)
+        Module(const std::shared_ptr<const std::string> &file)
             : file(file) {}
         // Analyzes the module and adds it's entry to the modules symbol table.
-        std::shared_ptr<Block> analyze(std::shared_ptr<std::vector<std::shared_ptr<Statement>>> &code, const bool require_main = false);
+        std::shared_ptr<Block> analyze(const std::shared_ptr<std::vector<std::shared_ptr<Statement>>> &code, const bool require_main = false);
 };
 
 // Module symbol table.
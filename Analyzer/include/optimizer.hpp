@@ -0,0 +1,70 @@
+#ifndef OPTIMIZER_HPP
+#define OPTIMIZER_HPP
+
+#include "../../Parser/include/rules.hpp"
+#include "../../Parser/include/block.hpp"
+#include "evaluator.hpp"
+#include <unordered_set>
+
+// Defines the maximum length of a string created by folding a repetition.
+#define FOLD_MAX_STRING_LENGTH 1024
+
+// The Optimizer class rewrites the analyzed AST of a module.
+//
+// Optimizes:
+// - Constant unary, binary, cast and logical expressions (folded into literals).
+// - Algebraic identities (x + 0, x - 0, x * 1, x + "", x and true, x or false, !!x, -(-x), +x).
+// - Dead code (statements after a return, constant false conditions and stores
+//   to local variables that are never read). The compiler skips the dead statements.
+// - Calls to the pure functions of the module with constant arguments (evaluated
+//   at compile time, see evaluator.hpp).
+//
+// With --memoize, it also marks the pure functions whose parameters and return value
+// are scalars, so the virtual machine caches their results.
+class Optimizer
+{
+    friend class Evaluator;
+    // Stores the top level functions of the module.
+    std::unordered_map<symbol_t, std::shared_ptr<FunctionValue>> functions;
+    // Stores the blocks of the function being optimized.
+    std::vector<std::shared_ptr<Block>> blocks;
+    // Stores the number of reads of the local variables of the function being optimized.
+    std::unordered_map<const BlockVariableType *, size_t> reads;
+    // Returns a local variable of the function being optimized (nullptr if it's not local).
+    BlockVariableType *get_variable(const symbol_t symbol);
+    // Counts the reads of the local variables.
+    void count_reads(const std::vector<std::shared_ptr<Statement>> &code, const std::shared_ptr<Block> &block);
+    void count_reads(const std::shared_ptr<Statement> &statement);
+    void count_reads(const std::shared_ptr<Expression> &expression);
+    // Marks the dead statements of a function.
+    void eliminate_dead_code(const std::shared_ptr<FunctionValue> &fun);
+    void eliminate_dead_code(std::vector<std::shared_ptr<Statement>> &code, const std::shared_ptr<Block> &block);
+    // Optimizes the statements of a block.
+    void optimize(std::vector<std::shared_ptr<Statement>> &code);
+    void optimize(std::vector<std::shared_ptr<Statement>> &code, const std::shared_ptr<Block> &block);
+    // Optimizes the expressions of a statement.
+    void optimize(const std::shared_ptr<Statement> &statement);
+    // Optimizes an expression, replacing it if it can be simplified.
+    void optimize(std::shared_ptr<Expression> &expression);
+    // Returns the folded unary, binary, cast or logical expression (nullptr if it can't be folded).
+    std::shared_ptr<Expression> fold(const std::shared_ptr<Unary> &unary);
+    std::shared_ptr<Expression> fold(const std::shared_ptr<Binary> &binary);
+    std::shared_ptr<Expression> fold(const std::shared_ptr<Cast> &cast);
+    std::shared_ptr<Expression> fold(const std::shared_ptr<Logical> &logical);
+    // Returns the value of a call evaluated at compile time (nullptr if it can't be evaluated).
+    std::shared_ptr<Expression> evaluate(const std::shared_ptr<Call> &call);
+    // Stores the top level functions that are assumed to be deterministic while marking the memoized ones.
+    std::unordered_set<const FunctionValue *> deterministic;
+    // Marks the functions whose results can be cached (see FunctionValue::memoize).
+    void mark_memoized();
+    // Determines if the statements or the expression only depend on the local variables and
+    // have no side effects, other than modifying the local variables and the lists they create.
+    bool is_deterministic(const std::vector<std::shared_ptr<Statement>> &code, const std::shared_ptr<Block> &block);
+    bool is_deterministic(const std::shared_ptr<Statement> &statement);
+    bool is_deterministic(const std::shared_ptr<Expression> &expression);
+    public:
+        // Optimizes the code of an analyzed module.
+        void optimize_module(std::vector<std::shared_ptr<Statement>> &code);
+};
+
+#endif
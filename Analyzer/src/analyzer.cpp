@@ -16,7 +16,7 @@ std::shared_ptr<Block> Analyzer::analyze(std::shared_ptr<std::vector<std::shared
     p.parse(destination);
     if (logger->show_ast) Parser::debug_ast(*destination);
     // Create the main module
-    Module m = Module(destination->front()->file);
+    Module m = Module(logger->file(destination->front()->file));
     // Analyze the module
     m.analyze(destination, true);
     // Return the main module
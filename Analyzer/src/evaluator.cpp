@@ -0,0 +1,303 @@
+#include "../include/evaluator.hpp"
+#include "../include/optimizer.hpp"
+#include "../../Parser/include/type.hpp"
+#include <algorithm>
+
+#define AS(node, type) (std::static_pointer_cast<type>(node))
+
+// Determines if the expression is a literal.
+static bool is_literal(const std::shared_ptr<Expression> &rule)
+{
+    return rule->rule == RULE_INTEGER || rule->rule == RULE_FLOAT || rule->rule == RULE_BOOLEAN || rule->rule == RULE_STRING;
+}
+
+// Creates a literal integer.
+static std::shared_ptr<Expression> make_integer(const std::shared_ptr<Node> &rule, const int64_t value)
+{
+    std::shared_ptr<Expression> literal = std::make_shared<Integer>(rule->file, rule->line, rule->column, value);
+    literal->resolved_type = std::make_shared<Type>(VALUE_INT);
+    return literal;
+}
+
+std::shared_ptr<Expression> Evaluator::evaluate(const std::shared_ptr<FunctionValue> &fun, const std::vector<std::shared_ptr<Expression>> &arguments)
+{
+    std::shared_ptr<Expression> result;
+    if (!this->call(fun, arguments, result) || !result) return nullptr;
+    if (is_literal(result)) return result;
+    // Only the lists of literals are returned, since the elements that are lists would be shared.
+    if (result->rule != RULE_LIST) return nullptr;
+    const std::vector<std::shared_ptr<Expression>> &values = AS(result, List)->value;
+    if (values.size() > EVALUATE_MAX_ELEMENTS || !std::all_of(values.begin(), values.end(), is_literal)) return nullptr;
+    return result;
+}
+
+std::shared_ptr<Expression> *Evaluator::get_variable(const symbol_t symbol)
+{
+    for (size_t scope = this->scopes.size(); scope-- > this->base;) {
+        const auto variable = this->scopes[scope].find(symbol);
+        if (variable != this->scopes[scope].end()) return &variable->second;
+    }
+    return nullptr;
+}
+
+bool Evaluator::call(const std::shared_ptr<FunctionValue> &fun, const std::vector<std::shared_ptr<Expression>> &arguments, std::shared_ptr<Expression> &result)
+{
+    if (fun->precompiled || this->depth == EVALUATE_MAX_DEPTH || fun->parameters.size() != arguments.size()) return false;
+    // The parameters are in their own scope, and the body in a new one.
+    const size_t base = this->base;
+    this->base = this->scopes.size();
+    this->scopes.emplace_back();
+    for (size_t i = 0; i < arguments.size(); i++) this->scopes.back()[symbols->find(fun->parameters[i]->name)] = arguments[i];
+    this->depth++;
+    const bool executed = this->execute(fun->body);
+    this->depth--;
+    this->scopes.resize(this->base);
+    this->base = base;
+    result = this->returned;
+    this->returning = false;
+    this->returned = nullptr;
+    return executed;
+}
+
+bool Evaluator::call(const std::shared_ptr<Call> &call, std::shared_ptr<Expression> &result)
+{
+    // Only the top level functions are called (and not the local variables with the same name).
+    if (call->is_method || call->target->rule != RULE_VARIABLE) return false;
+    const symbol_t symbol = AS(call->target, Variable)->symbol;
+    const auto fun = this->functions.find(symbol);
+    if (fun == this->functions.end() || this->get_variable(symbol)) return false;
+    std::vector<std::shared_ptr<Expression>> arguments;
+    for (const std::shared_ptr<Expression> &argument : call->arguments) {
+        arguments.push_back(this->evaluate(argument));
+        if (!arguments.back()) return false;
+    }
+    return this->call(fun->second, arguments, result) && (!call->has_return || result);
+}
+
+bool Evaluator::execute(const std::vector<std::shared_ptr<Statement>> &code)
+{
+    this->scopes.emplace_back();
+    bool executed = true;
+    for (const std::shared_ptr<Statement> &statement : code) {
+        if (statement->dead) continue;
+        if (!this->execute(statement)) {
+            executed = false;
+            break;
+        }
+        if (this->returning) break;
+    }
+    this->scopes.pop_back();
+    return executed;
+}
+
+bool Evaluator::execute(const std::shared_ptr<Statement> &statement)
+{
+    if (++this->steps > EVALUATE_MAX_STEPS) return false;
+    switch (statement->rule) {
+        case RULE_EXPRESSION_STATEMENT: {
+            const std::shared_ptr<Expression> &expression = AS(statement, ExpressionStatement)->expression;
+            // The calls to functions without a return value are statements.
+            std::shared_ptr<Expression> result;
+            if (expression->rule == RULE_CALL) return this->call(AS(expression, Call), result);
+            return this->evaluate(expression) != nullptr;
+        }
+        case RULE_DECLARATION: {
+            const std::shared_ptr<Declaration> dec = AS(statement, Declaration);
+            std::shared_ptr<Expression> value;
+            if (dec->initializer) value = this->evaluate(dec->initializer);
+            else {
+                // The variable is set to the constant with the default value of its type.
+                switch (dec->type->type) {
+                    case VALUE_INT: { value = std::make_shared<Integer>(dec->file, dec->line, dec->column, 0); break; }
+                    case VALUE_FLOAT: { value = std::make_shared<Float>(dec->file, dec->line, dec->column, 0.0); break; }
+                    case VALUE_BOOL: { value = std::make_shared<Boolean>(dec->file, dec->line, dec->column, false); break; }
+                    case VALUE_STRING: { value = std::make_shared<String>(dec->file, dec->line, dec->column, ""); break; }
+                    case VALUE_LIST: {
+                        std::shared_ptr<List> list = std::make_shared<List>(dec->file, dec->line, dec->column, std::vector<std::shared_ptr<Expression>>());
+                        list->type = dec->type;
+                        this->constants.push_back(list);
+                        value = list;
+                        break;
+                    }
+                    default: { return false; }
+                }
+                value->resolved_type = dec->type;
+            }
+            if (!value) return false;
+            this->scopes.back()[symbols->find(dec->name)] = value;
+            return true;
+        }
+        case RULE_RETURN: {
+            const std::shared_ptr<Expression> &value = AS(statement, Return)->value;
+            if (value && !(this->returned = this->evaluate(value))) return false;
+            this->returning = true;
+            return true;
+        }
+        case RULE_IF: {
+            const std::shared_ptr<If> rif = AS(statement, If);
+            const std::shared_ptr<Expression> condition = this->evaluate(rif->condition);
+            if (!condition || condition->rule != RULE_BOOLEAN) return false;
+            return this->execute(AS(condition, Boolean)->value ? rif->then_branch : rif->else_branch);
+        }
+        case RULE_WHILE: {
+            const std::shared_ptr<While> rwhile = AS(statement, While);
+            for (;;) {
+                const std::shared_ptr<Expression> condition = this->evaluate(rwhile->condition);
+                if (!condition || condition->rule != RULE_BOOLEAN) return false;
+                if (!AS(condition, Boolean)->value) return true;
+                if (!this->execute(rwhile->body)) return false;
+                if (this->returning) return true;
+            }
+        }
+        case RULE_FOR: {
+            const std::shared_ptr<For> rfor = AS(statement, For);
+            const std::shared_ptr<Expression> iterator = this->evaluate_literal(rfor->iterator);
+            if (!iterator || iterator->rule != RULE_LIST) return false;
+            const std::vector<std::shared_ptr<Expression>> &values = AS(iterator, List)->value;
+            const symbol_t variable = symbols->find(rfor->variable), index = rfor->index != "" ? symbols->find(rfor->index) : SYMBOL_NONE;
+            // The length is checked in every iteration and the index is the loop counter (as it's compiled).
+            for (int64_t i = 0; i >= 0 && static_cast<size_t>(i) < values.size(); i++) {
+                if (++this->steps > EVALUATE_MAX_STEPS) return false;
+                this->scopes.emplace_back();
+                this->scopes.back()[variable] = values[i];
+                if (index != SYMBOL_NONE) this->scopes.back()[index] = make_integer(rfor, i);
+                const bool executed = this->execute(rfor->body);
+                if (index != SYMBOL_NONE) {
+                    const std::shared_ptr<Expression> counter = this->scopes.back()[index];
+                    if (counter->rule != RULE_INTEGER) return false;
+                    i = AS(counter, Integer)->value;
+                }
+                this->scopes.pop_back();
+                if (!executed) return false;
+                if (this->returning) return true;
+            }
+            return true;
+        }
+        default: { return false; }
+    }
+}
+
+std::shared_ptr<Expression> Evaluator::evaluate_literal(const std::shared_ptr<Expression> &expression)
+{
+    if (expression->rule != RULE_LIST) return this->evaluate(expression);
+    if (++this->steps > EVALUATE_MAX_STEPS) return nullptr;
+    // The elements are copied out of the list, so they must be literals (and not lists that would be shared).
+    const std::shared_ptr<List> literal = AS(expression, List);
+    if (!std::all_of(literal->value.begin(), literal->value.end(), is_literal)) return nullptr;
+    std::shared_ptr<List> list = std::make_shared<List>(literal->file, literal->line, literal->column, literal->value);
+    list->type = literal->type;
+    // The constant can't be modified.
+    this->constants.push_back(list);
+    return list;
+}
+
+std::shared_ptr<Expression> Evaluator::evaluate(const std::shared_ptr<Expression> &expression)
+{
+    if (++this->steps > EVALUATE_MAX_STEPS) return nullptr;
+    switch (expression->rule) {
+        case RULE_INTEGER:
+        case RULE_FLOAT:
+        case RULE_BOOLEAN:
+        case RULE_STRING: { return expression; }
+        case RULE_VARIABLE: {
+            std::shared_ptr<Expression> *variable = this->get_variable(AS(expression, Variable)->symbol);
+            return variable ? *variable : nullptr;
+        }
+        case RULE_GROUP: { return this->evaluate(AS(expression, Group)->expression); }
+        case RULE_UNARY: {
+            std::shared_ptr<Unary> unary = std::make_shared<Unary>(*AS(expression, Unary));
+            if (!(unary->right = this->evaluate(unary->right))) return nullptr;
+            return this->optimizer.fold(unary);
+        }
+        case RULE_BINARY: {
+            std::shared_ptr<Binary> binary = std::make_shared<Binary>(*AS(expression, Binary));
+            if (binary->type == BINARY_ADD_LIST) {
+                // The result is a new list, so the operands can be list literals.
+                if (!(binary->left = this->evaluate_literal(binary->left)) || !(binary->right = this->evaluate_literal(binary->right))) return nullptr;
+                const std::shared_ptr<List> left = AS(binary->left, List), right = AS(binary->right, List);
+                std::vector<std::shared_ptr<Expression>> values = left->value;
+                values.insert(values.end(), right->value.begin(), right->value.end());
+                std::shared_ptr<List> list = std::make_shared<List>(binary->file, binary->line, binary->column, values);
+                list->type = left->type;
+                return list;
+            }
+            if (!(binary->left = this->evaluate(binary->left)) || !(binary->right = this->evaluate(binary->right))) return nullptr;
+            const std::shared_ptr<Expression> result = this->optimizer.fold(binary);
+            return result && is_literal(result) ? result : nullptr;
+        }
+        case RULE_LOGICAL: {
+            std::shared_ptr<Logical> logical = std::make_shared<Logical>(*AS(expression, Logical));
+            if (!(logical->left = this->evaluate(logical->left)) || !(logical->right = this->evaluate(logical->right))) return nullptr;
+            return this->optimizer.fold(logical);
+        }
+        case RULE_CAST: {
+            std::shared_ptr<Cast> cast = std::make_shared<Cast>(*AS(expression, Cast));
+            if (!(cast->expression = this->evaluate_literal(cast->expression))) return nullptr;
+            if (cast->cast_type == CAST_LIST_INT) return make_integer(cast, static_cast<int64_t>(AS(cast->expression, List)->value.size()));
+            return this->optimizer.fold(cast);
+        }
+        case RULE_ACCESS: {
+            const std::shared_ptr<Access> access = AS(expression, Access);
+            const std::shared_ptr<Expression> target = this->evaluate_literal(access->target), index = this->evaluate(access->index);
+            if (!target || !index || index->rule != RULE_INTEGER || AS(index, Integer)->value < 0) return nullptr;
+            const size_t position = AS(index, Integer)->value;
+            switch (access->type) {
+                case ACCESS_LIST: { return position < AS(target, List)->value.size() ? AS(target, List)->value[position] : nullptr; }
+                case ACCESS_STRING: {
+                    const std::string &string = AS(target, String)->value;
+                    if (position >= string.length()) return nullptr;
+                    std::shared_ptr<Expression> literal = std::make_shared<String>(access->file, access->line, access->column, std::string(1, string[position]));
+                    literal->resolved_type = std::make_shared<Type>(VALUE_STRING);
+                    return literal;
+                }
+                default: { return nullptr; }
+            }
+        }
+        case RULE_ASSIGN: {
+            const std::shared_ptr<Assign> assign = AS(expression, Assign);
+            const std::shared_ptr<Expression> value = this->evaluate(assign->value);
+            if (!value) return nullptr;
+            if (assign->type == ASSIGN_VALUE && assign->target->rule == RULE_VARIABLE) {
+                // The globals can't be modified.
+                std::shared_ptr<Expression> *variable = this->get_variable(AS(assign->target, Variable)->symbol);
+                if (!variable) return nullptr;
+                return *variable = value;
+            }
+            if (assign->type != ASSIGN_ACCESS || AS(assign->target, Access)->type != ACCESS_LIST) return nullptr;
+            const std::shared_ptr<Access> access = AS(assign->target, Access);
+            const std::shared_ptr<Expression> target = this->evaluate(access->target), index = this->evaluate(access->index);
+            if (!target || !index || index->rule != RULE_INTEGER || AS(index, Integer)->value < 0) return nullptr;
+            std::vector<std::shared_ptr<Expression>> &values = AS(target, List)->value;
+            const size_t position = AS(index, Integer)->value;
+            if (position >= values.size() || std::find(this->constants.begin(), this->constants.end(), target) != this->constants.end()) return nullptr;
+            return values[position] = value;
+        }
+        case RULE_CALL: {
+            std::shared_ptr<Expression> result;
+            return this->call(AS(expression, Call), result) ? result : nullptr;
+        }
+        case RULE_LIST: {
+            // A list literal is a constant the virtual machine shares between the calls, and the calls
+            // that are not evaluated could have modified it, so it can only be used by the expressions
+            // that read its elements without storing it (see Evaluator::evaluate_literal).
+            return nullptr;
+        }
+        case RULE_RANGE: {
+            const std::shared_ptr<Range> range = AS(expression, Range);
+            const std::shared_ptr<Expression> start = this->evaluate(range->start), end = this->evaluate(range->end);
+            if (!start || !end || start->rule != RULE_INTEGER || end->rule != RULE_INTEGER) return nullptr;
+            if (range->inclusive && AS(end, Integer)->value == INT64_MAX) return nullptr;
+            const int64_t from = AS(start, Integer)->value, to = AS(end, Integer)->value + range->inclusive;
+            if (to > from && static_cast<uint64_t>(to - from) > EVALUATE_MAX_STEPS - this->steps) return nullptr;
+            std::vector<std::shared_ptr<Expression>> values;
+            for (int64_t i = from; i < to; i++) values.push_back(make_integer(range, i));
+            this->steps += values.size();
+            std::shared_ptr<List> list = std::make_shared<List>(range->file, range->line, range->column, values);
+            list->type = std::make_shared<Type>(VALUE_LIST, std::make_shared<Type>(VALUE_INT));
+            return list;
+        }
+        default: { return nullptr; }
+    }
+}
+
+#undef AS
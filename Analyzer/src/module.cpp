@@ -1,27 +1,155 @@
 #include "../include/module.hpp"
+#include "../include/optimizer.hpp"
+#include "../../Parser/include/parser.hpp"
 #include "../../Logger/include/logger.hpp"
 #include <algorithm>
 
 #define NODE(rule) (std::static_pointer_cast<Node>(rule))
 #define ADD_LOG(rule, msg) (logger->add_entity(rule->file, rule->line, rule->column, msg))
 #define ADD_NULL_LOG(file_ptr, msg) (logger->add_entity(file_ptr, 0, 0, msg))
-#define MOD(file) (*file + ":")
+#define MOD(file_id) (*logger->file(file_id) + ":")
+// Determines if a type depends on the type parameters of the generic function being checked.
+#define GENERIC(type) (this->generic && uses_type_parameters(type))
 
 // Stores the modules symbol table.
 std::unordered_map<std::string, Module> modules;
 
+// Stores the modules being analyzed, to avoid cyclic imports.
+static std::vector<std::string> module_stack;
+
 // Determines the main function name.
 static const std::string main_fun = "main";
 
 // Determines the name of the self variable.
 static const std::string self_var = "self";
 
-std::shared_ptr<Block> Module::analyze(std::shared_ptr<std::vector<std::shared_ptr<Statement>>> &code, const bool require_main)
+// Returns the signature of a function.
+static std::string signature(const std::shared_ptr<FunctionValue> &fun)
+{
+    std::string result = "fun " + fun->name;
+    if (fun->generic) {
+        result += "<";
+        for (const std::string &parameter : fun->generic->parameters) result += parameter + ",";
+        result += ">";
+    }
+    result += "(";
+    for (const std::shared_ptr<Declaration> &parameter : fun->parameters) {
+        result += (parameter->type ? parameter->type->to_string() : "?") + ",";
+    }
+    return result + ")" + (fun->return_type ? ": " + fun->return_type->to_string() : "");
+}
+
+// Returns the hash of the signatures exported by a module. The modules using
+// it only need to be compiled again if it changes.
+static uint64_t interface_hash(const std::vector<std::shared_ptr<Statement>> &code)
 {
+    std::string signatures;
+    for (const std::shared_ptr<Statement> &tld : code) {
+        if (tld->rule != RULE_EXPORT) continue;
+        const std::shared_ptr<Statement> &statement = std::static_pointer_cast<Export>(tld)->statement;
+        switch (statement->rule) {
+            case RULE_FUNCTION: {
+                signatures += signature(std::static_pointer_cast<Function>(statement)->value) + "\n";
+                break;
+            }
+            case RULE_CLASS: {
+                const std::shared_ptr<Class> c = std::static_pointer_cast<Class>(statement);
+                // The members are in declaration order, since it's the order of the object properties.
+                signatures += "class " + c->name + " {\n";
+                for (const std::shared_ptr<Statement> &member : c->body) {
+                    if (member->rule == RULE_FUNCTION) {
+                        signatures += signature(std::static_pointer_cast<Function>(member)->value) + "\n";
+                    } else if (member->rule == RULE_DECLARATION) {
+                        const std::shared_ptr<Declaration> dec = std::static_pointer_cast<Declaration>(member);
+                        signatures += dec->name + ": " + (dec->type ? dec->type->to_string() : "?") + "\n";
+                    }
+                }
+                signatures += "}\n";
+                break;
+            }
+            default: { /* Nothing else is exported */ }
+        }
+    }
+    return hash_bytes(signatures.data(), signatures.length());
+}
+
+// Determines if a type uses the given type parameter.
+static bool uses_type_parameter(const std::shared_ptr<Type> &type, const std::string &parameter)
+{
+    if (!type) return false;
+    if (type->type == VALUE_NO_TYPE) return type->class_name == parameter;
+    for (const std::shared_ptr<Type> &inner : type->parameters) {
+        if (uses_type_parameter(inner, parameter)) return true;
+    }
+    return uses_type_parameter(type->inner_type, parameter);
+}
+
+// Determines if a type uses any type parameter.
+static bool uses_type_parameters(const Type &type)
+{
+    if (type.type == VALUE_NO_TYPE) return !type.class_name.empty();
+    for (const std::shared_ptr<Type> &inner : type.parameters) {
+        if (uses_type_parameters(*inner)) return true;
+    }
+    return type.inner_type && uses_type_parameters(*type.inner_type);
+}
+
+// Returns the type of an expression of a generic function that depends on its type parameters
+// but can't be known until it's instantiated (like the result of an operation on them).
+static std::shared_ptr<Type> generic_type()
+{
+    std::shared_ptr<Type> type = std::make_shared<Type>(VALUE_NO_TYPE);
+    type->class_name = "?";
+    return type;
+}
+
+// Binds the type parameters used in the parameter type to the matching parts of
+// the argument type. Returns false if the argument doesn't match the parameter.
+static bool unify(const std::shared_ptr<Type> &parameter, const Type &argument, std::unordered_map<std::string, std::shared_ptr<Type>> &types)
+{
+    if (parameter->type == VALUE_NO_TYPE) {
+        // It's a type parameter, so the first argument binds it and the rest must match.
+        if (argument.type == VALUE_NO_TYPE) return false;
+        const auto bound = types.find(parameter->class_name);
+        if (bound != types.end()) return bound->second->same_as(argument);
+        std::shared_ptr<Type> type = std::make_shared<Type>();
+        argument.copy_to(type);
+        types[parameter->class_name] = type;
+        return true;
+    }
+    if (parameter->type != argument.type) return false;
+    switch (parameter->type) {
+        case VALUE_LIST:
+        case VALUE_DICT: { return argument.inner_type && unify(parameter->inner_type, *argument.inner_type, types); }
+        case VALUE_FUN: {
+            if (parameter->parameters.size() != argument.parameters.size()) return false;
+            if (static_cast<bool>(parameter->inner_type) != static_cast<bool>(argument.inner_type)) return false;
+            for (size_t i = 0; i < parameter->parameters.size(); i++) {
+                if (!unify(parameter->parameters[i], *argument.parameters[i], types)) return false;
+            }
+            return !parameter->inner_type || unify(parameter->inner_type, *argument.inner_type, types);
+        }
+        case VALUE_OBJECT: { return parameter->class_name == argument.class_name; }
+        default: { return true; }
+    }
+}
+
+std::shared_ptr<Block> Module::analyze(const std::shared_ptr<std::vector<std::shared_ptr<Statement>>> &code, const bool require_main)
+{
+    module_stack.push_back(*this->file);
     // Set the AST source.
     this->code = code;
+    this->interface = interface_hash(*code);
     // Analyze the TLDs.
     this->analyze_tld();
+    if (this->outdated) {
+        // The precompiled module can't be used, so it's parsed again with the function bodies.
+        this->code->clear();
+        Parser(this->file).parse(this->code, false);
+        this->main_block = std::make_shared<Block>();
+        this->outdated = false;
+        this->analyze_tld();
+    }
     if (require_main) {
         // Check if the main function exists
         BlockVariableType *var = this->main_block->get_variable(main_fun);
@@ -41,8 +169,14 @@ std::shared_ptr<Block> Module::analyze(std::shared_ptr<std::vector<std::shared_p
     }
     // Analyze the code.
     this->analyze_code();
+    // Add the instances of the generic functions.
+    this->code->insert(this->code->end(), this->instances.begin(), this->instances.end());
+    this->instances.clear();
+    // Optimize the analyzed code.
+    Optimizer().optimize_module(*this->code);
     // Add it to the modules symbol table.
     modules.insert({{ std::string(*this->file), *this }});
+    module_stack.pop_back();
     // Return the main block.
     return this->main_block;
 }
@@ -53,11 +187,21 @@ void Module::analyze_tld(const std::shared_ptr<Statement> &tld, const bool set_e
     switch (tld->rule) {
         case RULE_USE: {
             std::shared_ptr<Use> use = std::static_pointer_cast<Use>(tld);
+            // The module may still be parsing in the module loader.
+            use->wait();
             if (modules.find(std::string(*use->module)) == modules.end()) {
+                if (std::find(module_stack.begin(), module_stack.end(), *use->module) != module_stack.end()) {
+                    ADD_LOG(use, "Cyclic import detected. Can't use '" + *use->module + "'. Cyclic imports are not available in nuua.");
+                    exit(logger->crash());
+                }
                 use->block = Module(use->module).analyze(use->code);
             } else {
                 use->block = modules.at(std::string(*use->module)).main_block;
             }
+            // A precompiled module must be compiled again if the interface it was compiled with changed.
+            const uint64_t interface = modules.at(std::string(*use->module)).interface;
+            if (use->interface != 0 && use->interface != interface) this->outdated = true;
+            use->interface = interface;
             // if (blocks.find(use->module) == blocks.end()) use->block = this->analyze_tld(use->code);
             // else use->block = blocks[use->module];
             // Check if the imports are exported first.
@@ -230,6 +374,10 @@ void Module::analyze_class_tld(const std::shared_ptr<Statement> &tld, const std:
                 ADD_LOG(fun, "'" + fun->name + "' was already declared. Function overloading is not currently implemented in this version of nuua.");
                 exit(logger->crash());
             }
+            if (fun->generic) {
+                ADD_LOG(fun, "The method '" + fun->name + "' can't be generic. Only top level functions can have type parameters.");
+                exit(logger->crash());
+            }
             block->set_variable(fun->name, { std::make_shared<Type>(f), NODE(fun), false, true });
             break;
         }
@@ -261,7 +409,8 @@ void Module::analyze_code(
             Type type = Type(list->value[0], &this->blocks);
             for (size_t i = 1; i < list->value.size(); i++) {
                 this->analyze_code(list->value[i]);
-                if (!Type(list->value[i], &this->blocks).same_as(type)) {
+                Type element = Type(list->value[i], &this->blocks);
+                if (!element.same_as(type) && !GENERIC(element) && !GENERIC(type)) {
                     ADD_LOG(list, "Lists must have the same type. This list can only contain '" + type.to_string() + "' based on the first element");
                     exit(logger->crash());
                 }
@@ -278,7 +427,8 @@ void Module::analyze_code(
             this->analyze_code(dict->value[dict->key_order[0]]);
             Type type = Type(dict->value[dict->key_order[0]], &this->blocks);
             for (size_t i = 1; i < dict->key_order.size(); i++) {
-                if (!Type(dict->value[dict->key_order[i]], &this->blocks).same_as(type)) {
+                Type element = Type(dict->value[dict->key_order[i]], &this->blocks);
+                if (!element.same_as(type) && !GENERIC(element) && !GENERIC(type)) {
                     this->analyze_code(dict->value[dict->key_order[i]]);
                     ADD_LOG(dict->value[dict->key_order[i]], "Dictionaries must have the same type. This dictionary can only contain '" + type.to_string() + "' based on the first element");
                     exit(logger->crash());
@@ -327,7 +477,7 @@ void Module::analyze_code(
             std::shared_ptr<Cast> cast = std::static_pointer_cast<Cast>(rule);
             this->analyze_code(cast->expression);
             Type type = Type(cast->expression, &this->blocks);
-            if (!type.cast(cast->type, &cast->cast_type)) {
+            if (!GENERIC(type) && !GENERIC(*cast->type) && !type.cast(cast->type, &cast->cast_type)) {
                 ADD_LOG(cast, "Casting from '" + type.to_string() + "' to '" + cast->type->to_string() + "' is not valid");
                 exit(logger->crash());
             }
@@ -337,6 +487,10 @@ void Module::analyze_code(
             std::shared_ptr<Unary> unary = std::static_pointer_cast<Unary>(rule);
             this->analyze_code(unary->right);
             Type type = Type(unary->right, &this->blocks);
+            if (GENERIC(type)) {
+                unary->resolved_type = generic_type();
+                break;
+            }
             if (!type.unary(unary->op, nullptr, &unary->type)) {
                 // The binary operation cannot be performed.
                 ADD_LOG(unary, "Unary expression " + unary->op.to_type_string() + "'" + type.to_string() + "' does not match any known unary operation.");
@@ -350,6 +504,10 @@ void Module::analyze_code(
             this->analyze_code(binary->right);
             Type left_type = Type(binary->left, &this->blocks);
             Type right_type = Type(binary->right, &this->blocks);
+            if (GENERIC(left_type) || GENERIC(right_type)) {
+                binary->resolved_type = generic_type();
+                break;
+            }
             if (!left_type.binary(binary->op, &right_type, nullptr, &binary->type)) {
                 // The binary operation cannot be performed.
                 ADD_LOG(binary, "Binary expression '" + left_type.to_string() + "' " + binary->op.to_type_string() + " '" + right_type.to_string() + "' does not match any known binary operation.");
@@ -361,11 +519,15 @@ void Module::analyze_code(
             // Check if the variable has been declared.
             std::shared_ptr<Variable> var = std::static_pointer_cast<Variable>(rule);
             for (size_t i = this->blocks.size() - 1;; i--) {
-                BlockVariableType *v = this->blocks[i]->get_variable(var->name);
+                BlockVariableType *v = this->blocks[i]->get_variable(var->symbol);
                 if (v) {
                     // Variable found!
-                    // Declare last use.
-                    v->last_use = NODE(rule);
+                    if (v->node->rule == RULE_FUNCTION && std::static_pointer_cast<FunctionValue>(v->node)->generic) {
+                        ADD_LOG(var, "The generic function '" + var->name + "' can only be called, since its types depend on the arguments.");
+                        exit(logger->crash());
+                    }
+                    // Declare last use (the body of a generic function is only compiled for its instances).
+                    if (!this->generic) v->last_use = NODE(rule);
                     break;
                 } else if (i == 0) {
                     ADD_LOG(var, "Undeclared variable '" + var->name + "'");
@@ -400,7 +562,7 @@ void Module::analyze_code(
             // Make sure the types match.
             Type vtype = Type(assign->value, &this->blocks);
             Type ttype = Type(assign->target, &this->blocks);
-            if (!ttype.same_as(vtype)) {
+            if (!ttype.same_as(vtype) && !GENERIC(ttype) && !GENERIC(vtype)) {
                 ADD_LOG(assign, "Assignment type missmatch. Expected '" + ttype.to_string() + "' but got '" + vtype.to_string() + "'");
                 exit(logger->crash());
             }
@@ -411,12 +573,12 @@ void Module::analyze_code(
             this->analyze_code(logical->left);
             this->analyze_code(logical->right);
             Type left_type = Type(logical->left, &this->blocks);
-            if (left_type.type != VALUE_BOOL ) {
+            if (left_type.type != VALUE_BOOL && !GENERIC(left_type)) {
                 ADD_LOG(logical->left, "Expected a boolean in the 'logical' left side. Got '" + left_type.to_string() + "'");
                 exit(logger->crash());
             }
             Type right_type = Type(logical->right, &this->blocks);
-            if (right_type.type != VALUE_BOOL ) {
+            if (right_type.type != VALUE_BOOL && !GENERIC(right_type)) {
                 ADD_LOG(logical->right, "Expected a boolean in the 'logical' right side. Got '" + right_type.to_string() + "'");
                 exit(logger->crash());
             }
@@ -424,8 +586,23 @@ void Module::analyze_code(
         }
         case RULE_CALL: {
             std::shared_ptr<Call> call = std::static_pointer_cast<Call>(rule);
-            this->analyze_code(call->target, false, &call->is_method);
+            bool generic_call = false;
+            if (call->target->rule == RULE_VARIABLE) {
+                // Calls to a generic function call the instance of the argument types.
+                BlockVariableType *var = Block::get_single_variable(std::static_pointer_cast<Variable>(call->target)->symbol, &this->blocks);
+                if (var && var->node->rule == RULE_FUNCTION && std::static_pointer_cast<FunctionValue>(var->node)->generic) {
+                    this->instantiate(call, std::static_pointer_cast<FunctionValue>(var->node));
+                    // The generic functions called by the one being checked are not instantiated.
+                    generic_call = this->generic;
+                }
+            }
+            if (!generic_call) this->analyze_code(call->target, false, &call->is_method);
             Type type = Type(call->target, &this->blocks);
+            if (GENERIC(type) && type.type == VALUE_NO_TYPE) {
+                for (const std::shared_ptr<Expression> &argument : call->arguments) this->analyze_code(argument);
+                call->resolved_type = generic_type();
+                break;
+            }
             // Check if it's callable.
             if (type.type != VALUE_FUN) {
                 ADD_LOG(call, "The call target is not callable. Got '" + type.to_string() + "'");
@@ -454,7 +631,7 @@ void Module::analyze_code(
             for (size_t i = 0; i < call->arguments.size(); i++) {
                 this->analyze_code(call->arguments[i]);
                 Type arg = Type(call->arguments[i], &this->blocks);
-                if (!arg.same_as(type.parameters[i])) {
+                if (!arg.same_as(type.parameters[i]) && !GENERIC(arg) && !GENERIC(*type.parameters[i])) {
                     ADD_LOG(
                         call->arguments[i],
                         "Invalid type in function call. Argument "
@@ -475,10 +652,14 @@ void Module::analyze_code(
             this->analyze_code(access->target);
             Type itype = Type(access->index, &this->blocks);
             Type ttype = Type(access->target, &this->blocks);
+            if (GENERIC(ttype) && ttype.type == VALUE_NO_TYPE) {
+                access->resolved_type = generic_type();
+                break;
+            }
             switch (ttype.type) {
                 case VALUE_STRING: {
                     // The variable is a list. The index must be an integer.
-                    if (itype.type != VALUE_INT) {
+                    if (itype.type != VALUE_INT && !GENERIC(itype)) {
                         ADD_LOG(access->index, "String access index must be an integer. Got '" + itype.to_string() + "'");
                         exit(logger->crash());
                     }
@@ -488,7 +669,7 @@ void Module::analyze_code(
                 }
                 case VALUE_LIST: {
                     // The variable is a list. The index must be an integer.
-                    if (itype.type != VALUE_INT) {
+                    if (itype.type != VALUE_INT && !GENERIC(itype)) {
                         ADD_LOG(access->index, "List access index must be an integer. Got '" + itype.to_string() + "'");
                         exit(logger->crash());
                     }
@@ -498,7 +679,7 @@ void Module::analyze_code(
                 }
                 case VALUE_DICT: {
                     // The variable is a list. The index must be an integer.
-                    if (itype.type != VALUE_STRING) {
+                    if (itype.type != VALUE_STRING && !GENERIC(itype)) {
                         ADD_LOG(access->index, "Dictionary access index must be a string. Got '" + itype.to_string() + "'");
                         exit(logger->crash());
                     }
@@ -518,7 +699,7 @@ void Module::analyze_code(
             if (slice->start) {
                 this->analyze_code(slice->start);
                 Type t = Type(slice->start, &this->blocks);
-                if (t.type != VALUE_INT) {
+                if (t.type != VALUE_INT && !GENERIC(t)) {
                     ADD_LOG(slice->start, "Slice start index must be an 'int'. Got '" + t.to_string() + "'");
                     exit(logger->crash());
                 }
@@ -526,7 +707,7 @@ void Module::analyze_code(
             if (slice->end) {
                 this->analyze_code(slice->end);
                 Type t = Type(slice->end, &this->blocks);
-                if (t.type != VALUE_INT) {
+                if (t.type != VALUE_INT && !GENERIC(t)) {
                     ADD_LOG(slice->end, "Slice end index must be an 'int'. Got '" + t.to_string() + "'");
                     exit(logger->crash());
                 }
@@ -534,14 +715,14 @@ void Module::analyze_code(
             if (slice->step) {
                 this->analyze_code(slice->step);
                 Type t = Type(slice->step, &this->blocks);
-                if (t.type != VALUE_INT) {
+                if (t.type != VALUE_INT && !GENERIC(t)) {
                     ADD_LOG(slice->step, "Slice step index must be an 'int'. Got '" + t.to_string() + "'");
                     exit(logger->crash());
                 }
             }
             this->analyze_code(slice->target);
             Type t = Type(slice->target, &this->blocks);
-            if (t.type != VALUE_LIST && t.type != VALUE_STRING) {
+            if (t.type != VALUE_LIST && t.type != VALUE_STRING && !GENERIC(t)) {
                 ADD_LOG(slice->target, "The slice target must be either 'list' or 'string'. Got '" + t.to_string() + "'");
                 exit(logger->crash());
             }
@@ -553,12 +734,12 @@ void Module::analyze_code(
             this->analyze_code(range->start);
             this->analyze_code(range->end);
             Type start_type = Type(range->start, &this->blocks);
-            if (start_type.type != VALUE_INT) {
+            if (start_type.type != VALUE_INT && !GENERIC(start_type)) {
                 ADD_LOG(range->start, "The range start index must be 'int'. Got '" + start_type.to_string() + "'");
                 exit(logger->crash());
             }
             Type end_type = Type(range->end, &this->blocks);
-            if (end_type.type != VALUE_INT) {
+            if (end_type.type != VALUE_INT && !GENERIC(end_type)) {
                 ADD_LOG(range->start, "The range end index must be 'int'. Got '" + end_type.to_string() + "'");
                 exit(logger->crash());
             }
@@ -569,6 +750,10 @@ void Module::analyze_code(
             // Analyze the type of the prop object.
             this->analyze_code(prop->object);
             Type t = Type(prop->object, &this->blocks);
+            if (GENERIC(t) && t.type == VALUE_NO_TYPE) {
+                prop->resolved_type = generic_type();
+                break;
+            }
             if (t.type != VALUE_OBJECT) {
                 ADD_LOG(prop->object, "Invalid property access. Tying to get a property of a non-object.");
                 exit(logger->crash());
@@ -577,7 +762,7 @@ void Module::analyze_code(
             const BlockClassType *ct = this->main_block->get_class(t.class_name);
             prop->c = std::static_pointer_cast<Class>(ct->node);
             // Check if the prop exists in the object class.
-            BlockVariableType * var = ct->block->get_variable(prop->name);
+            BlockVariableType * var = ct->block->get_variable(prop->symbol);
             if (!var) {
                 ADD_LOG(prop->object, "The class '" + t.class_name + "' does not have a '" + prop->name + "' property.");
                 exit(logger->crash());
@@ -669,7 +854,8 @@ void Module::analyze_code(const std::shared_ptr<Statement> &rule, bool no_declar
         }
         case RULE_FUNCTION: {
             std::shared_ptr<FunctionValue> fun = std::static_pointer_cast<Function>(rule)->value;
-            this->analyze_function(fun);
+            if (fun->generic) this->analyze_generic(fun);
+            else this->analyze_function(fun);
             break;
         }
 
@@ -701,7 +887,7 @@ void Module::analyze_code(const std::shared_ptr<Statement> &rule, bool no_declar
                 // Get the type of the initializer,
                 Type type = Type(dec->initializer, &this->blocks);
                 // Check the types to know if it can be initialized.
-                if (!dec->type->same_as(type)) {
+                if (!dec->type->same_as(type) && !GENERIC(*dec->type) && !GENERIC(type)) {
                     ADD_LOG(dec,
                         "Incompatible types: Expected '"
                         + dec->type->to_string()
@@ -726,7 +912,7 @@ void Module::analyze_code(const std::shared_ptr<Statement> &rule, bool no_declar
             }
             this->analyze_code(ret->value);
             Type type = Type(ret->value, &this->blocks);
-            if (!type.same_as(*this->return_type)) {
+            if (!type.same_as(*this->return_type) && !GENERIC(type) && !GENERIC(*this->return_type)) {
                 ADD_LOG(ret,
                     "Return type does not match with function type. Expected '"
                     + this->return_type->to_string()
@@ -758,7 +944,7 @@ void Module::analyze_code(const std::shared_ptr<Statement> &rule, bool no_declar
             std::shared_ptr<If> rif = std::static_pointer_cast<If>(rule);
             this->analyze_code(rif->condition);
             Type type = Type(rif->condition, &this->blocks);
-            if (type.type != VALUE_BOOL) {
+            if (type.type != VALUE_BOOL && !GENERIC(type)) {
                 ADD_LOG(rif->condition, "Expected a boolean in the 'if' condition. Got '" + type.to_string() + "'");
                 exit(logger->crash());
             }
@@ -770,7 +956,7 @@ void Module::analyze_code(const std::shared_ptr<Statement> &rule, bool no_declar
             std::shared_ptr<While> rwhile = std::static_pointer_cast<While>(rule);
             this->analyze_code(rwhile->condition);
             Type type = Type(rwhile->condition, &this->blocks);
-            if (type.type != VALUE_BOOL) {
+            if (type.type != VALUE_BOOL && !GENERIC(type)) {
                 ADD_LOG(rwhile->condition, "Expected a boolean in the 'while' condition. Got '" + type.to_string() + "'");
                 exit(logger->crash());
             }
@@ -783,6 +969,19 @@ void Module::analyze_code(const std::shared_ptr<Statement> &rule, bool no_declar
             std::vector<std::shared_ptr<Declaration>> decs;
             // Declare the value of each iteration.
             std::shared_ptr<Type> vtype = std::make_shared<Type>(rfor->iterator, &this->blocks); // Types (they are saved on the heap since they will be saved)
+            if (GENERIC(*vtype) && vtype->type == VALUE_NO_TYPE) {
+                // The iterator is a type parameter, so the types of the variables depend on it.
+                decs.push_back(std::make_shared<Declaration>(
+                    rfor->file, rfor->line, rfor->column, rfor->variable, generic_type(), std::shared_ptr<Expression>())
+                );
+                if (rfor->index != "") {
+                    decs.push_back(std::make_shared<Declaration>(
+                        rfor->file, rfor->line, rfor->column, rfor->index, generic_type(), std::shared_ptr<Expression>())
+                    );
+                }
+                rfor->block = this->analyze_code(rfor->body, decs, NODE(rfor));
+                break;
+            }
             // Check iterator.
             if (vtype->type != VALUE_LIST && vtype->type != VALUE_DICT && vtype->type != VALUE_STRING) {
                 ADD_LOG(rfor->iterator, "The 'for' iterator is not iterable. It must be either 'list', 'dictionary' or 'string' but got '" + vtype->to_string() + "'");
@@ -837,10 +1036,134 @@ void Module::check_classes(const std::vector<std::string> &classes, const std::s
     }
 }
 
+void Module::analyze_generic(const std::shared_ptr<FunctionValue> &fun)
+{
+    const std::vector<std::string> &type_parameters = fun->generic->parameters;
+    for (size_t i = 0; i < type_parameters.size(); i++) {
+        const std::string &type_parameter = type_parameters[i];
+        if (std::find(type_parameters.begin(), type_parameters.begin() + i, type_parameter) != type_parameters.begin() + i) {
+            ADD_LOG(fun, "The type parameter '" + type_parameter + "' is already declared in the generic function '" + fun->name + "'.");
+            exit(logger->crash());
+        }
+        if (Type(type_parameter).type != VALUE_OBJECT || this->main_block->has_class(type_parameter)) {
+            ADD_LOG(fun, "The type parameter '" + type_parameter + "' of the generic function '" + fun->name + "' can't be named as a type.");
+            exit(logger->crash());
+        }
+        // The types are inferred from the arguments, so every type parameter needs a parameter that uses it.
+        bool used = false;
+        for (const std::shared_ptr<Declaration> &parameter : fun->parameters) used = used || uses_type_parameter(parameter->type, type_parameter);
+        if (!used) {
+            ADD_LOG(fun, "The type parameter '" + type_parameter + "' of the generic function '" + fun->name + "' must be used by the type of a parameter.");
+            exit(logger->crash());
+        }
+    }
+    // Check the function body once. The checks that depend on the type parameters are done for each instance.
+    this->generic = true;
+    this->analyze_function(fun);
+    this->generic = false;
+    // Only the instances are optimized and compiled.
+    fun->body.clear();
+    fun->block.reset();
+}
+
+void Module::instantiate(const std::shared_ptr<Call> &call, const std::shared_ptr<FunctionValue> &generic)
+{
+    // Check the arguments and infer the types of the type parameters.
+    if (call->arguments.size() != generic->parameters.size()) {
+        ADD_LOG(
+            call,
+            "Function arguments does not match with the definition. Expected "
+            + std::to_string(generic->parameters.size())
+            + " arguments, but got "
+            + std::to_string(call->arguments.size())
+            + "."
+        );
+        exit(logger->crash());
+    }
+    std::unordered_map<std::string, std::shared_ptr<Type>> types;
+    for (size_t i = 0; i < call->arguments.size(); i++) {
+        this->analyze_code(call->arguments[i]);
+        Type arg = Type(call->arguments[i], &this->blocks);
+        if (GENERIC(arg)) continue;
+        if (!unify(generic->parameters[i]->type, arg, types)) {
+            ADD_LOG(
+                call->arguments[i],
+                "Invalid type in generic function call. Argument "
+                    + std::to_string(i + 1)
+                    + " must be "
+                    + generic->parameters[i]->type->to_string()
+                    + ", got "
+                    + arg.to_string()
+            );
+            exit(logger->crash());
+        }
+    }
+    // The instance of a call in a generic function depends on its type parameters.
+    if (this->generic) return;
+    // The instance is named after the types, so each one is only analyzed and compiled once.
+    std::string name = generic->name + "<";
+    for (const std::string &type_parameter : generic->generic->parameters) name += types.at(type_parameter)->to_string() + ",";
+    name.back() = '>';
+    // It's declared in the module of the generic function, since its body uses that module.
+    std::shared_ptr<const std::string> file = logger->file(generic->file);
+    Module &module = *file == *this->file ? *this : modules.at(*file);
+    std::shared_ptr<FunctionValue> instance;
+    const auto found = generic->generic->instances.find(name);
+    if (found != generic->generic->instances.end()) instance = found->second;
+    else {
+        if (generic->generic->instances.size() >= GENERIC_MAX_INSTANCES) {
+            ADD_LOG(call, "The generic function '" + generic->name + "' has too many instances. Make sure it doesn't call itself with different types.");
+            exit(logger->crash());
+        }
+        for (const auto &[_, type] : types) {
+            for (const std::string &c : type->classes_used()) {
+                if (module.main_block->has_class(c)) continue;
+                ADD_LOG(call, "The generic function '" + generic->name + "' can't use the class '" + c + "' since it's not declared in " + *file);
+                exit(logger->crash());
+            }
+        }
+        instance = Parser(file).instantiate(*generic->generic, types);
+        instance->name = name;
+        instance->instance = true;
+        generic->generic->instances[name] = instance;
+        // It's declared before its body is analyzed, since it may call itself.
+        module.main_block->set_variable(name, { std::make_shared<Type>(std::make_shared<Function>(instance)), NODE(instance) });
+        // The errors in the body of the instance are reported with the call that requires it.
+        ADD_LOG(call->target, "In instance " + name + " required here");
+        module.analyze_instance(instance);
+        logger->pop_entity();
+    }
+    if (!this->blocks.front()->get_variable(name)) {
+        this->blocks.front()->set_variable(name, { std::make_shared<Type>(std::make_shared<Function>(instance)), NODE(instance) });
+    }
+    call->target = std::make_shared<Variable>(call->target->file, call->target->line, call->target->column, name, symbols->find(name));
+}
+
+void Module::analyze_instance(const std::shared_ptr<FunctionValue> &fun)
+{
+    // The function may be analyzed while other function of any module is, so it's analyzed in its own scope.
+    std::vector<std::shared_ptr<Block>> blocks = { this->main_block };
+    std::shared_ptr<Type> return_type;
+    std::swap(this->blocks, blocks);
+    std::swap(this->return_type, return_type);
+    this->analyze_function(fun);
+    std::swap(this->blocks, blocks);
+    std::swap(this->return_type, return_type);
+    this->instances.push_back(std::make_shared<Function>(fun));
+    // The module was already analyzed, so the instance is optimized and added to its code now.
+    if (std::find(module_stack.begin(), module_stack.end(), *this->file) == module_stack.end()) {
+        Optimizer().optimize_module(this->instances);
+        this->code->insert(this->code->end(), this->instances.begin(), this->instances.end());
+        this->instances.clear();
+    }
+}
+
 void Module::analyze_function(const std::shared_ptr<FunctionValue> &fun, const std::vector<std::shared_ptr<Declaration>> &additionals)
 {
     // Analyze the function parameters.
     for (const std::shared_ptr<Declaration> &parameter : fun->parameters) this->analyze_code(std::static_pointer_cast<Statement>(parameter), true);
+    // The body of a precompiled function was analyzed when it was compiled.
+    if (fun->precompiled) goto continue_rule_function;
     // Check if there's a top level return on the function.
     if (fun->return_type) {
         this->return_type = fun->return_type;
@@ -877,3 +1200,4 @@ void Module::analyze_function(const std::shared_ptr<FunctionValue> &fun, const s
 #undef ADD_LOG
 #undef ADD_NULL_LOG
 #undef MOD
+#undef GENERIC
@@ -0,0 +1,760 @@
+#include "../include/optimizer.hpp"
+#include "../../Parser/include/type.hpp"
+#include "../../Logger/include/logger.hpp"
+#include <algorithm>
+
+#define AS(node, type) (std::static_pointer_cast<type>(node))
+#define INT(node) (AS(node, Integer)->value)
+#define FLOAT(node) (AS(node, Float)->value)
+#define BOOL(node) (AS(node, Boolean)->value)
+#define STRING(node) (AS(node, String)->value)
+#define IS_INT(node, v) ((node)->rule == RULE_INTEGER && INT(node) == (v))
+#define IS_FLOAT(node, v) ((node)->rule == RULE_FLOAT && FLOAT(node) == (v))
+#define IS_STRING(node, v) ((node)->rule == RULE_STRING && STRING(node) == (v))
+// Integer arithmetic wraps around like the virtual machine does.
+#define WRAP(a, op, b) (static_cast<int64_t>(static_cast<uint64_t>(a) op static_cast<uint64_t>(b)))
+
+// Creates the literals that replace a folded expression.
+static std::shared_ptr<Expression> make_integer(const std::shared_ptr<Expression> &rule, const int64_t value)
+{
+    std::shared_ptr<Expression> literal = std::make_shared<Integer>(rule->file, rule->line, rule->column, value);
+    literal->resolved_type = std::make_shared<Type>(VALUE_INT);
+    return literal;
+}
+
+static std::shared_ptr<Expression> make_float(const std::shared_ptr<Expression> &rule, const double value)
+{
+    std::shared_ptr<Expression> literal = std::make_shared<Float>(rule->file, rule->line, rule->column, value);
+    literal->resolved_type = std::make_shared<Type>(VALUE_FLOAT);
+    return literal;
+}
+
+static std::shared_ptr<Expression> make_boolean(const std::shared_ptr<Expression> &rule, const bool value)
+{
+    std::shared_ptr<Expression> literal = std::make_shared<Boolean>(rule->file, rule->line, rule->column, value);
+    literal->resolved_type = std::make_shared<Type>(VALUE_BOOL);
+    return literal;
+}
+
+static std::shared_ptr<Expression> make_string(const std::shared_ptr<Expression> &rule, const std::string &value)
+{
+    std::shared_ptr<Expression> literal = std::make_shared<String>(rule->file, rule->line, rule->column, value);
+    literal->resolved_type = std::make_shared<Type>(VALUE_STRING);
+    return literal;
+}
+
+// Determines if the expression is a literal.
+static bool is_literal(const std::shared_ptr<Expression> &rule)
+{
+    return rule->rule == RULE_INTEGER || rule->rule == RULE_FLOAT || rule->rule == RULE_BOOLEAN || rule->rule == RULE_STRING;
+}
+
+// Returns the expression inside the groups.
+static std::shared_ptr<Expression> ungroup(std::shared_ptr<Expression> rule)
+{
+    while (rule->rule == RULE_GROUP) rule = AS(rule, Group)->expression;
+    return rule;
+}
+
+// Determines if a type is a scalar (stored by value).
+static bool is_scalar(const std::shared_ptr<Type> &type)
+{
+    return type && (type->type == VALUE_INT || type->type == VALUE_FLOAT || type->type == VALUE_BOOL || type->type == VALUE_STRING);
+}
+
+// Determines if an expression has no side effects and can't fail at runtime.
+static bool is_pure(const std::shared_ptr<Expression> &expression)
+{
+    switch (expression->rule) {
+        case RULE_INTEGER:
+        case RULE_FLOAT:
+        case RULE_BOOLEAN:
+        case RULE_STRING:
+        case RULE_VARIABLE: { return true; }
+        case RULE_GROUP: { return is_pure(AS(expression, Group)->expression); }
+        case RULE_UNARY: { return is_pure(AS(expression, Unary)->right); }
+        case RULE_CAST: { return is_pure(AS(expression, Cast)->expression); }
+        case RULE_LOGICAL: { return is_pure(AS(expression, Logical)->left) && is_pure(AS(expression, Logical)->right); }
+        case RULE_BINARY: {
+            std::shared_ptr<Binary> binary = AS(expression, Binary);
+            // Divisions may fail.
+            if (binary->type >= BINARY_DIV_INT && binary->type <= BINARY_DIV_LIST_INT) return false;
+            return is_pure(binary->left) && is_pure(binary->right);
+        }
+        case RULE_LIST: {
+            for (const std::shared_ptr<Expression> &value : AS(expression, List)->value) if (!is_pure(value)) return false;
+            return true;
+        }
+        case RULE_DICTIONARY: {
+            for (const auto &[key, value] : AS(expression, Dictionary)->value) if (!is_pure(value)) return false;
+            return true;
+        }
+        case RULE_OBJECT: {
+            for (const auto &[name, argument] : AS(expression, Object)->arguments) if (!is_pure(argument)) return false;
+            return true;
+        }
+        default: { return false; }
+    }
+}
+
+// Compares two literals given the binary comparison.
+template <typename T>
+static bool compare(const BinaryType type, const T &a, const T &b)
+{
+    switch (type) {
+        case BINARY_EQ_INT: case BINARY_EQ_FLOAT: case BINARY_EQ_STRING: case BINARY_EQ_BOOL: { return a == b; }
+        case BINARY_NEQ_INT: case BINARY_NEQ_FLOAT: case BINARY_NEQ_STRING: case BINARY_NEQ_BOOL: { return a != b; }
+        case BINARY_HT_INT: case BINARY_HT_FLOAT: case BINARY_HT_STRING: case BINARY_HT_BOOL: { return a > b; }
+        case BINARY_HTE_INT: case BINARY_HTE_FLOAT: case BINARY_HTE_STRING: case BINARY_HTE_BOOL: { return a >= b; }
+        case BINARY_LT_INT: case BINARY_LT_FLOAT: case BINARY_LT_STRING: case BINARY_LT_BOOL: { return a < b; }
+        default: { return a <= b; }
+    }
+}
+
+// Repeats a string like the virtual machine does.
+static std::string repeat(const std::string &string, const int64_t times)
+{
+    std::string result;
+    for (int64_t i = 0; i < times; i++) result += string;
+    return result;
+}
+
+void Optimizer::optimize_module(std::vector<std::shared_ptr<Statement>> &code)
+{
+    for (std::shared_ptr<Statement> node : code) {
+        if (node->rule == RULE_EXPORT) node = AS(node, Export)->statement;
+        if (node->rule == RULE_FUNCTION) this->functions[symbols->find(AS(node, Function)->value->name)] = AS(node, Function)->value;
+    }
+    this->optimize(code);
+    if (logger->memoize) this->mark_memoized();
+}
+
+void Optimizer::optimize(std::vector<std::shared_ptr<Statement>> &code)
+{
+    for (const std::shared_ptr<Statement> &statement : code) this->optimize(statement);
+}
+
+void Optimizer::optimize(std::vector<std::shared_ptr<Statement>> &code, const std::shared_ptr<Block> &block)
+{
+    if (block) this->blocks.push_back(block);
+    this->optimize(code);
+    if (block) this->blocks.pop_back();
+}
+
+void Optimizer::optimize(const std::shared_ptr<Statement> &statement)
+{
+    switch (statement->rule) {
+        case RULE_PRINT: { this->optimize(AS(statement, Print)->expression); break; }
+        case RULE_EXPRESSION_STATEMENT: { this->optimize(AS(statement, ExpressionStatement)->expression); break; }
+        case RULE_DECLARATION: { this->optimize(AS(statement, Declaration)->initializer); break; }
+        case RULE_RETURN: { this->optimize(AS(statement, Return)->value); break; }
+        case RULE_IF: {
+            std::shared_ptr<If> rif = AS(statement, If);
+            this->optimize(rif->condition);
+            this->optimize(rif->then_branch, rif->then_block);
+            this->optimize(rif->else_branch, rif->else_block);
+            break;
+        }
+        case RULE_WHILE: {
+            std::shared_ptr<While> rwhile = AS(statement, While);
+            this->optimize(rwhile->condition);
+            this->optimize(rwhile->body, rwhile->block);
+            break;
+        }
+        case RULE_FOR: {
+            std::shared_ptr<For> rfor = AS(statement, For);
+            this->optimize(rfor->iterator);
+            this->optimize(rfor->body, rfor->block);
+            break;
+        }
+        case RULE_FUNCTION: {
+            const std::shared_ptr<FunctionValue> &fun = AS(statement, Function)->value;
+            this->optimize(fun->body, fun->block);
+            this->eliminate_dead_code(fun);
+            break;
+        }
+        case RULE_CLASS: { this->optimize(AS(statement, Class)->body); break; }
+        case RULE_EXPORT: { this->optimize(AS(statement, Export)->statement); break; }
+        default: { /* Nothing to optimize */ }
+    }
+}
+
+void Optimizer::optimize(std::shared_ptr<Expression> &expression)
+{
+    if (!expression) return;
+    std::shared_ptr<Expression> result;
+    switch (expression->rule) {
+        case RULE_LIST: {
+            for (std::shared_ptr<Expression> &value : AS(expression, List)->value) this->optimize(value);
+            break;
+        }
+        case RULE_DICTIONARY: {
+            for (auto &[key, value] : AS(expression, Dictionary)->value) this->optimize(value);
+            break;
+        }
+        case RULE_GROUP: {
+            std::shared_ptr<Group> group = AS(expression, Group);
+            this->optimize(group->expression);
+            if (is_literal(group->expression)) result = group->expression;
+            break;
+        }
+        case RULE_UNARY: {
+            std::shared_ptr<Unary> unary = AS(expression, Unary);
+            this->optimize(unary->right);
+            result = this->fold(unary);
+            break;
+        }
+        case RULE_BINARY: {
+            std::shared_ptr<Binary> binary = AS(expression, Binary);
+            this->optimize(binary->left);
+            this->optimize(binary->right);
+            result = this->fold(binary);
+            break;
+        }
+        case RULE_ASSIGN: { this->optimize(AS(expression, Assign)->value); break; }
+        case RULE_LOGICAL: {
+            std::shared_ptr<Logical> logical = AS(expression, Logical);
+            this->optimize(logical->left);
+            this->optimize(logical->right);
+            result = this->fold(logical);
+            break;
+        }
+        case RULE_CALL: {
+            for (std::shared_ptr<Expression> &argument : AS(expression, Call)->arguments) this->optimize(argument);
+            result = this->evaluate(AS(expression, Call));
+            break;
+        }
+        case RULE_ACCESS: {
+            std::shared_ptr<Access> access = AS(expression, Access);
+            this->optimize(access->target);
+            this->optimize(access->index);
+            break;
+        }
+        case RULE_CAST: {
+            std::shared_ptr<Cast> cast = AS(expression, Cast);
+            this->optimize(cast->expression);
+            result = this->fold(cast);
+            break;
+        }
+        case RULE_SLICE: {
+            std::shared_ptr<Slice> slice = AS(expression, Slice);
+            this->optimize(slice->target);
+            this->optimize(slice->start);
+            this->optimize(slice->end);
+            this->optimize(slice->step);
+            break;
+        }
+        case RULE_RANGE: {
+            std::shared_ptr<Range> range = AS(expression, Range);
+            this->optimize(range->start);
+            this->optimize(range->end);
+            break;
+        }
+        case RULE_OBJECT: {
+            for (auto &[name, argument] : AS(expression, Object)->arguments) this->optimize(argument);
+            break;
+        }
+        case RULE_PROPERTY: { this->optimize(AS(expression, Property)->object); break; }
+        default: { /* Nothing to optimize */ }
+    }
+    if (result) expression = result;
+}
+
+BlockVariableType *Optimizer::get_variable(const symbol_t symbol)
+{
+    for (auto block = this->blocks.rbegin(); block != this->blocks.rend(); block++) {
+        BlockVariableType *variable = (*block)->get_variable(symbol);
+        if (variable) return variable;
+    }
+    return nullptr;
+}
+
+void Optimizer::count_reads(const std::vector<std::shared_ptr<Statement>> &code, const std::shared_ptr<Block> &block)
+{
+    this->blocks.push_back(block);
+    for (const std::shared_ptr<Statement> &statement : code) this->count_reads(statement);
+    this->blocks.pop_back();
+}
+
+void Optimizer::count_reads(const std::shared_ptr<Statement> &statement)
+{
+    switch (statement->rule) {
+        case RULE_PRINT: { this->count_reads(AS(statement, Print)->expression); break; }
+        case RULE_EXPRESSION_STATEMENT: {
+            const std::shared_ptr<Expression> &expression = AS(statement, ExpressionStatement)->expression;
+            // Storing to a variable is not a read (only when it's a statement, since the value of
+            // an assignment is the variable register).
+            if (expression->rule == RULE_ASSIGN && AS(expression, Assign)->type == ASSIGN_VALUE && AS(expression, Assign)->target->rule == RULE_VARIABLE) {
+                this->count_reads(AS(expression, Assign)->value);
+            } else this->count_reads(expression);
+            break;
+        }
+        case RULE_DECLARATION: { this->count_reads(AS(statement, Declaration)->initializer); break; }
+        case RULE_RETURN: { this->count_reads(AS(statement, Return)->value); break; }
+        case RULE_DELETE: { this->count_reads(AS(statement, Delete)->target); break; }
+        case RULE_IF: {
+            std::shared_ptr<If> rif = AS(statement, If);
+            this->count_reads(rif->condition);
+            if (!rif->then_branch.empty()) this->count_reads(rif->then_branch, rif->then_block);
+            if (!rif->else_branch.empty()) this->count_reads(rif->else_branch, rif->else_block);
+            break;
+        }
+        case RULE_WHILE: {
+            std::shared_ptr<While> rwhile = AS(statement, While);
+            this->count_reads(rwhile->condition);
+            this->count_reads(rwhile->body, rwhile->block);
+            break;
+        }
+        case RULE_FOR: {
+            std::shared_ptr<For> rfor = AS(statement, For);
+            this->count_reads(rfor->iterator);
+            this->count_reads(rfor->body, rfor->block);
+            break;
+        }
+        default: { /* Nothing is read */ }
+    }
+}
+
+void Optimizer::count_reads(const std::shared_ptr<Expression> &expression)
+{
+    if (!expression) return;
+    switch (expression->rule) {
+        case RULE_VARIABLE: {
+            BlockVariableType *variable = this->get_variable(AS(expression, Variable)->symbol);
+            if (variable) this->reads[variable]++;
+            break;
+        }
+        case RULE_LIST: {
+            for (const std::shared_ptr<Expression> &value : AS(expression, List)->value) this->count_reads(value);
+            break;
+        }
+        case RULE_DICTIONARY: {
+            for (const auto &[key, value] : AS(expression, Dictionary)->value) this->count_reads(value);
+            break;
+        }
+        case RULE_GROUP: { this->count_reads(AS(expression, Group)->expression); break; }
+        case RULE_UNARY: { this->count_reads(AS(expression, Unary)->right); break; }
+        case RULE_BINARY: {
+            this->count_reads(AS(expression, Binary)->left);
+            this->count_reads(AS(expression, Binary)->right);
+            break;
+        }
+        case RULE_ASSIGN: {
+            this->count_reads(AS(expression, Assign)->target);
+            this->count_reads(AS(expression, Assign)->value);
+            break;
+        }
+        case RULE_LOGICAL: {
+            this->count_reads(AS(expression, Logical)->left);
+            this->count_reads(AS(expression, Logical)->right);
+            break;
+        }
+        case RULE_CALL: {
+            this->count_reads(AS(expression, Call)->target);
+            for (const std::shared_ptr<Expression> &argument : AS(expression, Call)->arguments) this->count_reads(argument);
+            break;
+        }
+        case RULE_ACCESS: {
+            this->count_reads(AS(expression, Access)->target);
+            this->count_reads(AS(expression, Access)->index);
+            break;
+        }
+        case RULE_CAST: { this->count_reads(AS(expression, Cast)->expression); break; }
+        case RULE_SLICE: {
+            std::shared_ptr<Slice> slice = AS(expression, Slice);
+            this->count_reads(slice->target);
+            this->count_reads(slice->start);
+            this->count_reads(slice->end);
+            this->count_reads(slice->step);
+            break;
+        }
+        case RULE_RANGE: {
+            this->count_reads(AS(expression, Range)->start);
+            this->count_reads(AS(expression, Range)->end);
+            break;
+        }
+        case RULE_OBJECT: {
+            for (const auto &[name, argument] : AS(expression, Object)->arguments) this->count_reads(argument);
+            break;
+        }
+        case RULE_PROPERTY: { this->count_reads(AS(expression, Property)->object); break; }
+        default: { /* Nothing is read */ }
+    }
+}
+
+void Optimizer::eliminate_dead_code(const std::shared_ptr<FunctionValue> &fun)
+{
+    if (fun->precompiled) return;
+    this->reads.clear();
+    this->count_reads(fun->body, fun->block);
+    this->eliminate_dead_code(fun->body, fun->block);
+}
+
+void Optimizer::eliminate_dead_code(std::vector<std::shared_ptr<Statement>> &code, const std::shared_ptr<Block> &block)
+{
+    this->blocks.push_back(block);
+    bool reachable = true;
+    for (std::shared_ptr<Statement> &statement : code) {
+        // Nothing after a return is executed.
+        if (!reachable) {
+            statement->dead = true;
+            continue;
+        }
+        switch (statement->rule) {
+            case RULE_RETURN: { reachable = false; break; }
+            case RULE_DECLARATION: {
+                std::shared_ptr<Declaration> dec = AS(statement, Declaration);
+                BlockVariableType *variable = block->get_variable(dec->name);
+                if (!variable || this->reads[variable] > 0) break;
+                // The variable is never read, so only the initializer side effects are kept.
+                if (!dec->initializer || is_pure(dec->initializer)) statement->dead = true;
+                else statement = std::make_shared<ExpressionStatement>(dec->file, dec->line, dec->column, dec->initializer);
+                break;
+            }
+            case RULE_EXPRESSION_STATEMENT: {
+                std::shared_ptr<ExpressionStatement> expression = AS(statement, ExpressionStatement);
+                if (expression->expression->rule != RULE_ASSIGN) break;
+                std::shared_ptr<Assign> assign = AS(expression->expression, Assign);
+                if (assign->type != ASSIGN_VALUE || assign->target->rule != RULE_VARIABLE) break;
+                BlockVariableType *variable = this->get_variable(AS(assign->target, Variable)->symbol);
+                if (!variable || this->reads[variable] > 0) break;
+                // The stored value is never read.
+                if (is_pure(assign->value)) statement->dead = true;
+                else expression->expression = assign->value;
+                break;
+            }
+            case RULE_IF: {
+                std::shared_ptr<If> rif = AS(statement, If);
+                // The compiler only compiles the branch of a constant condition.
+                if (rif->condition->rule == RULE_BOOLEAN) {
+                    bool condition = BOOL(rif->condition);
+                    if (!condition && rif->else_branch.empty()) statement->dead = true;
+                    else if (condition) this->eliminate_dead_code(rif->then_branch, rif->then_block);
+                    else this->eliminate_dead_code(rif->else_branch, rif->else_block);
+                    break;
+                }
+                if (!rif->then_branch.empty()) this->eliminate_dead_code(rif->then_branch, rif->then_block);
+                if (!rif->else_branch.empty()) this->eliminate_dead_code(rif->else_branch, rif->else_block);
+                break;
+            }
+            case RULE_WHILE: {
+                std::shared_ptr<While> rwhile = AS(statement, While);
+                if (rwhile->condition->rule == RULE_BOOLEAN && !BOOL(rwhile->condition)) statement->dead = true;
+                else this->eliminate_dead_code(rwhile->body, rwhile->block);
+                break;
+            }
+            case RULE_FOR: {
+                std::shared_ptr<For> rfor = AS(statement, For);
+                this->eliminate_dead_code(rfor->body, rfor->block);
+                break;
+            }
+            default: { /* Nothing to eliminate */ }
+        }
+    }
+    this->blocks.pop_back();
+}
+
+std::shared_ptr<Expression> Optimizer::fold(const std::shared_ptr<Unary> &unary)
+{
+    const std::shared_ptr<Expression> &right = unary->right;
+    const std::shared_ptr<Expression> inner = ungroup(right);
+    switch (unary->type) {
+        case UNARY_NEG_BOOL: {
+            if (right->rule == RULE_BOOLEAN) return make_boolean(unary, !BOOL(right));
+            // !!x is x.
+            if (inner->rule == RULE_UNARY && AS(inner, Unary)->type == UNARY_NEG_BOOL) return AS(inner, Unary)->right;
+            break;
+        }
+        case UNARY_MINUS_INT: {
+            if (right->rule == RULE_INTEGER) return make_integer(unary, WRAP(0, -, INT(right)));
+            // -(-x) is x.
+            if (inner->rule == RULE_UNARY && AS(inner, Unary)->type == UNARY_MINUS_INT) return AS(inner, Unary)->right;
+            break;
+        }
+        case UNARY_MINUS_FLOAT: {
+            if (right->rule == RULE_FLOAT) return make_float(unary, -FLOAT(right));
+            if (inner->rule == RULE_UNARY && AS(inner, Unary)->type == UNARY_MINUS_FLOAT) return AS(inner, Unary)->right;
+            break;
+        }
+        case UNARY_MINUS_BOOL: {
+            if (right->rule == RULE_BOOLEAN) return make_integer(unary, -static_cast<int64_t>(BOOL(right)));
+            break;
+        }
+        // +x is x.
+        case UNARY_PLUS_INT:
+        case UNARY_PLUS_FLOAT: { return right; }
+        case UNARY_PLUS_BOOL: {
+            if (right->rule == RULE_BOOLEAN) return make_integer(unary, static_cast<int64_t>(BOOL(right)));
+            break;
+        }
+    }
+    return nullptr;
+}
+
+std::shared_ptr<Expression> Optimizer::fold(const std::shared_ptr<Binary> &binary)
+{
+    const std::shared_ptr<Expression> &left = binary->left, &right = binary->right;
+    const bool integers = left->rule == RULE_INTEGER && right->rule == RULE_INTEGER;
+    const bool floats = left->rule == RULE_FLOAT && right->rule == RULE_FLOAT;
+    const bool strings = left->rule == RULE_STRING && right->rule == RULE_STRING;
+    const bool booleans = left->rule == RULE_BOOLEAN && right->rule == RULE_BOOLEAN;
+    switch (binary->type) {
+        case BINARY_ADD_INT: {
+            if (integers) return make_integer(binary, WRAP(INT(left), +, INT(right)));
+            if (IS_INT(right, 0)) return left;
+            if (IS_INT(left, 0)) return right;
+            break;
+        }
+        case BINARY_ADD_FLOAT: {
+            // x + 0.0 is not x when x is -0.0.
+            if (floats) return make_float(binary, FLOAT(left) + FLOAT(right));
+            break;
+        }
+        case BINARY_ADD_STRING: {
+            if (strings) return make_string(binary, STRING(left) + STRING(right));
+            if (IS_STRING(right, "")) return left;
+            if (IS_STRING(left, "")) return right;
+            break;
+        }
+        case BINARY_ADD_BOOL: {
+            if (booleans) return make_integer(binary, static_cast<int64_t>(BOOL(left) + BOOL(right)));
+            break;
+        }
+        case BINARY_SUB_INT: {
+            if (integers) return make_integer(binary, WRAP(INT(left), -, INT(right)));
+            if (IS_INT(right, 0)) return left;
+            break;
+        }
+        // The float and boolean substractions are left to the virtual machine, since
+        // its results don't match their types (a float typed as INT and a product).
+        case BINARY_MUL_INT: {
+            if (integers) return make_integer(binary, WRAP(INT(left), *, INT(right)));
+            if (IS_INT(right, 1)) return left;
+            if (IS_INT(left, 1)) return right;
+            break;
+        }
+        case BINARY_MUL_FLOAT: {
+            if (floats) return make_float(binary, FLOAT(left) * FLOAT(right));
+            if (IS_FLOAT(right, 1.0)) return left;
+            if (IS_FLOAT(left, 1.0)) return right;
+            break;
+        }
+        case BINARY_MUL_BOOL: {
+            if (booleans) return make_integer(binary, static_cast<int64_t>(BOOL(left) * BOOL(right)));
+            break;
+        }
+        case BINARY_MUL_INT_STRING: {
+            if (left->rule != RULE_INTEGER || right->rule != RULE_STRING) break;
+            if (INT(left) <= 0) return make_string(binary, "");
+            if (STRING(right).length() * INT(left) <= FOLD_MAX_STRING_LENGTH) return make_string(binary, repeat(STRING(right), INT(left)));
+            break;
+        }
+        case BINARY_MUL_STRING_INT: {
+            if (left->rule != RULE_STRING || right->rule != RULE_INTEGER) break;
+            if (INT(right) <= 0) return make_string(binary, "");
+            if (STRING(left).length() * INT(right) <= FOLD_MAX_STRING_LENGTH) return make_string(binary, repeat(STRING(left), INT(right)));
+            break;
+        }
+        case BINARY_DIV_INT: {
+            // The division by 0 must fail at runtime.
+            if (!integers || INT(right) == 0 || (INT(right) == -1 && INT(left) == INT64_MIN)) break;
+            return make_float(binary, static_cast<double>(INT(left) / INT(right)));
+        }
+        case BINARY_DIV_FLOAT: {
+            if (!floats || FLOAT(right) == 0) break;
+            return make_float(binary, FLOAT(left) / FLOAT(right));
+        }
+        case BINARY_EQ_INT: case BINARY_NEQ_INT: case BINARY_HT_INT: case BINARY_HTE_INT: case BINARY_LT_INT: case BINARY_LTE_INT: {
+            if (integers) return make_boolean(binary, compare(binary->type, INT(left), INT(right)));
+            break;
+        }
+        case BINARY_EQ_FLOAT: case BINARY_NEQ_FLOAT: case BINARY_HT_FLOAT: case BINARY_HTE_FLOAT: case BINARY_LT_FLOAT: case BINARY_LTE_FLOAT: {
+            if (floats) return make_boolean(binary, compare(binary->type, FLOAT(left), FLOAT(right)));
+            break;
+        }
+        case BINARY_EQ_STRING: case BINARY_NEQ_STRING: case BINARY_HT_STRING: case BINARY_HTE_STRING: case BINARY_LT_STRING: case BINARY_LTE_STRING: {
+            if (strings) return make_boolean(binary, compare(binary->type, STRING(left), STRING(right)));
+            break;
+        }
+        case BINARY_EQ_BOOL: case BINARY_NEQ_BOOL: case BINARY_HT_BOOL: case BINARY_HTE_BOOL: case BINARY_LT_BOOL: case BINARY_LTE_BOOL: {
+            if (booleans) return make_boolean(binary, compare(binary->type, BOOL(left), BOOL(right)));
+            break;
+        }
+        default: { /* Lists and dictionaries are not folded */ }
+    }
+    return nullptr;
+}
+
+std::shared_ptr<Expression> Optimizer::fold(const std::shared_ptr<Cast> &cast)
+{
+    const std::shared_ptr<Expression> &value = cast->expression;
+    switch (cast->cast_type) {
+        case CAST_INT_FLOAT: { if (value->rule == RULE_INTEGER) return make_float(cast, static_cast<double>(INT(value))); break; }
+        case CAST_INT_BOOL: { if (value->rule == RULE_INTEGER) return make_boolean(cast, INT(value) != 0); break; }
+        case CAST_INT_STRING: { if (value->rule == RULE_INTEGER) return make_string(cast, std::to_string(INT(value))); break; }
+        case CAST_FLOAT_INT: {
+            // Floats out of the integer range are left to the virtual machine.
+            if (value->rule == RULE_FLOAT && FLOAT(value) > -9223372036854775808.0 && FLOAT(value) < 9223372036854775808.0) {
+                return make_integer(cast, static_cast<int64_t>(FLOAT(value)));
+            }
+            break;
+        }
+        case CAST_FLOAT_BOOL: { if (value->rule == RULE_FLOAT) return make_boolean(cast, FLOAT(value) != 0); break; }
+        case CAST_FLOAT_STRING: { if (value->rule == RULE_FLOAT) return make_string(cast, std::to_string(FLOAT(value))); break; }
+        case CAST_BOOL_INT: { if (value->rule == RULE_BOOLEAN) return make_integer(cast, static_cast<int64_t>(BOOL(value))); break; }
+        case CAST_BOOL_FLOAT: { if (value->rule == RULE_BOOLEAN) return make_float(cast, static_cast<double>(BOOL(value))); break; }
+        case CAST_BOOL_STRING: { if (value->rule == RULE_BOOLEAN) return make_string(cast, BOOL(value) ? "true" : "false"); break; }
+        case CAST_STRING_BOOL: { if (value->rule == RULE_STRING) return make_boolean(cast, STRING(value).length() != 0); break; }
+        case CAST_STRING_INT: { if (value->rule == RULE_STRING) return make_integer(cast, static_cast<int64_t>(STRING(value).length())); break; }
+        default: { /* Lists and dictionaries are not folded */ }
+    }
+    return nullptr;
+}
+
+std::shared_ptr<Expression> Optimizer::fold(const std::shared_ptr<Logical> &logical)
+{
+    const std::shared_ptr<Expression> &left = logical->left, &right = logical->right;
+    const bool is_or = logical->op.type == TOKEN_OR;
+    if (left->rule == RULE_BOOLEAN && right->rule == RULE_BOOLEAN) {
+        return make_boolean(logical, is_or ? BOOL(left) || BOOL(right) : BOOL(left) && BOOL(right));
+    }
+    // Both sides are always evaluated, so only a neutral literal (x and true, x or false) can be removed.
+    if (right->rule == RULE_BOOLEAN && BOOL(right) != is_or) return left;
+    if (left->rule == RULE_BOOLEAN && BOOL(left) != is_or) return right;
+    return nullptr;
+}
+
+std::shared_ptr<Expression> Optimizer::evaluate(const std::shared_ptr<Call> &call)
+{
+    // Only the calls to the top level functions (and not the local variables with the same name)
+    // whose arguments are literals, so they don't share a list the function could modify.
+    if (!call->has_return || call->is_method || call->target->rule != RULE_VARIABLE) return nullptr;
+    const symbol_t symbol = AS(call->target, Variable)->symbol;
+    const auto fun = this->functions.find(symbol);
+    if (fun == this->functions.end() || this->get_variable(symbol)) return nullptr;
+    if (!std::all_of(call->arguments.begin(), call->arguments.end(), is_literal)) return nullptr;
+    std::shared_ptr<Expression> value = Evaluator(*this, this->functions).evaluate(fun->second, call->arguments);
+    if (!value || value->rule != RULE_LIST) return value;
+    // The list is a constant, so a copy of it is used (every call returns a new list).
+    std::shared_ptr<List> list = AS(value, List), empty = std::make_shared<List>(call->file, call->line, call->column, std::vector<std::shared_ptr<Expression>>());
+    list->type = empty->type = fun->second->return_type;
+    std::shared_ptr<Binary> copy = std::make_shared<Binary>(call->file, call->line, call->column, list, Token(TOKEN_PLUS, "+", 1, call->line, call->column), empty);
+    copy->type = BINARY_ADD_LIST;
+    copy->resolved_type = fun->second->return_type;
+    return copy;
+}
+
+void Optimizer::mark_memoized()
+{
+    // Every function is assumed to be deterministic, and the ones that call a function
+    // that isn't (or that aren't by themselves) are removed until none changes.
+    for (const auto &[symbol, fun] : this->functions) if (!fun->precompiled) this->deterministic.insert(fun.get());
+    for (bool changed = true; changed;) {
+        changed = false;
+        for (const auto &[symbol, fun] : this->functions) {
+            if (!this->deterministic.count(fun.get()) || this->is_deterministic(fun->body, fun->block)) continue;
+            this->deterministic.erase(fun.get());
+            changed = true;
+        }
+    }
+    // The arguments and the results must be scalars, so they are compared by value and can't be modified.
+    for (const auto &[symbol, fun] : this->functions) {
+        if (!this->deterministic.count(fun.get()) || !is_scalar(fun->return_type)) continue;
+        fun->memoize = std::all_of(fun->parameters.begin(), fun->parameters.end(), [](const std::shared_ptr<Declaration> &parameter) {
+            return is_scalar(parameter->type);
+        });
+    }
+}
+
+bool Optimizer::is_deterministic(const std::vector<std::shared_ptr<Statement>> &code, const std::shared_ptr<Block> &block)
+{
+    if (block) this->blocks.push_back(block);
+    const bool deterministic = std::all_of(code.begin(), code.end(), [this](const std::shared_ptr<Statement> &statement) {
+        return this->is_deterministic(statement);
+    });
+    if (block) this->blocks.pop_back();
+    return deterministic;
+}
+
+bool Optimizer::is_deterministic(const std::shared_ptr<Statement> &statement)
+{
+    // The dead statements are not compiled.
+    if (statement->dead) return true;
+    switch (statement->rule) {
+        case RULE_EXPRESSION_STATEMENT: { return this->is_deterministic(AS(statement, ExpressionStatement)->expression); }
+        case RULE_DECLARATION: {
+            // The default value of a list is a constant shared by every call.
+            const std::shared_ptr<Declaration> dec = AS(statement, Declaration);
+            return dec->initializer ? this->is_deterministic(dec->initializer) : is_scalar(dec->type);
+        }
+        case RULE_RETURN: { return this->is_deterministic(AS(statement, Return)->value); }
+        case RULE_IF: {
+            const std::shared_ptr<If> rif = AS(statement, If);
+            return this->is_deterministic(rif->condition)
+                && this->is_deterministic(rif->then_branch, rif->then_block)
+                && this->is_deterministic(rif->else_branch, rif->else_block);
+        }
+        case RULE_WHILE: {
+            const std::shared_ptr<While> rwhile = AS(statement, While);
+            return this->is_deterministic(rwhile->condition) && this->is_deterministic(rwhile->body, rwhile->block);
+        }
+        case RULE_FOR: {
+            const std::shared_ptr<For> rfor = AS(statement, For);
+            return this->is_deterministic(rfor->iterator) && this->is_deterministic(rfor->body, rfor->block);
+        }
+        default: { return false; }
+    }
+}
+
+bool Optimizer::is_deterministic(const std::shared_ptr<Expression> &expression)
+{
+    if (!expression) return true;
+    switch (expression->rule) {
+        case RULE_INTEGER:
+        case RULE_UNSIGNED:
+        case RULE_FLOAT:
+        case RULE_BOOLEAN:
+        case RULE_STRING: { return true; }
+        // The globals may change between calls.
+        case RULE_VARIABLE: { return this->get_variable(AS(expression, Variable)->symbol) != nullptr; }
+        case RULE_GROUP: { return this->is_deterministic(AS(expression, Group)->expression); }
+        case RULE_UNARY: { return this->is_deterministic(AS(expression, Unary)->right); }
+        case RULE_CAST: { return this->is_deterministic(AS(expression, Cast)->expression); }
+        case RULE_BINARY: { return this->is_deterministic(AS(expression, Binary)->left) && this->is_deterministic(AS(expression, Binary)->right); }
+        case RULE_LOGICAL: { return this->is_deterministic(AS(expression, Logical)->left) && this->is_deterministic(AS(expression, Logical)->right); }
+        case RULE_RANGE: { return this->is_deterministic(AS(expression, Range)->start) && this->is_deterministic(AS(expression, Range)->end); }
+        case RULE_ACCESS: { return this->is_deterministic(AS(expression, Access)->target) && this->is_deterministic(AS(expression, Access)->index); }
+        case RULE_ASSIGN: {
+            // Only the local variables and the elements of the lists they store are modified (the
+            // list literals are rejected, since the virtual machine shares them between calls).
+            const std::shared_ptr<Assign> assign = AS(expression, Assign);
+            std::shared_ptr<Expression> target = assign->target;
+            if (assign->type == ASSIGN_ACCESS) {
+                if (!this->is_deterministic(AS(target, Access)->index)) return false;
+                target = AS(target, Access)->target;
+            } else if (assign->type != ASSIGN_VALUE) return false;
+            return target->rule == RULE_VARIABLE && this->is_deterministic(target) && this->is_deterministic(assign->value);
+        }
+        case RULE_CALL: {
+            const std::shared_ptr<Call> call = AS(expression, Call);
+            if (call->is_method || call->target->rule != RULE_VARIABLE) return false;
+            const symbol_t symbol = AS(call->target, Variable)->symbol;
+            const auto fun = this->functions.find(symbol);
+            if (fun == this->functions.end() || this->get_variable(symbol) || !this->deterministic.count(fun->second.get())) return false;
+            return std::all_of(call->arguments.begin(), call->arguments.end(), [this](const std::shared_ptr<Expression> &argument) {
+                return this->is_deterministic(argument);
+            });
+        }
+        default: { return false; }
+    }
+}
+
+#undef AS
+#undef INT
+#undef FLOAT
+#undef BOOL
+#undef STRING
+#undef IS_INT
+#undef IS_FLOAT
+#undef IS_STRING
+#undef WRAP
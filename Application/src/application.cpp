@@ -37,12 +37,32 @@ Application::Application(int argc, char *argv[])
             logger->show_tokens = true;
         } else if (this->argv.back() == "--opcodes") {
             logger->show_opcodes = true;
+        } else if (this->argv.back() == "--ir") {
+            logger->show_ir = true;
         } else if (this->argv.back() == "--refs") {
             logger->show_references = true;
         } else if (this->argv.back() == "--linear-scan") {
             logger->linear_scan = true;
+        } else if (this->argv.back() == "--no-inline") {
+            logger->inline_functions = false;
         } else if (this->argv.back() == "--tld") {
             logger->tld_blocks = true;
+        } else if (this->argv.back() == "--gc-stats") {
+            logger->gc_stats = true;
+        } else if (this->argv.back() == "--memoize") {
+            logger->memoize = true;
+        } else if (this->argv.back() == "--memo-stats") {
+            logger->memo_stats = true;
+        } else if (this->argv.back() == "--no-cache") {
+            logger->use_cache = false;
+        } else if (this->argv.back().rfind("--gc-growth=", 0) == 0) {
+            char *end;
+            logger->gc_growth = strtod(argv[i] + 12, &end);
+            if (*end != '\0' || logger->gc_growth < 1.0) {
+                logger->add_entity(std::shared_ptr<const std::string>(), 0, 0, "Invalid usage. The heap growth factor must be at least 1.0\n");
+                logger->crash();
+                exit(64); // Exit status for incorrect command usage.
+            }
         } else if (this->file_name == "") {
             this->file_name = std::string(argv[1]);
         }
@@ -0,0 +1,85 @@
+/**
+ * |-------------------------|
+ * | Nuua Register Allocator |
+ * |-------------------------|
+ *
+ * Copyright 2019 Erik Campobadal <soc@erik.cat>
+ * https://nuua.io
+ */
+#ifndef ALLOCATOR_HPP
+#define ALLOCATOR_HPP
+
+#include "program.hpp"
+#include "memory.hpp"
+
+// Represents an instruction of the function being allocated.
+class AllocatorInstruction
+{
+    public:
+        // Stores the position of the opcode in the code.
+        size_t position;
+        // Stores the position of the defined register operand (0 if it defines none).
+        size_t def = 0;
+        // Stores the positions of the used register operands.
+        std::vector<size_t> uses;
+        // Stores the value (node) defined and the values used (set once the values are known).
+        size_t def_node = 0;
+        std::vector<size_t> use_nodes;
+};
+
+// Represents a basic block of the function being allocated.
+class AllocatorBlock
+{
+    public:
+        // Stores the first and the last + 1 instruction of the block.
+        size_t start, end;
+        // Stores the successor and predecessor blocks.
+        std::vector<size_t> successors, predecessors;
+        // Stores the dataflow sets of the block (reaching definitions and then liveness).
+        std::vector<uint64_t> in, out;
+};
+
+// The register allocator assigns the registers of a compiled function again.
+// The compiler gives registers to the values as it goes, so every variable
+// keeps its register for the whole function. The allocator splits the registers
+// into values (the definitions that reach the same uses), computes their liveness
+// and colors their interference graph, so values that are never live at the same
+// time share a register. Moves between two values that get the same register become
+// moves to the same register, which the peephole optimizer removes.
+class RegisterAllocator
+{
+    // Stores the memory where the function is compiled.
+    Memory *memory;
+    // Stores the entry point of the function.
+    size_t entry = 0;
+    // Stores the number of registers used by the compiler.
+    registers_size_t registers = 0;
+    // Stores the instructions and the basic blocks of the function.
+    std::vector<AllocatorInstruction> instructions;
+    std::vector<AllocatorBlock> blocks;
+    // Stores the instruction at each code position (relative to the entry).
+    std::vector<size_t> instruction_at;
+    // Stores the number of values and the interference matrix.
+    size_t values = 0;
+    std::vector<std::vector<uint64_t>> interferences;
+    // Decodes the instructions and splits them into basic blocks.
+    void decode();
+    // Returns the instruction a jump goes to (the number of instructions if it leaves the function).
+    size_t jump_target(const AllocatorInstruction &instruction);
+    // Splits the registers into values using the reaching definitions.
+    void split_values();
+    // Computes the liveness of the values and builds their interference graph.
+    void interfere();
+    // Returns the register of each value.
+    std::vector<reg_t> color();
+    // Writes the new registers.
+    void rewrite(const std::vector<reg_t> &colors);
+    public:
+        RegisterAllocator(Memory *memory)
+            : memory(memory) {}
+        // Allocates the registers of the function that starts at entry (it must be at the
+        // end of the code). Returns the number of registers the function needs.
+        registers_size_t allocate(const size_t entry, const registers_size_t registers);
+};
+
+#endif
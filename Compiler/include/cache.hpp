@@ -0,0 +1,123 @@
+/**
+ * |---------------------|
+ * | Nuua Bytecode Cache |
+ * |---------------------|
+ *
+ * Copyright 2019 Erik Campobadal <soc@erik.cat>
+ * https://nuua.io
+ */
+#ifndef CACHE_HPP
+#define CACHE_HPP
+
+#include "program.hpp"
+#include "memory.hpp"
+#include <mutex>
+#include <string>
+
+// Defines the version of the cache format. It must be increased
+// whenever the opcodes or the layout of the cache change.
+#define BYTECODE_VERSION 7
+
+// Defines the operands of a compiled module that depend on where it's linked.
+typedef enum : uint8_t {
+    RELOCATION_CONSTANT, // A constant of the module.
+    RELOCATION_MEMBER, // A class member constant ("<module>:<class>.<member>").
+    RELOCATION_GLOBAL // A top level function register ("<module>:<function>").
+} RelocationType;
+
+// Represents an operand that is set when the module is linked.
+class Relocation
+{
+    public:
+        // Stores the position of the operand in the module code.
+        size_t offset;
+        // Stores the relocation type.
+        RelocationType type;
+        // Stores the constant index (for RELOCATION_CONSTANT).
+        size_t index;
+        // Stores the symbol (for RELOCATION_MEMBER and RELOCATION_GLOBAL).
+        std::string symbol;
+};
+
+// Represents a function of a compiled module.
+class CompiledFunction
+{
+    public:
+        // Stores the function name ("<class>.<method>" for class methods).
+        std::string name;
+        // Stores the position of the function in the module code.
+        size_t entry;
+        // Stores the ammount of registers needed.
+        registers_size_t registers;
+};
+
+// Represents the code of a single module. It's stored next to the module
+// (module.nu -> module.nuo) and it's linked instead of compiling the module
+// again while neither its source nor the interface of the modules it uses change.
+class CompiledModule
+{
+    public:
+        // Stores the interface hash of the used modules (by module file).
+        std::unordered_map<std::string, uint64_t> dependencies;
+        // Stores the module code, the constants and the source locations
+        // (with the positions relative to the module).
+        Memory memory;
+        // Stores the operands to set when it's linked.
+        std::vector<Relocation> relocations;
+        // Stores the functions of the module.
+        std::vector<CompiledFunction> functions;
+};
+
+// Stores the compiled modules of a program. The headers are checked while the
+// modules are parsed (on the loader threads) and the rest is read when linked.
+class ModuleCache
+{
+    // Represents a parsed module.
+    class Entry
+    {
+        public:
+            // Stores the hash of the parsed source.
+            uint64_t source = 0;
+            // Stores the dependencies of the compiled module.
+            std::unordered_map<std::string, uint64_t> dependencies;
+            // Stores the compiled module (empty if it's outdated).
+            std::string buffer;
+            // Stores where the module code begins in the buffer.
+            size_t body = 0;
+    };
+    // Stores the parsed modules (by module file).
+    std::unordered_map<std::string, Entry> modules;
+    // Guards the modules.
+    std::mutex mutex;
+    public:
+        // Records the source hash of a parsed module and returns the dependencies of its
+        // compiled module, or nullptr if it's missing or outdated (used by the module loader).
+        const std::unordered_map<std::string, uint64_t> *precompiled(const std::string &file, const uint64_t source);
+        // Reads the compiled module of the given module. Returns false if it's corrupted.
+        bool load(const std::string &file, CompiledModule &module);
+        // Saves the compiled module of the given module.
+        void save(const std::string &file, const CompiledModule &module);
+};
+
+// The bytecode cache stores a compiled program next to its main
+// source file (main.nu -> main.nuc). The program is loaded from it
+// while the content hashes of all its modules still match, skipping
+// the lexer, parser, analyzer and compiler.
+class BytecodeCache
+{
+    // Stores the path of the cache file.
+    std::string path;
+    public:
+        // Creates the cache of the given (formatted) source file.
+        BytecodeCache(const std::string &source)
+            : path(source + "c") {}
+        // Loads the program from the cache. Returns false if the cache
+        // is missing or outdated, leaving the program untouched.
+        bool load(Program &program, reg_t &main) const;
+        // Saves the compiled program to the cache.
+        void save(const Program &program, const reg_t main) const;
+        // Returns the content hash of a file (0 if it can't be read).
+        static uint64_t hash_file(const std::string &file);
+};
+
+#endif
@@ -11,13 +11,39 @@
 
 #include "memory.hpp"
 #include "program.hpp"
+#include "cache.hpp"
 #include "../../Analyzer/include/analyzer.hpp"
 
+// Represents a function that can be inlined. It returns the value of the first
+// case whose condition is true (the last one has no condition).
+class InlineFunction
+{
+    public:
+        // Stores the function.
+        std::shared_ptr<FunctionValue> function;
+        // Stores a copy of the function block (the inlined calls set the parameter registers in their own copy).
+        std::shared_ptr<Block> block;
+        // Stores the condition and the returned value of each case.
+        std::vector<std::pair<std::shared_ptr<Expression>, std::shared_ptr<Expression>>> cases;
+};
+
+// Represents a constant of a function being compiled: a literal, the type of a default value,
+// a constant list or dictionary, or the class of an object. The runtime values and the heap
+// are not thread safe, so the values are created when the function is linked.
+typedef std::variant<
+    nint_t, nfloat_t, nbool_t, nstring_t, std::shared_ptr<Type>, std::shared_ptr<Expression>, std::shared_ptr<Class>
+> constant_t;
+
 // Base compiler class for nuua.
 class Compiler
 {
-    // Stores the program itself where everything is beeing compiled to.
+    // Stores the program itself where everything is beeing compiled to
+    // (the code of a single function when it compiles a function body).
     std::shared_ptr<Program> program;
+    // Stores the constants of the function body being compiled and the index the first one
+    // has in the code (the indexes before are the program constants, like the class members).
+    std::vector<constant_t> constants;
+    size_t constants_base = 0;
     // Stores the current block.
     std::vector<std::shared_ptr<Block>> blocks;
     // Stores the global frame information.
@@ -28,6 +54,34 @@ class Compiler
     std::vector<reg_t> dead_variables;
     // protected dead variables list (variables that can't be freed on the next statement).
     std::vector<reg_t> protected_dead_variables;
+    // Stores the number of dead statements and bytecode words removed (shown with the opcodes).
+    size_t dead_statements = 0, dead_code = 0;
+    // Determines if a dead statement is being compiled to measure it.
+    bool measuring_dead = false;
+    // Compiles a dead statement to measure its bytecode and removes it again.
+    void measure_dead(const std::shared_ptr<Statement> &rule);
+    // Stores the compiled modules (only when the cache is used).
+    std::unique_ptr<ModuleCache> module_cache;
+    // Stores the register or constant of each linkable symbol ("<module>:<name>").
+    std::unordered_map<std::string, size_t> link_symbols;
+    // Stores the symbol of each top level function register and class member constant.
+    std::unordered_map<size_t, std::string> global_symbols, member_symbols;
+    // Stores the entry point and the registers of the linked functions.
+    std::unordered_map<const FunctionValue *, std::pair<size_t, registers_size_t>> linked_functions;
+    // Stores the functions of the current module that can be inlined.
+    std::shared_ptr<const std::unordered_map<const Node *, InlineFunction>> inline_functions;
+    // Stores the functions being compiled or inlined (so the recursive calls are not inlined).
+    std::vector<const FunctionValue *> compiling;
+    // Registers the functions of a module that can be inlined.
+    void register_inline(const std::vector<std::shared_ptr<Statement>> &code);
+    // Returns the function a call can be inlined with, or nullptr.
+    const InlineFunction *inline_target(const std::shared_ptr<Call> &call);
+    // Compiles a call by compiling the values the function returns with its arguments.
+    reg_t compile_inline(const std::shared_ptr<Call> &call, const InlineFunction &function, const reg_t *suggested_register);
+    // Links the compiled module of a precompiled module.
+    void link_module(const std::shared_ptr<std::vector<std::shared_ptr<Statement>>> &code);
+    // Saves the code compiled since the given positions as the compiled module of the given module.
+    void save_module(const std::string &file, const size_t code_start, const size_t constants_start, const std::vector<std::shared_ptr<Use>> &usages, CompiledModule &module);
     // Compiles a module.
     void compile_module(const std::shared_ptr<std::vector<std::shared_ptr<Statement>>> &code, const std::shared_ptr<Block> &block);
     // Registers the top level declarations by assigning a register to them.
@@ -54,12 +108,20 @@ class Compiler
         // Determines if the access must be deleted
         const bool delete_access = false
     );
-    Value compile_function(const std::shared_ptr<Function> &f);
+    // Compiles the function bodies concurrently (each one on its own compiler) and links them
+    // in the given order. Returns the function values.
+    std::vector<Value> compile_functions(const std::vector<std::shared_ptr<Function>> &functions);
+    // Compiles a function body into the compiler program.
+    void compile_function(const std::shared_ptr<Function> &f);
+    // Adds the constants of a compiled function body to the program, optimizes its code, adds
+    // it to the program and returns the function value.
+    Value link_function(const std::shared_ptr<Function> &f, Compiler &function);
     // Adds an opcode to the program.
     void add_opcodes(const std::vector<opcode_t> &opcodes);
-    // Adds a constant to the constant pool of the current frame
-    // and return it's position.
-    size_t add_constant(const Value &value);
+    // Adds a constant to the constants of the function body and return it's position.
+    size_t add_constant(const constant_t &constant);
+    // Creates the value of a constant of a function body.
+    Value make_constant(const constant_t &constant);
     // Creates a constant list or dictionary from the given list expression.
     // Take into consideration that the list MUST be checked if
     // it's constant using is_constant() function.
@@ -68,8 +130,8 @@ class Compiler
     // Determines if an expression is constant (is in the constant pool).
     bool is_constant(const std::shared_ptr<Expression> &expression);
     // Sets a file flag at the current code location.
-    std::shared_ptr<const std::string> current_file;
-    void set_file(const std::shared_ptr<const std::string> &file);
+    file_t current_file = 0;
+    void set_file(const file_t file);
     // Sets a line flag at the current code location.
     line_t current_line = 0;
     void set_line(const line_t line);
@@ -79,8 +141,13 @@ class Compiler
     // Get a variable from the block stack and
     // return a pair containing the variable and a boolean
     // to indicate if it's global or not.
+    std::pair<BlockVariableType *, bool> get_variable(const symbol_t symbol);
     std::pair<BlockVariableType *, bool> get_variable(const std::string &name);
     BlockClassType *get_class(const std::string &name);
+    // Creates a compiler for the function bodies of the module the given one is compiling.
+    Compiler(const Compiler *module)
+        : program(std::make_shared<Program>()), constants_base(module->program->memory->constants.size()),
+        blocks(module->blocks), inline_functions(module->inline_functions) { }
     public:
         // Compile an input source and returns the main global register.
         reg_t compile(const char *file);
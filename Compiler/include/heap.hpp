@@ -0,0 +1,206 @@
+/**
+ * |------------------|
+ * | Nuua Memory Heap |
+ * |------------------|
+ *
+ * Copyright 2019 Erik Campobadal <soc@erik.cat>
+ * https://nuua.io
+ */
+#ifndef HEAP_HPP
+#define HEAP_HPP
+
+#include <stddef.h>
+#include <stdint.h>
+#include <functional>
+#include <utility>
+#include <vector>
+
+// Defines the minimum ammount of bytes to allocate before the first collection.
+#define HEAP_INITIAL_THRESHOLD (1024 * 1024)
+// Defines the slab size classes (every SLAB_GRANULARITY bytes up to SLAB_MAX_SIZE).
+#define SLAB_GRANULARITY 16
+#define SLAB_MAX_SIZE 512
+#define SLAB_CLASSES (SLAB_MAX_SIZE / SLAB_GRANULARITY)
+// Defines the size of the chunks where the slab blocks are carved from.
+#define SLAB_CHUNK_SIZE (64 * 1024)
+
+// Forward declarations.
+class Heap;
+class Value;
+
+// Base class for every value that lives in the heap (lists, dicts, functions and objects).
+class HeapObject
+{
+    friend class Heap;
+    // Stores the next object of the heap object list.
+    HeapObject *next = nullptr;
+    // Determines if the object was reached during the mark phase.
+    mutable bool marked = false;
+    public:
+        HeapObject() {}
+        // Copying an object never copies its heap header.
+        HeapObject(const HeapObject &) {}
+        HeapObject &operator =(const HeapObject &) { return *this; }
+        virtual ~HeapObject() {}
+        // Heap objects are allocated in the heap slab.
+        static void *operator new(size_t size);
+        static void operator delete(void *block, size_t size);
+        // Marks the values referenced by the object.
+        virtual void trace(Heap *) const {}
+        // Returns the aproximate number of bytes used by the object.
+        virtual size_t footprint() const = 0;
+};
+
+// Stores the slab statistics shown with --gc-stats.
+class SlabStats
+{
+    public:
+        // Number of allocations and frees served by the size classes.
+        size_t allocations[SLAB_CLASSES] = {};
+        size_t frees[SLAB_CLASSES] = {};
+        // Number of allocations too big for the size classes.
+        size_t large_allocations = 0;
+        // Number of chunks reserved.
+        size_t chunks = 0;
+};
+
+// Size class allocator used for the heap objects and the small value arrays.
+// Each size class keeps a free list of blocks carved from bigger chunks.
+class Slab
+{
+    // Represents a free block of the slab.
+    class FreeBlock
+    {
+        public:
+            FreeBlock *next;
+    };
+    // Stores the free blocks of each size class.
+    FreeBlock *free_blocks[SLAB_CLASSES] = {};
+    // Stores the reserved chunks.
+    std::vector<void *> chunks;
+    // Fills the free list of the given size class with a new chunk.
+    void refill(size_t size_class);
+    public:
+        // Stores the slab statistics.
+        SlabStats stats;
+        // Allocates a block of the given size.
+        void *allocate(size_t size)
+        {
+            if (size == 0) size = 1;
+            if (size > SLAB_MAX_SIZE) {
+                this->stats.large_allocations++;
+                return ::operator new(size);
+            }
+            size_t size_class = (size - 1) / SLAB_GRANULARITY;
+            if (!this->free_blocks[size_class]) this->refill(size_class);
+            FreeBlock *block = this->free_blocks[size_class];
+            this->free_blocks[size_class] = block->next;
+            this->stats.allocations[size_class]++;
+            return block;
+        }
+        // Frees a block of the given size.
+        void free(void *block, size_t size)
+        {
+            if (size == 0) size = 1;
+            if (size > SLAB_MAX_SIZE) {
+                ::operator delete(block);
+                return;
+            }
+            size_t size_class = (size - 1) / SLAB_GRANULARITY;
+            static_cast<FreeBlock *>(block)->next = this->free_blocks[size_class];
+            this->free_blocks[size_class] = static_cast<FreeBlock *>(block);
+            this->stats.frees[size_class]++;
+        }
+        ~Slab();
+};
+
+// Stores the heap statistics shown with --gc-stats.
+class HeapStats
+{
+    public:
+        // Number of collections performed.
+        size_t collections = 0;
+        // Number of objects allocated and freed.
+        size_t allocated_objects = 0;
+        size_t freed_objects = 0;
+        // Number of bytes allocated and freed.
+        size_t allocated_bytes = 0;
+        size_t freed_bytes = 0;
+        // Maximum number of bytes alive at the same time.
+        size_t peak_bytes = 0;
+        // Total time spent collecting (in microseconds).
+        uint64_t pause_time = 0;
+};
+
+// The heap owns all the heap objects of the virtual machine and frees
+// them using a precise, non-moving mark and sweep collector.
+// The roots are given by the virtual machine before each collection.
+class Heap
+{
+    // Stores the list of all the allocated objects.
+    HeapObject *objects = nullptr;
+    // Stores the objects that are marked but not yet traced.
+    std::vector<const HeapObject *> gray_objects;
+    // Stores the current ammount of bytes in use.
+    size_t bytes = 0;
+    // Stores the ammount of bytes that trigger the next collection.
+    size_t next_collection = HEAP_INITIAL_THRESHOLD;
+    // Registers a new object into the heap.
+    void track(HeapObject *object);
+    public:
+        // Stores the heap growth factor after each collection.
+        double growth_factor = 2.0;
+        // Stores the heap statistics.
+        HeapStats stats;
+        // Stores the slab used to allocate the heap objects.
+        Slab slab;
+        // Allocates a new heap object.
+        template <typename T, typename... Args>
+        T *allocate(Args&&... args)
+        {
+            T *object = new T(std::forward<Args>(args)...);
+            this->track(object);
+            return object;
+        }
+        // Allocates and frees an array of values (object properties and frame registers).
+        Value *allocate_values(size_t count);
+        void free_values(Value *values, size_t count);
+        // Accounts the bytes of an object that grew in place (lists and dicts).
+        void grow(size_t size)
+        {
+            this->bytes += size;
+            this->stats.allocated_bytes += size;
+            if (this->bytes > this->stats.peak_bytes) this->stats.peak_bytes = this->bytes;
+        }
+        // Returns true if a collection should be performed.
+        bool should_collect() const { return this->bytes >= this->next_collection; }
+        // Marks a root or a reachable value.
+        void mark(const Value &value);
+        void mark(const HeapObject *object);
+        // Performs a collection. The given function must mark the roots.
+        void collect(const std::function<void()> &mark_roots);
+        // Prints the heap statistics.
+        void report() const;
+};
+
+// heap will be a global class instance.
+extern Heap *heap;
+
+// Standard allocator that uses the heap slab (used by the list values).
+template <typename T>
+class SlabAllocator
+{
+    public:
+        typedef T value_type;
+        SlabAllocator() {}
+        template <typename U>
+        SlabAllocator(const SlabAllocator<U> &) {}
+        T *allocate(size_t count) { return static_cast<T *>(heap->slab.allocate(count * sizeof(T))); }
+        void deallocate(T *block, size_t count) { heap->slab.free(block, count * sizeof(T)); }
+        template <typename U>
+        bool operator ==(const SlabAllocator<U> &) const { return true; }
+        template <typename U>
+        bool operator !=(const SlabAllocator<U> &) const { return false; }
+};
+
+#endif
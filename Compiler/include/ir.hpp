@@ -0,0 +1,228 @@
+/**
+ * |----------------------------------|
+ * | Nuua Intermediate Representation |
+ * |----------------------------------|
+ *
+ * Copyright 2019 Erik Campobadal <soc@erik.cat>
+ * https://nuua.io
+ */
+#ifndef IR_HPP
+#define IR_HPP
+
+#include "program.hpp"
+#include "memory.hpp"
+#include <functional>
+
+// Defines the identifier of an IR value.
+typedef uint32_t ir_value_t;
+
+// Defines an IR value that is not set.
+#define IR_NONE static_cast<ir_value_t>(-1)
+// Defines a block that is not set.
+#define IR_NO_BLOCK static_cast<size_t>(-1)
+// Defines the maximum number of iterations of an unrolled loop.
+#define IR_UNROLL_TRIPS 8
+// Defines the maximum number of instructions an unrolled loop can have.
+#define IR_UNROLL_SIZE 64
+
+// Represents an operand of an IR instruction. It's either a value
+// or an immediate word (constant, global, property or literal).
+class IROperand
+{
+    public:
+        // Determines if the operand is a value.
+        bool value;
+        // Stores the value or the immediate word.
+        opcode_t word;
+};
+
+// Represents the source location of an IR instruction.
+class IRLocation
+{
+    public:
+        std::shared_ptr<const std::string> file;
+        line_t line = 0;
+        column_t column = 0;
+        bool operator ==(const IRLocation &location) const { return this->file == location.file && this->line == location.line && this->column == location.column; }
+        bool operator !=(const IRLocation &location) const { return !(*this == location); }
+};
+
+// Defines the memory an opcode reads or modifies.
+typedef enum : uint8_t {
+    IR_MEMORY_NONE, IR_MEMORY_LIST, IR_MEMORY_DICT, IR_MEMORY_PROP, IR_MEMORY_GLOBAL, IR_MEMORY_ALL
+} IRMemory;
+
+// Represents an IR instruction. It's an opcode whose register operands are values.
+class IRInstruction
+{
+    public:
+        // Stores the opcode.
+        opcode_t opcode;
+        // Stores the value the instruction sets (IR_NONE if none).
+        // Opcodes that modify their first register (IINC, SSET...) set a new value
+        // from the first operand, and are lowered to a move and the opcode.
+        ir_value_t result = IR_NONE;
+        // Stores the operands (without the result).
+        std::vector<IROperand> operands;
+        // Stores the source location.
+        IRLocation location;
+};
+
+// Represents a phi. It sets its value to the input of the predecessor the block was entered from.
+class IRPhi
+{
+    public:
+        // Stores the value the phi sets.
+        ir_value_t result;
+        // Stores the input of each predecessor (in the predecessors order).
+        std::vector<ir_value_t> inputs;
+        // Stores the register the phi was created for (only used while building the IR).
+        reg_t reg = 0;
+};
+
+// Represents a basic block. It ends with a jump to its successors (if any).
+class IRBlock
+{
+    public:
+        // Stores the phis and the instructions.
+        std::vector<IRPhi> phis;
+        std::vector<IRInstruction> instructions;
+        // Stores the jump condition (IR_NONE if it always goes to the first successor).
+        ir_value_t condition = IR_NONE;
+        // Determines if the conditional jump is taken when the condition is true.
+        bool jump_if = false;
+        // Stores the successors (the jump target and then the next block for conditional jumps).
+        std::vector<size_t> successors;
+        // Stores the predecessors.
+        std::vector<size_t> predecessors;
+        // Stores the source location of the jump.
+        IRLocation location;
+        // Determines if the block ends the function (with a RETURN or EXIT).
+        bool exits = false;
+};
+
+// Represents a natural loop.
+class IRLoop
+{
+    public:
+        // Stores the header (the block all the iterations start at).
+        size_t header;
+        // Stores the blocks that jump back to the header.
+        std::vector<size_t> latches;
+        // Stores the blocks of the loop (in reverse postorder).
+        std::vector<size_t> blocks;
+        // Determines if each block of the function is part of the loop.
+        std::vector<bool> body;
+};
+
+// Represents the information of an IR value.
+class IRValue
+{
+    public:
+        // Stores the type of the value (VALUE_NO_TYPE if it's not known).
+        ValueType type = VALUE_NO_TYPE;
+        // Determines if the value is the register content at the entry point (never set).
+        bool undefined = false;
+};
+
+// Represents a compiled function in SSA form. It's built from the bytecode
+// the compiler generated for the function (where the opcodes carry the types
+// the analyzer resolved), optimized by the passes and lowered back to bytecode.
+class IRFunction
+{
+    // Stores the entry point of the function.
+    size_t entry;
+    // Stores the number of registers used by the compiler.
+    registers_size_t registers;
+    // Builds the blocks from the bytecode. Returns false if the code can't be decoded.
+    bool build_blocks();
+    // Computes the predecessors of the blocks.
+    void compute_predecessors();
+    // Converts the registers into SSA values.
+    void build_ssa();
+    // Returns the type of the value an instruction sets.
+    ValueType result_type(const IRInstruction &instruction) const;
+    // Sets the types of the moves and phis from their inputs.
+    void infer_types();
+    // Adds copies for the phis at the end of the predecessors.
+    void destroy_ssa();
+    public:
+        // Stores the memory where the function is compiled.
+        Memory *memory;
+        // Stores the blocks (the first one is the entry block).
+        std::vector<IRBlock> blocks;
+        // Stores the values.
+        std::vector<IRValue> values;
+        // Stores the immediate dominator of each block and the blocks in reverse postorder.
+        std::vector<size_t> dominators, order;
+        // Determines if the function was built.
+        bool built = false;
+        // Builds the IR of the function at the end of the code that starts at entry.
+        IRFunction(Memory *memory, const size_t entry, const registers_size_t registers);
+        // Creates a new value.
+        ir_value_t new_value(const ValueType type = VALUE_NO_TYPE);
+        // Computes the immediate dominators and the reverse postorder of the blocks.
+        void compute_dominators();
+        // Returns the blocks each block immediately dominates.
+        std::vector<std::vector<size_t>> dominator_tree() const;
+        // Returns the loops of the function (the inner ones first).
+        std::vector<IRLoop> find_loops();
+        // Returns the block that only jumps to the header of a loop, that all the paths from outside
+        // the loop go through. It's added if it doesn't exist (and added to the loops it's part of).
+        size_t preheader(std::vector<IRLoop> &loops, const size_t loop);
+        // Returns true if the block a dominates the block b.
+        bool dominates(size_t a, size_t b) const;
+        // Replaces the uses of the values given the replacement of each one (IR_NONE keeps it).
+        void replace_values(std::vector<ir_value_t> &replacements);
+        // Counts the uses of each value.
+        std::vector<size_t> count_uses() const;
+        // Lowers the function back to the bytecode. Returns the number of registers it uses.
+        registers_size_t lower();
+        // Dumps the function to the stdout.
+        void dump(const std::string &name) const;
+};
+
+// Returns the memory the result of an opcode depends on (besides its operands).
+// Opcodes whose result is a new object or that have side effects depend on IR_MEMORY_ALL.
+IRMemory ir_loaded_memory(const opcode_t opcode);
+// Returns the memory an opcode modifies.
+IRMemory ir_stored_memory(const opcode_t opcode);
+
+// Represents an optimization pass over an IR function. It returns true if it changed it.
+typedef std::function<bool(IRFunction &)> IRPass;
+
+// The pass manager runs the optimization passes over an IR function until none changes it.
+class IRPassManager
+{
+    // Stores the passes and their names.
+    std::vector<std::pair<std::string, IRPass>> passes;
+    public:
+        // Creates the pass manager with the default passes.
+        IRPassManager();
+        // Adds a pass.
+        void add(const std::string &name, const IRPass &pass);
+        // Runs the passes.
+        void run(IRFunction &function) const;
+};
+
+// The default passes.
+// Replaces the values copied by moves and the phis with a single input by the original value.
+bool ir_copy_propagation(IRFunction &function);
+// Removes the instructions and phis whose values are never used (if they have no side effects).
+bool ir_dead_code(IRFunction &function);
+// Replaces the instructions that compute a value an instruction that dominates them already computed.
+bool ir_value_numbering(IRFunction &function);
+// Keeps the props of the objects that never escape the function in values, and replaces the
+// length and the reads at constant indexes of the lists that never escape with constants.
+bool ir_scalar_replacement(IRFunction &function);
+// Moves the instructions that compute the same value in every iteration of a loop before the loop.
+bool ir_loop_invariants(IRFunction &function);
+// Replaces the additions of one to the induction variables of the loops with increments.
+bool ir_induction_variables(IRFunction &function);
+// Unrolls the small loops with a constant number of iterations.
+bool ir_loop_unrolling(IRFunction &function);
+// Removes the bounds checks of the list and dictionary accesses at the index of a loop
+// that goes from a non negative constant up to the length of the list or dictionary.
+bool ir_bounds_checks(IRFunction &function);
+
+#endif
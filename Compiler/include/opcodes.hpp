@@ -32,11 +32,14 @@ typedef enum : uint8_t {
     OP_LPUSH_C, // LPUSH RX C1
     // OP_LPOP, // LPOP RX
     OP_LGET, // LGET RX RY RZ
+    OP_LGET_U, // LGET_U RX RY RZ (the index is known to be in range)
     OP_LSET, // LSET RX RY RZ
+    OP_LSET_U, // LSET_U RX RY RZ (the index is known to be in range)
     OP_LDELETE, // LDELETE RX RY
 
     // Dictionary releated
     OP_DKEY, // DKEY RX RY RZ
+    OP_DKEY_U, // DKEY_U RX RY RZ (the index is known to be in range)
     OP_DGET, // DGET RX RY RZ
     OP_DSET, // DSET RX RY RZ
     OP_DDELETE, // DDELETE RX RY
@@ -44,10 +47,12 @@ typedef enum : uint8_t {
     // Function releated
     OP_CALL, // CALL RX
     OP_RETURN, // RETURN
+    OP_MEMO, // MEMO C1 L1 (function name, number of parameters)
 
     // Object releated
     OP_LPROP, // PROP RX RY PX (dest, obj, prop)
     OP_SPROP, // PROP PX RX RY (prop, obj, value)
+    OP_CHECK_OBJECT, // CHECK_OBJECT RX (fails if the object is not initialized)
 
     /* Casting Operations */
 
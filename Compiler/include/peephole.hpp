@@ -0,0 +1,72 @@
+/**
+ * |-------------------------|
+ * | Nuua Peephole Optimizer |
+ * |-------------------------|
+ *
+ * Copyright 2019 Erik Campobadal <soc@erik.cat>
+ * https://nuua.io
+ */
+#ifndef PEEPHOLE_HPP
+#define PEEPHOLE_HPP
+
+#include "program.hpp"
+#include "memory.hpp"
+
+// Defines the maximum number of jumps followed when threading a jump.
+#define PEEPHOLE_MAX_THREAD 16
+
+// Represents an instruction of the function being optimized.
+class PeepholeInstruction
+{
+    public:
+        // Stores the opcode and its operands.
+        std::vector<opcode_t> words;
+        // Stores the instruction a jump goes to (the number of instructions if it leaves the function).
+        size_t target = 0;
+        // Determines if a jump goes to this instruction.
+        bool leader = false;
+        // Determines if the instruction is removed.
+        bool removed = false;
+};
+
+// The peephole optimizer rewrites the bytecode of a compiled function.
+//
+// Optimizes:
+// - Moves to the same register.
+// - Moves and constant loads to a register that the next opcode sets again.
+// - Loads of the constant the register already has (within a basic block).
+// - A push followed by a pop (into a move).
+// - Jumps to jumps (threaded to the final target) and jumps to the next opcode.
+//
+// The jump offsets and the source locations are updated to the new positions.
+class Peephole
+{
+    // Stores the memory where the function is compiled.
+    Memory *memory;
+    // Stores the entry point of the function.
+    size_t entry = 0;
+    // Stores the instructions of the function.
+    std::vector<PeepholeInstruction> instructions;
+    // Stores the position of each original instruction and the instruction it's now part of
+    // (the next one if it was removed), to move the source locations.
+    std::vector<std::pair<size_t, size_t>> origins;
+    // Decodes the instructions. Returns false if the code can't be decoded.
+    bool decode();
+    // Removes the instructions marked as removed (the jumps go to the next one).
+    void compact();
+    // Each of the optimizations. They return true if something changed.
+    bool remove_self_moves();
+    bool remove_overwritten_loads();
+    bool remove_repeated_constants();
+    bool merge_push_pop();
+    bool thread_jumps();
+    // Writes the instructions back to the memory.
+    void encode();
+    public:
+        Peephole(Memory *memory)
+            : memory(memory) {}
+        // Optimizes the function that starts at entry (it must be at the end of the code).
+        void optimize(const size_t entry);
+};
+
+#endif
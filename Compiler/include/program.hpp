@@ -20,35 +20,50 @@ typedef enum : uint8_t {
 
 class Memory;
 class Value;
+class MemoTable;
 
 // A frame is the one responsible for storing variables in a program.
 class Frame
 {
     public:
         // Stores the registers.
-        std::unique_ptr<Value[]> registers;
+        Value *registers = nullptr;
         // Stores the registers size.
         registers_size_t registers_size = 0;
         // Stores the return address to get back to the original program counter.
         opcode_t *return_address = nullptr;
         // Stores the frame caller (the function)
         // Value *caller = nullptr;
+        // Stores the results table of a memoized function (nullptr if it's not memoized)
+        // and the key of its arguments.
+        MemoTable *memo = nullptr;
+        std::string memo_key;
+        // Stores the top of the stack without the arguments (the result is stored if one value is returned).
+        Value *memo_stack = nullptr;
         // Allocates the space to store the registers.
         void allocate_registers(registers_size_t size);
         // Frees the allocated register space.
         void free_registers();
         // Setup the frame.
         void setup(registers_size_t size, opcode_t *return_address);
+        Frame() {}
+        // Frames own their registers, so they can't be copied.
+        Frame(const Frame &) = delete;
+        ~Frame() { this->free_registers(); }
 };
 
 // This class is used to represent the frame information during compilation
 // (not in runtime).
 class FrameInfo
 {
+    // Defines the state flags of a register.
+    static constexpr uint8_t REGISTER_FREE = 1;
+    static constexpr uint8_t REGISTER_PROTECTED = 2;
     // Stores the registers that are free to use again.
     std::vector<reg_t> free_registers;
-    // Stores the registers that are protected to get free unless forçed.
-    std::vector<reg_t> protected_registers;
+    // Stores the state flags of each given register (indexed by register), so
+    // freeing a register does not need to search the free and protected lists.
+    std::vector<uint8_t> register_states;
     public:
         // Stores the next register to give in case no free ones are available.
         reg_t current_register = 0;
@@ -80,6 +95,22 @@ class Program
 // Basic conversation from opcode to string.
 std::string opcode_to_string(const opcode_t opcode);
 std::vector<OpCodeType> *opcode_operands(const opcode_t opcode);
+// Determines if the opcode sets its first register (instead of using or modifying it).
+bool opcode_defines_register(const opcode_t opcode);
+// Determines if the opcode sets its result before it finishes reading the operands.
+bool opcode_writes_before_reading(const opcode_t opcode);
+// Determines if the opcode is a jump, if it always jumps and if it jumps backwards.
+bool opcode_is_jump(const opcode_t opcode);
+bool opcode_is_unconditional_jump(const opcode_t opcode);
+bool opcode_is_backward_jump(const opcode_t opcode);
+// Returns the jump opcode that goes in the given direction.
+opcode_t opcode_jump(const opcode_t opcode, const bool backward);
+// Determines if the opcode modifies its first register in place (instead of setting it).
+bool opcode_modifies_register(const opcode_t opcode);
+// Determines if the opcode result only depends on its operands (it has no side effects and can't fail).
+bool opcode_is_pure(const opcode_t opcode);
+// Determines if the opcode can be removed when its result is not used.
+bool opcode_is_removable(const opcode_t opcode);
 // Prints a given opcode to the screen.
 void print_opcode(const opcode_t opcode);
 
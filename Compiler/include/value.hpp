@@ -10,17 +10,19 @@
 #define VALUE_HPP
 
 #include "program.hpp"
+#include "heap.hpp"
 #include "../../Analyzer/include/module.hpp"
 #include <string>
 #include <vector>
 #include <variant>
 
 // Forward declaration.
+class ValueList;
 class ValueDictionary;
 class ValueObject;
 
 // Defines how a function value is.
-class ValueFunction
+class ValueFunction : public HeapObject
 {
     public:
         // Stores the function index where it's code begin.
@@ -30,26 +32,87 @@ class ValueFunction
         // Basic constructor for the function value.
         ValueFunction(size_t index, registers_size_t registers)
             : index(index), registers(registers) {}
+        // Returns the aproximate number of bytes used.
+        size_t footprint() const override { return sizeof(ValueFunction); }
 };
 
 typedef int64_t nint_t;
 typedef double nfloat_t;
 typedef bool nbool_t;
 typedef std::string nstring_t;
-typedef std::vector<Value> nlist_t;
+typedef ValueList nlist_t;
 typedef ValueDictionary ndict_t;
 typedef ValueFunction nfun_t;
 typedef ValueObject nobject_t;
 
 #define GETV(value, variant) (std::get<variant>(value))
 
+// Defines a type shared by the runtime values. The reference count is
+// stored in the type itself and it's not atomic, since the virtual machine
+// runs in a single thread.
+class RuntimeType
+{
+    friend class TypeRef;
+    // Stores the number of references to the type.
+    size_t references;
+    // Stores the inner type, created the first time it's requested.
+    RuntimeType *inner = nullptr;
+    public:
+        // Stores the type itself.
+        const Type type;
+        RuntimeType(const Type &type, const size_t references = 0)
+            : references(references), type(type) {}
+        ~RuntimeType();
+};
+
+// Intrusive reference counted handle to a runtime type.
+class TypeRef
+{
+    // Stores the native types, they are never freed.
+    static RuntimeType natives[VALUE_LIST];
+    // Stores the referenced runtime type.
+    RuntimeType *runtime_type;
+    // Creates a new reference to an existing runtime type.
+    TypeRef(RuntimeType *runtime_type)
+        : runtime_type(runtime_type) { this->runtime_type->references++; }
+    // Frees a runtime type without references (the native ones always have one).
+    static void free(RuntimeType *runtime_type);
+    // Drops the current reference.
+    void release() { if (--this->runtime_type->references == 0) TypeRef::free(this->runtime_type); }
+    public:
+        // Creates a reference to a native type (or a new type if it's not native).
+        TypeRef(const ValueType type = VALUE_INT)
+            : runtime_type(type < VALUE_LIST ? natives + type : new RuntimeType(Type(type))) { this->runtime_type->references++; }
+        // Creates a reference to a new runtime type.
+        TypeRef(const Type &type);
+        TypeRef(const TypeRef &ref)
+            : runtime_type(ref.runtime_type) { this->runtime_type->references++; }
+        TypeRef &operator =(const TypeRef &ref)
+        {
+            if (this->runtime_type != ref.runtime_type) {
+                ref.runtime_type->references++;
+                this->release();
+                this->runtime_type = ref.runtime_type;
+            }
+            return *this;
+        }
+        ~TypeRef() { this->release(); }
+        // Returns the inner type.
+        TypeRef inner() const;
+        // Accessors to the referenced type.
+        const Type *operator ->() const { return &this->runtime_type->type; }
+        const Type &operator *() const { return this->runtime_type->type; }
+        // Returns true if both references point to the same runtime type.
+        bool operator ==(const TypeRef &ref) const { return this->runtime_type == ref.runtime_type; }
+};
+
 // Base value class representing a nuua value.
 class Value
 {
     void build_from_type(const Type *type);
     public:
         // The type of the value.
-        Type type;
+        TypeRef type;
         // Using a variant to avoid unessesary memory.
         std::variant<
             // Stores the reporesentation of the VALUE_INT.
@@ -61,54 +124,70 @@ class Value
             // Stores the representation of the VALUE_STRING.
             nstring_t,
             // Stores the representation of the VALUE_LIST.
-            std::shared_ptr<nlist_t>,
+            nlist_t *,
             // Stores the representation of the VALUE_DICT.
-            std::shared_ptr<ndict_t>,
+            ndict_t *,
             // Stores the representation of the VALUE_FUN.
-            std::shared_ptr<nfun_t>,
+            nfun_t *,
             // Stores the representation of the VALUE_OBJECT.
-            std::shared_ptr<nobject_t>
+            nobject_t *
         > value;
         // The following are the basic constructors for the value. Each one respresents
         // a diferent value to be stored. They pretty much speak by themselves.
         // Integer (int) value.
-        Value() : type({ VALUE_INT }), value(static_cast<nint_t>(0)) {}
+        Value() : type(VALUE_INT), value(static_cast<nint_t>(0)) {}
         Value(const nint_t a)
-            : type({ VALUE_INT }), value(a) {}
+            : type(VALUE_INT), value(a) {}
         // Float value (double in C/C++).
         Value(const nfloat_t a)
-            : type({ VALUE_FLOAT }), value(a) {}
+            : type(VALUE_FLOAT), value(a) {}
         // Boolean value.
         Value(const nbool_t a)
-            : type({ VALUE_BOOL }), value(a) {}
+            : type(VALUE_BOOL), value(a) {}
         // String value.
         Value(const nstring_t &a)
-            : type({ VALUE_STRING }), value(a) {}
-        // List value.
-        Value(const nlist_t &a, const std::shared_ptr<Type> &inner_type)
-            : type({ VALUE_LIST, inner_type }), value(std::make_shared<nlist_t>(a)) {}
-        // The following two constructors are basically defined in the value.cpp since
+            : type(VALUE_STRING), value(a) {}
+        // The following constructors are basically defined in the value.cpp since
         // They make use of a forward declared constructor.
+        Value(const nlist_t &a, const std::shared_ptr<Type> &inner_type);
         Value(const std::unordered_map<std::string, Value> &a, const std::vector<std::string> &b, const std::shared_ptr<Type> &inner_type);
         Value(const size_t index, const registers_size_t registers, const Type &type);
         Value(const std::string &class_name, const std::vector<std::string> &props);
         // Create default initialized value, given the type.
         Value(const std::shared_ptr<Type> &type);
         Value(const Type &type);
-        Value(const Value &value);
+        Value(const Value &value)
+            : type(value.type), value(value.value) {}
         ~Value() {}
         // Retypes the value.
-        void retype(ValueType new_type, const std::shared_ptr<Type> &new_inner_type = std::shared_ptr<Type>());
+        void retype(ValueType new_type) { this->type = TypeRef(new_type); }
+        void retype(ValueType new_type, const std::shared_ptr<Type> &new_inner_type);
         // Copies the current value to the destnation.
-        void copy_to(Value *dest) const;
+        void copy_to(Value *dest) const
+        {
+            dest->type = this->type;
+            dest->value = this->value;
+        }
         // Compares one value with another.
         bool same_as(const Value &value) const;
         // Gets a string representation of the value.
         std::string to_string() const;
 };
 
+// Defines how a list value is.
+class ValueList : public HeapObject, public std::vector<Value, SlabAllocator<Value>>
+{
+    public:
+        // Use the same constructors as the vector.
+        using std::vector<Value, SlabAllocator<Value>>::vector;
+        // Marks the list elements.
+        void trace(Heap *heap) const override;
+        // Returns the aproximate number of bytes used.
+        size_t footprint() const override;
+};
+
 // Defines how a dictionary value is.
-class ValueDictionary
+class ValueDictionary : public HeapObject
 {
     public:
         // Represents the hashmap of the dictionary.
@@ -122,18 +201,27 @@ class ValueDictionary
         // The basic constructor of the dictionary.
         ValueDictionary(const std::unordered_map<std::string, Value> &values, const std::vector<std::string> &key_order)
             : values(values), key_order(key_order) {}
+        // Marks the dictionary values.
+        void trace(Heap *heap) const override;
+        // Returns the aproximate number of bytes used.
+        size_t footprint() const override;
 };
 
 // Defines how an object value is.
-class ValueObject
+class ValueObject : public HeapObject
 {
     public:
         // Stores the registers containing the properties values.
-        std::unique_ptr<Value[]> registers;
+        Value *registers;
         // Stores the names of the props for string conversion.
         std::vector<std::string> props;
         // Create a new object value and allocates the registers given the size.
         ValueObject(const std::vector<std::string> &props);
+        ~ValueObject();
+        // Marks the object properties.
+        void trace(Heap *heap) const override;
+        // Returns the aproximate number of bytes used.
+        size_t footprint() const override;
 };
 
 #endif
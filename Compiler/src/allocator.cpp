@@ -0,0 +1,346 @@
+/**
+ * |-------------------------|
+ * | Nuua Register Allocator |
+ * |-------------------------|
+ *
+ * Copyright 2019 Erik Campobadal <soc@erik.cat>
+ * https://nuua.io
+ */
+#include "../include/allocator.hpp"
+#include <algorithm>
+#include <bit>
+#include <numeric>
+
+// Defines a position or index that is not set.
+#define NONE static_cast<size_t>(-1)
+// Returns the number of 64 bit words needed to store the given number of bits.
+#define WORDS(bits) (((bits) + 63) / 64)
+// Bit set operations.
+#define TEST(set, bit) (((set)[(bit) / 64] >> ((bit) % 64)) & 1)
+#define SET(set, bit) ((set)[(bit) / 64] |= uint64_t(1) << ((bit) % 64))
+#define CLEAR(set, bit) ((set)[(bit) / 64] &= ~(uint64_t(1) << ((bit) % 64)))
+// Iterates the bits of a set.
+#define FOR_BITS(set, bit, body) \
+    for (size_t word_ = 0; word_ < (set).size(); word_++) { \
+        for (uint64_t bits_ = (set)[word_]; bits_ != 0; bits_ &= bits_ - 1) { \
+            const size_t bit = word_ * 64 + std::countr_zero(bits_); \
+            body \
+        } \
+    }
+
+// Adds the set to the destination set. Returns true if the destination changed.
+static bool merge(std::vector<uint64_t> &destination, const std::vector<uint64_t> &set)
+{
+    bool changed = false;
+    for (size_t i = 0; i < destination.size(); i++) {
+        uint64_t merged = destination[i] | set[i];
+        if (merged != destination[i]) {
+            destination[i] = merged;
+            changed = true;
+        }
+    }
+    return changed;
+}
+
+// Finds the representative of a union-find set.
+static size_t find(std::vector<size_t> &parents, size_t element)
+{
+    while (parents[element] != element) element = parents[element] = parents[parents[element]];
+    return element;
+}
+
+size_t RegisterAllocator::jump_target(const AllocatorInstruction &instruction)
+{
+    const std::vector<opcode_t> &code = this->memory->code;
+    const size_t offset = code[instruction.position + 1];
+    const size_t target = opcode_is_backward_jump(code[instruction.position]) ? instruction.position - offset : instruction.position + offset;
+    if (target < this->entry || target >= code.size()) return this->instructions.size();
+    return this->instruction_at[target - this->entry];
+}
+
+void RegisterAllocator::decode()
+{
+    const std::vector<opcode_t> &code = this->memory->code;
+    this->instruction_at.assign(code.size() - this->entry, NONE);
+    for (size_t i = this->entry; i < code.size();) {
+        AllocatorInstruction instruction;
+        instruction.position = i;
+        const std::vector<OpCodeType> *operands = opcode_operands(code[i]);
+        for (size_t k = 0; k < operands->size(); k++) {
+            const size_t position = i + 1 + k;
+            // Operands out of the frame are not registers the compiler gave.
+            if ((*operands)[k] != OT_REG || position >= code.size() || code[position] >= this->registers) continue;
+            if (k == 0 && opcode_defines_register(code[i])) instruction.def = position;
+            else instruction.uses.push_back(position);
+        }
+        for (size_t k = i; k <= i + operands->size() && k < code.size(); k++) this->instruction_at[k - this->entry] = this->instructions.size();
+        this->instructions.push_back(std::move(instruction));
+        i += operands->size() + 1;
+    }
+    // Find the basic block leaders.
+    const size_t size = this->instructions.size();
+    std::vector<bool> leaders(size + 1, false);
+    leaders[0] = true;
+    for (size_t i = 0; i < size; i++) {
+        const opcode_t opcode = code[this->instructions[i].position];
+        if (opcode_is_jump(opcode)) {
+            leaders[this->jump_target(this->instructions[i])] = true;
+            leaders[i + 1] = true;
+        } else if (opcode == OP_RETURN || opcode == OP_EXIT) leaders[i + 1] = true;
+    }
+    std::vector<size_t> block_at(size + 1, NONE);
+    for (size_t i = 0; i < size; i++) {
+        if (!leaders[i]) continue;
+        if (!this->blocks.empty()) this->blocks.back().end = i;
+        block_at[i] = this->blocks.size();
+        this->blocks.push_back({ i, size, {}, {}, {}, {} });
+    }
+    // Link the blocks.
+    for (size_t b = 0; b < this->blocks.size(); b++) {
+        const AllocatorInstruction &last = this->instructions[this->blocks[b].end - 1];
+        const opcode_t opcode = code[last.position];
+        bool falls = opcode != OP_RETURN && opcode != OP_EXIT && !opcode_is_unconditional_jump(opcode);
+        if (opcode_is_jump(opcode)) {
+            const size_t target = block_at[this->jump_target(last)];
+            if (target != NONE) this->blocks[b].successors.push_back(target);
+        }
+        if (falls && b + 1 < this->blocks.size()) this->blocks[b].successors.push_back(b + 1);
+        for (const size_t successor : this->blocks[b].successors) this->blocks[successor].predecessors.push_back(b);
+    }
+}
+
+void RegisterAllocator::split_values()
+{
+    const std::vector<opcode_t> &code = this->memory->code;
+    // Each definition has an index. The registers read before any definition
+    // have an extra one at the entry point.
+    std::vector<size_t> definitions(this->instructions.size(), NONE);
+    std::vector<std::vector<size_t>> register_definitions(this->registers);
+    size_t count = 0;
+    for (size_t i = 0; i < this->instructions.size(); i++) {
+        if (!this->instructions[i].def) continue;
+        register_definitions[code[this->instructions[i].def]].push_back(definitions[i] = count++);
+    }
+    const size_t entry_definitions = count;
+    for (reg_t r = 0; r < this->registers; r++) register_definitions[r].push_back(count++);
+    const size_t words = WORDS(count);
+    // Compute the reaching definitions.
+    std::vector<std::vector<uint64_t>> generated(this->blocks.size(), std::vector<uint64_t>(words, 0));
+    std::vector<std::vector<reg_t>> killed(this->blocks.size());
+    for (size_t b = 0; b < this->blocks.size(); b++) {
+        AllocatorBlock &block = this->blocks[b];
+        block.in.assign(words, 0);
+        block.out.assign(words, 0);
+        for (size_t i = block.start; i < block.end; i++) {
+            if (!this->instructions[i].def) continue;
+            const reg_t r = code[this->instructions[i].def];
+            for (const size_t definition : register_definitions[r]) CLEAR(generated[b], definition);
+            SET(generated[b], definitions[i]);
+            killed[b].push_back(r);
+        }
+    }
+    for (size_t d = entry_definitions; d < count; d++) SET(this->blocks[0].in, d);
+    for (bool changed = true; changed;) {
+        changed = false;
+        for (size_t b = 0; b < this->blocks.size(); b++) {
+            AllocatorBlock &block = this->blocks[b];
+            for (const size_t predecessor : block.predecessors) merge(block.in, this->blocks[predecessor].out);
+            std::vector<uint64_t> out = block.in;
+            for (const reg_t r : killed[b]) for (const size_t definition : register_definitions[r]) CLEAR(out, definition);
+            merge(out, generated[b]);
+            if (out != block.out) {
+                block.out = std::move(out);
+                changed = true;
+            }
+        }
+    }
+    // Join the definitions that reach the same use.
+    std::vector<size_t> parents(count);
+    std::iota(parents.begin(), parents.end(), 0);
+    std::vector<size_t> operand_definitions(code.size() - this->entry, NONE);
+    for (size_t b = 0; b < this->blocks.size(); b++) {
+        std::vector<uint64_t> reaching = this->blocks[b].in;
+        for (size_t i = this->blocks[b].start; i < this->blocks[b].end; i++) {
+            const AllocatorInstruction &instruction = this->instructions[i];
+            for (const size_t use : instruction.uses) {
+                size_t first = NONE;
+                for (const size_t definition : register_definitions[code[use]]) {
+                    if (!TEST(reaching, definition)) continue;
+                    if (first == NONE) first = definition;
+                    else parents[find(parents, definition)] = find(parents, first);
+                }
+                // Unreachable code reads the entry value.
+                operand_definitions[use - this->entry] = first != NONE ? first : register_definitions[code[use]].back();
+            }
+            if (instruction.def) {
+                for (const size_t definition : register_definitions[code[instruction.def]]) CLEAR(reaching, definition);
+                SET(reaching, definitions[i]);
+                operand_definitions[instruction.def - this->entry] = definitions[i];
+            }
+        }
+    }
+    // Number the values.
+    std::vector<size_t> values(count, NONE);
+    auto value = [&](const size_t position) {
+        size_t &v = values[find(parents, operand_definitions[position - this->entry])];
+        if (v == NONE) v = this->values++;
+        return v;
+    };
+    for (AllocatorInstruction &instruction : this->instructions) {
+        if (instruction.def) instruction.def_node = value(instruction.def);
+        for (const size_t use : instruction.uses) instruction.use_nodes.push_back(value(use));
+    }
+}
+
+void RegisterAllocator::interfere()
+{
+    const std::vector<opcode_t> &code = this->memory->code;
+    const size_t words = WORDS(this->values);
+    // Compute the liveness of the values.
+    std::vector<std::vector<uint64_t>> used(this->blocks.size(), std::vector<uint64_t>(words, 0));
+    std::vector<std::vector<uint64_t>> defined(this->blocks.size(), std::vector<uint64_t>(words, 0));
+    for (size_t b = 0; b < this->blocks.size(); b++) {
+        AllocatorBlock &block = this->blocks[b];
+        block.in.assign(words, 0);
+        block.out.assign(words, 0);
+        for (size_t i = block.start; i < block.end; i++) {
+            const AllocatorInstruction &instruction = this->instructions[i];
+            for (const size_t node : instruction.use_nodes) if (!TEST(defined[b], node)) SET(used[b], node);
+            if (instruction.def) SET(defined[b], instruction.def_node);
+        }
+    }
+    for (bool changed = true; changed;) {
+        changed = false;
+        for (size_t b = this->blocks.size(); b-- > 0;) {
+            AllocatorBlock &block = this->blocks[b];
+            for (const size_t successor : block.successors) merge(block.out, this->blocks[successor].in);
+            std::vector<uint64_t> in = block.out;
+            for (size_t w = 0; w < words; w++) in[w] = (in[w] & ~defined[b][w]) | used[b][w];
+            if (in != block.in) {
+                block.in = std::move(in);
+                changed = true;
+            }
+        }
+    }
+    // Build the interference graph.
+    this->interferences.assign(this->values, std::vector<uint64_t>(words, 0));
+    auto edge = [this](const size_t a, const size_t b) {
+        if (a == b) return;
+        SET(this->interferences[a], b);
+        SET(this->interferences[b], a);
+    };
+    for (AllocatorBlock &block : this->blocks) {
+        std::vector<uint64_t> live = block.out;
+        for (size_t i = block.end; i-- > block.start;) {
+            const AllocatorInstruction &instruction = this->instructions[i];
+            const bool move = code[instruction.position] == OP_MOVE && instruction.use_nodes.size() == 1;
+            if (instruction.def) {
+                FOR_BITS(live, node, {
+                    if (!move || node != instruction.use_nodes[0]) edge(instruction.def_node, node);
+                })
+                CLEAR(live, instruction.def_node);
+                if (opcode_writes_before_reading(code[instruction.position])) {
+                    for (const size_t node : instruction.use_nodes) edge(instruction.def_node, node);
+                }
+            }
+            // The opcodes that modify their first register can't share it with the values live after them.
+            if (opcode_modifies_register(code[instruction.position]) && !instruction.uses.empty() && instruction.uses[0] == instruction.position + 1) {
+                FOR_BITS(live, node, { edge(instruction.use_nodes[0], node); })
+            }
+            for (const size_t node : instruction.use_nodes) SET(live, node);
+        }
+    }
+    // The values read before they are set keep their own register.
+    FOR_BITS(this->blocks[0].in, node, {
+        for (size_t other = 0; other < this->values; other++) edge(node, other);
+    })
+}
+
+std::vector<reg_t> RegisterAllocator::color()
+{
+    const std::vector<opcode_t> &code = this->memory->code;
+    // Order the values by removing the one with the fewest neighbours each time.
+    std::vector<size_t> degrees(this->values, 0), order;
+    std::vector<bool> removed(this->values, false);
+    for (size_t node = 0; node < this->values; node++) {
+        for (const uint64_t word : this->interferences[node]) degrees[node] += std::popcount(word);
+    }
+    for (size_t n = 0; n < this->values; n++) {
+        size_t node = NONE;
+        for (size_t candidate = 0; candidate < this->values; candidate++) {
+            if (!removed[candidate] && (node == NONE || degrees[candidate] < degrees[node])) node = candidate;
+        }
+        removed[node] = true;
+        order.push_back(node);
+        FOR_BITS(this->interferences[node], neighbour, {
+            if (!removed[neighbour]) degrees[neighbour]--;
+        })
+    }
+    // Stores the values related by a move (they should share a register).
+    std::vector<std::vector<size_t>> moves(this->values);
+    for (const AllocatorInstruction &instruction : this->instructions) {
+        if (code[instruction.position] != OP_MOVE || !instruction.def || instruction.use_nodes.size() != 1) continue;
+        moves[instruction.def_node].push_back(instruction.use_nodes[0]);
+        moves[instruction.use_nodes[0]].push_back(instruction.def_node);
+    }
+    // Color them in reverse order.
+    std::vector<reg_t> colors(this->values, static_cast<reg_t>(-1));
+    std::vector<bool> taken;
+    for (auto node = order.rbegin(); node != order.rend(); node++) {
+        taken.assign(this->values, false);
+        FOR_BITS(this->interferences[*node], neighbour, {
+            if (colors[neighbour] != static_cast<reg_t>(-1)) taken[colors[neighbour]] = true;
+        })
+        reg_t color = static_cast<reg_t>(-1);
+        for (const size_t related : moves[*node]) {
+            if (colors[related] != static_cast<reg_t>(-1) && !taken[colors[related]]) {
+                color = colors[related];
+                break;
+            }
+        }
+        if (color == static_cast<reg_t>(-1)) color = std::find(taken.begin(), taken.end(), false) - taken.begin();
+        colors[*node] = color;
+    }
+    return colors;
+}
+
+void RegisterAllocator::rewrite(const std::vector<reg_t> &colors)
+{
+    std::vector<opcode_t> &code = this->memory->code;
+    for (const AllocatorInstruction &instruction : this->instructions) {
+        if (instruction.def) code[instruction.def] = colors[instruction.def_node];
+        for (size_t k = 0; k < instruction.uses.size(); k++) code[instruction.uses[k]] = colors[instruction.use_nodes[k]];
+    }
+}
+
+registers_size_t RegisterAllocator::allocate(const size_t entry, const registers_size_t registers)
+{
+    this->entry = entry;
+    this->registers = registers;
+    if (entry >= this->memory->code.size() || registers == 0) return registers;
+    this->decode();
+    // Leave the function as it is if it can't be decoded.
+    for (const AllocatorInstruction &instruction : this->instructions) {
+        if (instruction.position + opcode_operands(this->memory->code[instruction.position])->size() >= this->memory->code.size()) return registers;
+        if (opcode_is_jump(this->memory->code[instruction.position])) {
+            const size_t offset = this->memory->code[instruction.position + 1];
+            const size_t target = opcode_is_backward_jump(this->memory->code[instruction.position]) ? instruction.position - offset : instruction.position + offset;
+            if (target == this->memory->code.size()) continue;
+            if (target < entry || target > this->memory->code.size() || this->instructions[this->instruction_at[target - entry]].position != target) return registers;
+        }
+    }
+    this->split_values();
+    this->interfere();
+    const std::vector<reg_t> colors = this->color();
+    this->rewrite(colors);
+    reg_t used = 0;
+    for (const reg_t color : colors) used = std::max(used, static_cast<reg_t>(color + 1));
+    return used;
+}
+
+#undef NONE
+#undef WORDS
+#undef TEST
+#undef SET
+#undef CLEAR
+#undef FOR_BITS
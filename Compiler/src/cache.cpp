@@ -0,0 +1,430 @@
+/**
+ * |---------------------|
+ * | Nuua Bytecode Cache |
+ * |---------------------|
+ *
+ * Copyright 2019 Erik Campobadal <soc@erik.cat>
+ * https://nuua.io
+ */
+#include "../include/cache.hpp"
+#include "../include/memory.hpp"
+#include "../../Logger/include/logger.hpp"
+#include <stdio.h>
+#include <string.h>
+
+// Defines the magic bytes of the cache files.
+#define BYTECODE_MAGIC "NUC\x1A"
+#define MODULE_MAGIC "NUO\x1A"
+// Defines the flags that change the compiled code.
+#define BYTECODE_LINEAR_SCAN 1
+#define BYTECODE_NO_INLINE 2
+#define BYTECODE_MEMOIZE 4
+
+// Returns the flags used to compile the current program.
+static uint8_t compile_flags()
+{
+    return (logger->linear_scan ? BYTECODE_LINEAR_SCAN : 0) | (logger->inline_functions ? 0 : BYTECODE_NO_INLINE)
+        | (logger->memoize ? BYTECODE_MEMOIZE : 0);
+}
+
+// Serializes the program into a buffer.
+class BytecodeWriter
+{
+    public:
+        // Stores the serialized bytes.
+        std::string buffer;
+        // Writes the basic types.
+        template <typename T>
+        void write(const T value) { this->buffer.append(reinterpret_cast<const char *>(&value), sizeof(T)); }
+        void write(const std::string &value)
+        {
+            this->write<uint64_t>(value.length());
+            this->buffer.append(value);
+        }
+        void write(const Type &type)
+        {
+            this->write<uint8_t>(type.type);
+            this->write(type.class_name);
+            this->write<uint8_t>(type.inner_type != nullptr);
+            if (type.inner_type) this->write(*type.inner_type);
+            this->write<uint64_t>(type.parameters.size());
+            for (const std::shared_ptr<Type> &parameter : type.parameters) this->write(*parameter);
+        }
+        void write(const Memory &memory)
+        {
+            this->write<uint64_t>(memory.code.size() * sizeof(opcode_t));
+            for (const opcode_t opcode : memory.code) this->write<uint64_t>(opcode);
+            this->write<uint64_t>(memory.constants.size());
+            for (const Value &constant : memory.constants) this->write(constant);
+            this->write<uint64_t>(memory.files.size());
+            for (const auto &[index, file] : memory.files) {
+                this->write<uint64_t>(index);
+                this->write(*file);
+            }
+            this->write<uint64_t>(memory.lines.size());
+            for (const auto &[index, line] : memory.lines) {
+                this->write<uint64_t>(index);
+                this->write(line);
+            }
+            this->write<uint64_t>(memory.columns.size());
+            for (const auto &[index, column] : memory.columns) {
+                this->write<uint64_t>(index);
+                this->write(column);
+            }
+        }
+        void write(const Value &value)
+        {
+            this->write(*value.type);
+            this->write<uint8_t>(value.value.index());
+            switch (value.value.index()) {
+                case 0: { this->write(GETV(value.value, nint_t)); break; }
+                case 1: { this->write(GETV(value.value, nfloat_t)); break; }
+                case 2: { this->write<uint8_t>(GETV(value.value, nbool_t)); break; }
+                case 3: { this->write(GETV(value.value, nstring_t)); break; }
+                case 4: {
+                    const nlist_t *list = GETV(value.value, nlist_t *);
+                    this->write<uint64_t>(list->size());
+                    for (const Value &element : *list) this->write(element);
+                    break;
+                }
+                case 5: {
+                    const ndict_t *dict = GETV(value.value, ndict_t *);
+                    this->write<uint64_t>(dict->key_order.size());
+                    for (const std::string &key : dict->key_order) {
+                        this->write(key);
+                        this->write(dict->values.at(key));
+                    }
+                    break;
+                }
+                case 6: {
+                    const nfun_t *fun = GETV(value.value, nfun_t *);
+                    this->write<uint8_t>(fun != nullptr);
+                    if (!fun) break;
+                    this->write<uint64_t>(fun->index);
+                    this->write<uint32_t>(fun->registers);
+                    break;
+                }
+                case 7: {
+                    const nobject_t *object = GETV(value.value, nobject_t *);
+                    this->write<uint8_t>(object != nullptr);
+                    if (!object) break;
+                    this->write<uint64_t>(object->props.size());
+                    for (size_t i = 0; i < object->props.size(); i++) {
+                        this->write(object->props[i]);
+                        this->write(object->registers[i]);
+                    }
+                    break;
+                }
+            }
+        }
+};
+
+// Reads a serialized program. Any malformed input makes it fail.
+class BytecodeReader
+{
+    // Stores the beginning, the current position and the end of the input.
+    const char *begin, *current, *end;
+    public:
+        // Determines if all the reads succeeded.
+        bool ok = true;
+        BytecodeReader(const std::string &buffer, const size_t position = 0)
+            : begin(buffer.data()), current(buffer.data() + position), end(buffer.data() + buffer.size()) {}
+        // Returns the current position in the input.
+        size_t position() const { return this->current - this->begin; }
+        // Reads the basic types.
+        template <typename T>
+        T read()
+        {
+            T value = T();
+            if (!this->ok || static_cast<size_t>(this->end - this->current) < sizeof(T)) {
+                this->ok = false;
+                return value;
+            }
+            memcpy(&value, this->current, sizeof(T));
+            this->current += sizeof(T);
+            return value;
+        }
+        std::string read_string()
+        {
+            uint64_t length = this->read<uint64_t>();
+            if (!this->ok || static_cast<uint64_t>(this->end - this->current) < length) {
+                this->ok = false;
+                return std::string();
+            }
+            std::string value = std::string(this->current, length);
+            this->current += length;
+            return value;
+        }
+        // Reads a length and makes sure there's enough input for it.
+        uint64_t read_count()
+        {
+            uint64_t count = this->read<uint64_t>();
+            if (count > static_cast<uint64_t>(this->end - this->current)) this->ok = false;
+            return this->ok ? count : 0;
+        }
+        std::shared_ptr<Type> read_type()
+        {
+            std::shared_ptr<Type> type = std::make_shared<Type>(static_cast<ValueType>(this->read<uint8_t>()));
+            type->class_name = this->read_string();
+            if (this->read<uint8_t>()) type->inner_type = this->read_type();
+            for (uint64_t i = 0, count = this->read_count(); i < count && this->ok; i++) {
+                type->parameters.push_back(this->read_type());
+            }
+            return type;
+        }
+        void read_memory(Memory &memory)
+        {
+            memory.code.resize(this->read_count() / sizeof(opcode_t));
+            for (opcode_t &opcode : memory.code) opcode = this->read<uint64_t>();
+            memory.constants.resize(this->read_count());
+            for (Value &constant : memory.constants) this->read_value(constant);
+            for (uint64_t i = 0, count = this->read_count(); i < count && this->ok; i++) {
+                size_t index = this->read<uint64_t>();
+                memory.files[index] = logger->file(logger->intern_file(std::make_shared<const std::string>(this->read_string())));
+            }
+            for (uint64_t i = 0, count = this->read_count(); i < count && this->ok; i++) {
+                size_t index = this->read<uint64_t>();
+                memory.lines[index] = this->read<line_t>();
+            }
+            for (uint64_t i = 0, count = this->read_count(); i < count && this->ok; i++) {
+                size_t index = this->read<uint64_t>();
+                memory.columns[index] = this->read<column_t>();
+            }
+        }
+        void read_value(Value &value)
+        {
+            value.type = TypeRef(*this->read_type());
+            switch (this->read<uint8_t>()) {
+                case 0: { value.value = this->read<nint_t>(); break; }
+                case 1: { value.value = this->read<nfloat_t>(); break; }
+                case 2: { value.value = static_cast<nbool_t>(this->read<uint8_t>()); break; }
+                case 3: { value.value = this->read_string(); break; }
+                case 4: {
+                    nlist_t *list = heap->allocate<nlist_t>();
+                    value.value = list;
+                    for (uint64_t i = 0, count = this->read_count(); i < count && this->ok; i++) {
+                        list->push_back(Value());
+                        this->read_value(list->back());
+                    }
+                    break;
+                }
+                case 5: {
+                    ndict_t *dict = heap->allocate<ndict_t>(std::unordered_map<std::string, Value>(), std::vector<std::string>());
+                    value.value = dict;
+                    for (uint64_t i = 0, count = this->read_count(); i < count && this->ok; i++) {
+                        std::string key = this->read_string();
+                        Value element;
+                        this->read_value(element);
+                        dict->insert(key, element);
+                    }
+                    break;
+                }
+                case 6: {
+                    if (!this->read<uint8_t>()) {
+                        value.value = static_cast<nfun_t *>(nullptr);
+                        break;
+                    }
+                    size_t index = this->read<uint64_t>();
+                    value.value = heap->allocate<nfun_t>(index, this->read<uint32_t>());
+                    break;
+                }
+                case 7: {
+                    if (!this->read<uint8_t>()) {
+                        value.value = static_cast<nobject_t *>(nullptr);
+                        break;
+                    }
+                    uint64_t count = this->read_count();
+                    std::vector<std::string> props;
+                    std::vector<Value> values = std::vector<Value>(count);
+                    for (uint64_t i = 0; i < count && this->ok; i++) {
+                        props.push_back(this->read_string());
+                        this->read_value(values[i]);
+                    }
+                    if (!this->ok) break;
+                    nobject_t *object = heap->allocate<nobject_t>(props);
+                    for (uint64_t i = 0; i < count; i++) values[i].copy_to(object->registers + i);
+                    value.value = object;
+                    break;
+                }
+                default: { this->ok = false; }
+            }
+        }
+};
+
+// Reads a whole file. Returns false if it can't be read.
+static bool read_file(const std::string &path, std::string &buffer)
+{
+    FILE *file = fopen(path.c_str(), "rb");
+    if (!file) return false;
+    char chunk[4096];
+    for (size_t n; (n = fread(chunk, 1, sizeof(chunk), file)) > 0;) buffer.append(chunk, n);
+    fclose(file);
+    return true;
+}
+
+// Writes a whole file. It's written to a temporary file first, so it's never
+// read half written. The caches are optional, so any error is ignored.
+static void write_file(const std::string &path, const std::string &buffer)
+{
+    std::string temporary = path + ".tmp";
+    FILE *file = fopen(temporary.c_str(), "wb");
+    if (!file) return;
+    bool written = fwrite(buffer.data(), 1, buffer.size(), file) == buffer.size();
+    if (fclose(file) == 0 && written) rename(temporary.c_str(), path.c_str());
+    else remove(temporary.c_str());
+}
+
+uint64_t BytecodeCache::hash_file(const std::string &file)
+{
+    SourceFile source = SourceFile(file);
+    return source.is_open() ? source.hash() : 0;
+}
+
+bool BytecodeCache::load(Program &program, reg_t &main) const
+{
+    std::string buffer;
+    if (!read_file(this->path, buffer)) return false;
+    BytecodeReader reader = BytecodeReader(buffer);
+    // Check the header.
+    if (reader.read<uint32_t>() != *reinterpret_cast<const uint32_t *>(BYTECODE_MAGIC)) return false;
+    if (reader.read<uint32_t>() != BYTECODE_VERSION || reader.read<uint8_t>() != compile_flags()) return false;
+    // Check the modules did not change.
+    for (uint64_t i = 0, count = reader.read_count(); i < count; i++) {
+        std::string module = reader.read_string();
+        if (!reader.ok || reader.read<uint64_t>() != BytecodeCache::hash_file(module)) return false;
+    }
+    // Read the program into a new memory, so a corrupted cache leaves the program untouched.
+    std::unique_ptr<Memory> memory = std::make_unique<Memory>();
+    reg_t main_register = reader.read<uint32_t>();
+    reader.read_memory(*memory);
+    std::vector<Value> globals = std::vector<Value>(reader.read_count());
+    for (Value &global : globals) reader.read_value(global);
+    if (!reader.ok || main_register >= globals.size()) return false;
+    // Setup the program.
+    program.memory = std::move(memory);
+    program.main_frame.allocate_registers(globals.size());
+    for (size_t i = 0; i < globals.size(); i++) globals[i].copy_to(program.main_frame.registers + i);
+    main = main_register;
+    return true;
+}
+
+void BytecodeCache::save(const Program &program, const reg_t main) const
+{
+    BytecodeWriter writer;
+    // Write the header.
+    writer.write(*reinterpret_cast<const uint32_t *>(BYTECODE_MAGIC));
+    writer.write<uint32_t>(BYTECODE_VERSION);
+    writer.write<uint8_t>(compile_flags());
+    // Write the modules used and their content hash.
+    writer.write<uint64_t>(logger->file_count() - 1);
+    for (file_t i = 1; i < logger->file_count(); i++) {
+        std::shared_ptr<const std::string> module = logger->file(i);
+        writer.write(*module);
+        writer.write(BytecodeCache::hash_file(*module));
+    }
+    // Write the program.
+    writer.write<uint32_t>(main);
+    writer.write(*program.memory);
+    writer.write<uint64_t>(program.main_frame.registers_size);
+    for (registers_size_t i = 0; i < program.main_frame.registers_size; i++) writer.write(program.main_frame.registers[i]);
+    write_file(this->path, writer.buffer);
+}
+
+const std::unordered_map<std::string, uint64_t> *ModuleCache::precompiled(const std::string &file, const uint64_t source)
+{
+    std::lock_guard<std::mutex> lock(this->mutex);
+    Entry &entry = this->modules[file];
+    entry.source = source;
+    entry.buffer.clear();
+    entry.dependencies.clear();
+    if (!read_file(file + "o", entry.buffer)) return nullptr;
+    // Check the header. The checksum makes sure the rest can be read when it's linked.
+    BytecodeReader reader = BytecodeReader(entry.buffer);
+    bool valid = reader.read<uint32_t>() == *reinterpret_cast<const uint32_t *>(MODULE_MAGIC)
+        && reader.read<uint32_t>() == BYTECODE_VERSION
+        && reader.read<uint8_t>() == compile_flags()
+        && reader.read<uint64_t>() == source;
+    uint64_t checksum = reader.read<uint64_t>();
+    valid = valid && reader.ok && checksum == hash_bytes(entry.buffer.data() + reader.position(), entry.buffer.size() - reader.position());
+    for (uint64_t i = 0, count = valid ? reader.read_count() : 0; i < count; i++) {
+        std::string module = reader.read_string();
+        entry.dependencies[module] = reader.read<uint64_t>();
+    }
+    if (!valid || !reader.ok) {
+        entry.buffer.clear();
+        entry.dependencies.clear();
+        return nullptr;
+    }
+    entry.body = reader.position();
+    return &entry.dependencies;
+}
+
+bool ModuleCache::load(const std::string &file, CompiledModule &module)
+{
+    std::lock_guard<std::mutex> lock(this->mutex);
+    auto entry = this->modules.find(file);
+    if (entry == this->modules.end() || entry->second.buffer.empty()) return false;
+    module.dependencies = entry->second.dependencies;
+    BytecodeReader reader = BytecodeReader(entry->second.buffer, entry->second.body);
+    reader.read_memory(module.memory);
+    module.relocations.resize(reader.read_count());
+    for (Relocation &relocation : module.relocations) {
+        relocation.offset = reader.read<uint64_t>();
+        relocation.type = static_cast<RelocationType>(reader.read<uint8_t>());
+        relocation.index = reader.read<uint64_t>();
+        relocation.symbol = reader.read_string();
+    }
+    module.functions.resize(reader.read_count());
+    for (CompiledFunction &function : module.functions) {
+        function.name = reader.read_string();
+        function.entry = reader.read<uint64_t>();
+        function.registers = reader.read<uint32_t>();
+    }
+    return reader.ok;
+}
+
+void ModuleCache::save(const std::string &file, const CompiledModule &module)
+{
+    uint64_t source;
+    {
+        std::lock_guard<std::mutex> lock(this->mutex);
+        auto entry = this->modules.find(file);
+        // Only the parsed modules have a known source.
+        if (entry == this->modules.end()) return;
+        source = entry->second.source;
+    }
+    BytecodeWriter body;
+    body.write<uint64_t>(module.dependencies.size());
+    for (const auto &[dependency, interface] : module.dependencies) {
+        body.write(dependency);
+        body.write(interface);
+    }
+    body.write(module.memory);
+    body.write<uint64_t>(module.relocations.size());
+    for (const Relocation &relocation : module.relocations) {
+        body.write<uint64_t>(relocation.offset);
+        body.write<uint8_t>(relocation.type);
+        body.write<uint64_t>(relocation.index);
+        body.write(relocation.symbol);
+    }
+    body.write<uint64_t>(module.functions.size());
+    for (const CompiledFunction &function : module.functions) {
+        body.write(function.name);
+        body.write<uint64_t>(function.entry);
+        body.write<uint32_t>(function.registers);
+    }
+    BytecodeWriter writer;
+    writer.write(*reinterpret_cast<const uint32_t *>(MODULE_MAGIC));
+    writer.write<uint32_t>(BYTECODE_VERSION);
+    writer.write<uint8_t>(compile_flags());
+    writer.write(source);
+    writer.write(hash_bytes(body.buffer.data(), body.buffer.size()));
+    writer.buffer.append(body.buffer);
+    write_file(file + "o", writer.buffer);
+}
+
+#undef BYTECODE_MAGIC
+#undef MODULE_MAGIC
+#undef BYTECODE_LINEAR_SCAN
+#undef BYTECODE_NO_INLINE
+#undef BYTECODE_MEMOIZE
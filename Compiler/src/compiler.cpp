@@ -9,29 +9,132 @@
 #include "../include/compiler.hpp"
 #include "../../Logger/include/logger.hpp"
 #include "../../Parser/include/parser.hpp"
+#include "../../Parser/include/loader.hpp"
 #include "../include/program.hpp"
 #include "../include/memory.hpp"
+#include "../include/cache.hpp"
+#include "../include/allocator.hpp"
+#include "../include/peephole.hpp"
+#include "../include/ir.hpp"
 #include <algorithm>
+#include <atomic>
+#include <mutex>
+#include <thread>
 
 #define ADD_LOG(rule, msg) (logger->add_entity(rule->file, rule->line, rule->column, msg))
 #define SET_SOURCE_LOCATION(node) \
     if (this->current_column != node->column) this->set_column(node->column); \
     if (this->current_line != node->line) this->set_line(node->line); \
-    if (!this->current_file || *this->current_file != *node->file) this->set_file(node->file);
+    if (this->current_file != node->file) this->set_file(node->file);
+// Defines the maximum number of nodes of the expression an inlined function returns.
+#define INLINE_NODES 16
 
 // Class constant pool.
 static std::unordered_map<
     // The class.
     std::shared_ptr<Class>,
-    // Variable name and constant index.
-    std::unordered_map<std::string, size_t>
+    // Variable symbol and constant index.
+    std::unordered_map<symbol_t, size_t>
 > class_constant_pool;
 
+// Determines if the functions of a module were skipped since it's precompiled.
+// The generic functions and their instances are never precompiled.
+static bool precompiled(const std::vector<std::shared_ptr<Statement>> &code)
+{
+    for (std::shared_ptr<Statement> node : code) {
+        if (node->rule == RULE_EXPORT) node = std::static_pointer_cast<Export>(node)->statement;
+        if (node->rule == RULE_FUNCTION) {
+            const std::shared_ptr<FunctionValue> &fun = std::static_pointer_cast<Function>(node)->value;
+            if (fun->generic || fun->instance) continue;
+            return fun->precompiled;
+        }
+        if (node->rule != RULE_CLASS) continue;
+        for (const std::shared_ptr<Statement> &member : std::static_pointer_cast<Class>(node)->body) {
+            if (member->rule == RULE_FUNCTION) return std::static_pointer_cast<Function>(member)->value->precompiled;
+        }
+    }
+    return false;
+}
+
+// Determines if a block has instances of generic functions. They're created by the calls
+// the analyzer finds, so the modules that have them can't be recorded.
+static bool has_instances(const std::shared_ptr<Block> &block)
+{
+    for (const auto &[_, var] : block->variables) {
+        if (var.node && var.node->rule == RULE_FUNCTION && std::static_pointer_cast<FunctionValue>(var.node)->instance) return true;
+    }
+    return false;
+}
+
+// Returns the number of nodes of an expression of a function that can be inlined.
+// Returns INLINE_NODES + 1 if the expression has anything else, or calls the function itself.
+static size_t inline_size(const std::shared_ptr<Expression> &expression, const symbol_t function)
+{
+    size_t size = 1;
+    auto add = [&size, function](const std::shared_ptr<Expression> &child) { size = std::min(size + inline_size(child, function), static_cast<size_t>(INLINE_NODES + 1)); };
+    switch (expression->rule) {
+        case RULE_INTEGER: case RULE_FLOAT: case RULE_STRING: case RULE_BOOLEAN: case RULE_VARIABLE: { break; }
+        case RULE_GROUP: { add(std::static_pointer_cast<Group>(expression)->expression); break; }
+        case RULE_UNARY: { add(std::static_pointer_cast<Unary>(expression)->right); break; }
+        case RULE_CAST: { add(std::static_pointer_cast<Cast>(expression)->expression); break; }
+        case RULE_PROPERTY: { add(std::static_pointer_cast<Property>(expression)->object); break; }
+        case RULE_BINARY: {
+            add(std::static_pointer_cast<Binary>(expression)->left);
+            add(std::static_pointer_cast<Binary>(expression)->right);
+            break;
+        }
+        case RULE_LOGICAL: {
+            add(std::static_pointer_cast<Logical>(expression)->left);
+            add(std::static_pointer_cast<Logical>(expression)->right);
+            break;
+        }
+        case RULE_ACCESS: {
+            add(std::static_pointer_cast<Access>(expression)->target);
+            add(std::static_pointer_cast<Access>(expression)->index);
+            break;
+        }
+        case RULE_RANGE: {
+            add(std::static_pointer_cast<Range>(expression)->start);
+            add(std::static_pointer_cast<Range>(expression)->end);
+            break;
+        }
+        case RULE_CALL: {
+            const std::shared_ptr<Call> call = std::static_pointer_cast<Call>(expression);
+            const std::shared_ptr<Expression> &target = call->target;
+            if ((target->rule == RULE_VARIABLE && std::static_pointer_cast<Variable>(target)->symbol == function)
+                || (target->rule == RULE_PROPERTY && std::static_pointer_cast<Property>(target)->symbol == function)) return INLINE_NODES + 1;
+            add(target);
+            for (const std::shared_ptr<Expression> &argument : call->arguments) add(argument);
+            break;
+        }
+        default: { return INLINE_NODES + 1; }
+    }
+    return size;
+}
+
 reg_t Compiler::compile(const char *file)
 {
+    // The cache is skipped when the frontend output or the compile reports are requested,
+    // since they're only known while the functions are compiled.
+    bool use_cache = logger->use_cache && !logger->show_tokens && !logger->show_ast && !logger->tld_blocks
+        && !logger->show_opcodes && !logger->show_ir;
+    std::string source = std::string(file);
+    Parser::format_path(source);
+    BytecodeCache cache = BytecodeCache(source);
+    reg_t main;
+    if (use_cache && cache.load(*this->program, main)) {
+        if (logger->show_opcodes) this->program->memory->dump();
+        return main;
+    }
+    // The modules with an up to date compiled module are parsed without their function bodies.
+    if (use_cache) {
+        ModuleCache *modules = (this->module_cache = std::make_unique<ModuleCache>()).get();
+        loader->precompiled = [modules](const std::string &module, const uint64_t hash) { return modules->precompiled(module, hash); };
+    }
     Analyzer analyzer = Analyzer(file);
     std::shared_ptr<std::vector<std::shared_ptr<Statement>>>code = std::make_shared<std::vector<std::shared_ptr<Statement>>>();
     std::shared_ptr<Block> block = analyzer.analyze(code);
+    loader->precompiled = nullptr;
     // Register the TLDs.
     this->register_tld(code, block);
     // Allocate the main registers.
@@ -41,8 +144,13 @@ reg_t Compiler::compile(const char *file)
     // Add the exit opcode.
     this->add_opcodes({{ OP_EXIT }});
     // Dump the program opcodes to the stdout.
-    if (logger->show_opcodes) this->program->memory->dump();
-    return block->get_variable("main")->reg;
+    if (logger->show_opcodes) {
+        this->program->memory->dump();
+        if (this->dead_statements > 0) printf("Dead code eliminated: %zu statements (%zu bytecode words)\n", this->dead_statements, this->dead_code);
+    }
+    main = block->get_variable("main")->reg;
+    if (use_cache) cache.save(*this->program, main);
+    return main;
 }
 
 void Compiler::compile_module(const std::shared_ptr<std::vector<std::shared_ptr<Statement>>> &code, const std::shared_ptr<Block> &block)
@@ -50,6 +158,22 @@ void Compiler::compile_module(const std::shared_ptr<std::vector<std::shared_ptr<
     static std::vector<std::shared_ptr<std::vector<std::shared_ptr<Statement>>>> compiled_modules;
     std::vector<std::shared_ptr<Use>> delay_usages;
     this->blocks.push_back(block);
+    // Start the source locations again, so the module ones don't depend on the previous module.
+    this->current_file = 0;
+    this->current_line = static_cast<line_t>(-1);
+    this->current_column = static_cast<column_t>(-1);
+    // Precompiled modules are linked and the rest are recorded to be linked the next time.
+    bool record = false;
+    size_t code_start = this->program->memory->code.size(), constants_start = this->program->memory->constants.size();
+    CompiledModule module;
+    if (this->module_cache && !code->empty()) {
+        if (precompiled(*code)) this->link_module(code);
+        else record = !has_instances(block);
+    }
+    this->register_inline(*code);
+    // The function bodies are compiled after the declarations are collected (in declaration order).
+    std::vector<std::shared_ptr<Function>> functions;
+    std::vector<std::shared_ptr<Class>> classes;
     for (std::shared_ptr<Statement> &node : *code) {
         compiler_compile_module:
         switch (node->rule) {
@@ -67,10 +191,8 @@ void Compiler::compile_module(const std::shared_ptr<std::vector<std::shared_ptr<
                 for (const std::shared_ptr<Statement> &el : c->body) {
                     switch (el->rule) {
                         case RULE_FUNCTION: {
-                            const std::shared_ptr<Function> &fun = std::static_pointer_cast<Function>(el);
-                            this->compile_function(fun).copy_to(
-                                &this->program->memory->constants[class_constant_pool[c][fun->value->name]]
-                            );
+                            functions.push_back(std::static_pointer_cast<Function>(el));
+                            classes.push_back(c);
                             break;
                         }
                         default: { /* Do nothing */ }
@@ -80,9 +202,10 @@ void Compiler::compile_module(const std::shared_ptr<std::vector<std::shared_ptr<
             }
             case RULE_FUNCTION: {
                 std::shared_ptr<Function> fun = std::static_pointer_cast<Function>(node);
-                this->compile_function(fun).copy_to(
-                    this->program->main_frame.registers.get() + block->get_variable(fun->value->name)->reg
-                );
+                // Only the instances of the generic functions are compiled.
+                if (fun->value->generic) break;
+                functions.push_back(fun);
+                classes.push_back(nullptr);
                 break;
             }
             default: {
@@ -91,6 +214,18 @@ void Compiler::compile_module(const std::shared_ptr<std::vector<std::shared_ptr<
             }
         }
     }
+    const std::vector<Value> values = this->compile_functions(functions);
+    for (size_t i = 0; i < functions.size(); i++) {
+        const std::shared_ptr<FunctionValue> &fun = functions[i]->value;
+        const std::shared_ptr<Class> &c = classes[i];
+        if (record) {
+            const nfun_t *compiled = GETV(values[i].value, nfun_t *);
+            module.functions.push_back({ c ? c->name + "." + fun->name : fun->name, compiled->index - code_start, compiled->registers });
+        }
+        if (c) values[i].copy_to(&this->program->memory->constants[class_constant_pool[c][symbols->find(fun->name)]]);
+        else values[i].copy_to(this->program->main_frame.registers + block->get_variable(fun->name)->reg);
+    }
+    if (record) this->save_module(*logger->file(code->front()->file), code_start, constants_start, delay_usages, module);
     code->clear();
     if (logger->tld_blocks) this->blocks.back()->debug();
     this->blocks.pop_back();
@@ -105,6 +240,111 @@ void Compiler::compile_module(const std::shared_ptr<std::vector<std::shared_ptr<
     }
 }
 
+void Compiler::link_module(const std::shared_ptr<std::vector<std::shared_ptr<Statement>>> &code)
+{
+    const file_t file = code->front()->file;
+    CompiledModule module;
+    if (!this->module_cache->load(*logger->file(file), module)) {
+        logger->add_entity(file, 0, 0, "The compiled module is corrupted. Remove '" + *logger->file(file) + "o' and try again.");
+        exit(logger->crash());
+    }
+    Memory *memory = this->program->memory.get();
+    size_t code_start = memory->code.size(), constants_start = memory->constants.size();
+    // Add the module code and constants.
+    memory->code.insert(memory->code.end(), module.memory.code.begin(), module.memory.code.end());
+    for (Value &constant : module.memory.constants) memory->constants.push_back(std::move(constant));
+    // Set the operands that depend on where the module is linked.
+    for (const Relocation &relocation : module.relocations) {
+        size_t value;
+        if (relocation.type == RELOCATION_CONSTANT) value = constants_start + relocation.index;
+        else {
+            auto symbol = this->link_symbols.find(relocation.symbol);
+            if (symbol == this->link_symbols.end()) {
+                logger->add_entity(file, 0, 0, "The compiled module uses '" + relocation.symbol + "', but it's not declared. Remove '" + *logger->file(file) + "o' and try again.");
+                exit(logger->crash());
+            }
+            value = symbol->second;
+        }
+        if (relocation.offset >= module.memory.code.size() || (relocation.type == RELOCATION_CONSTANT && value >= memory->constants.size())) {
+            logger->add_entity(file, 0, 0, "The compiled module is corrupted. Remove '" + *logger->file(file) + "o' and try again.");
+            exit(logger->crash());
+        }
+        memory->code[code_start + relocation.offset] = value;
+    }
+    // Add the source locations.
+    for (const auto &[index, module_file] : module.memory.files) memory->files[code_start + index] = module_file;
+    for (const auto &[index, line] : module.memory.lines) memory->lines[code_start + index] = line;
+    for (const auto &[index, column] : module.memory.columns) memory->columns[code_start + index] = column;
+    // Set the entry point of the functions.
+    std::unordered_map<std::string, const CompiledFunction *> functions;
+    for (const CompiledFunction &function : module.functions) functions[function.name] = &function;
+    auto link_function = [&](const std::string &name, const std::shared_ptr<FunctionValue> &fun) {
+        auto function = functions.find(name);
+        if (function == functions.end() || function->second->entry >= module.memory.code.size()) {
+            logger->add_entity(file, fun->line, fun->column, "The compiled module has no function '" + name + "'. Remove '" + *logger->file(file) + "o' and try again.");
+            exit(logger->crash());
+        }
+        this->linked_functions[fun.get()] = { code_start + function->second->entry, function->second->registers };
+    };
+    for (std::shared_ptr<Statement> node : *code) {
+        if (node->rule == RULE_EXPORT) node = std::static_pointer_cast<Export>(node)->statement;
+        if (node->rule == RULE_FUNCTION) {
+            const std::shared_ptr<FunctionValue> &fun = std::static_pointer_cast<Function>(node)->value;
+            if (!fun->generic && !fun->instance) link_function(fun->name, fun);
+        } else if (node->rule == RULE_CLASS) {
+            std::shared_ptr<Class> c = std::static_pointer_cast<Class>(node);
+            for (const std::shared_ptr<Statement> &member : c->body) {
+                if (member->rule != RULE_FUNCTION) continue;
+                const std::shared_ptr<FunctionValue> &fun = std::static_pointer_cast<Function>(member)->value;
+                link_function(c->name + "." + fun->name, fun);
+            }
+        }
+    }
+    // The module source locations are unknown to the next module.
+    this->current_file = 0;
+    this->current_line = static_cast<line_t>(-1);
+    this->current_column = static_cast<column_t>(-1);
+}
+
+void Compiler::save_module(const std::string &file, const size_t code_start, const size_t constants_start, const std::vector<std::shared_ptr<Use>> &usages, CompiledModule &module)
+{
+    const Memory *memory = this->program->memory.get();
+    for (const std::shared_ptr<Use> &use : usages) module.dependencies[*use->module] = use->interface;
+    module.memory.code.assign(memory->code.begin() + code_start, memory->code.end());
+    module.memory.constants.assign(memory->constants.begin() + constants_start, memory->constants.end());
+    // Find the operands that depend on where the module is linked.
+    for (size_t i = 0; i < module.memory.code.size(); i++) {
+        for (const OpCodeType &ot : *opcode_operands(module.memory.code[i])) {
+            size_t offset = ++i, operand = module.memory.code[offset];
+            switch (ot) {
+                case OT_CONST: {
+                    if (operand >= constants_start) {
+                        module.relocations.push_back({ offset, RELOCATION_CONSTANT, operand - constants_start, "" });
+                        break;
+                    }
+                    auto symbol = this->member_symbols.find(operand);
+                    // The module can't be linked if it uses other constants.
+                    if (symbol == this->member_symbols.end()) return;
+                    module.relocations.push_back({ offset, RELOCATION_MEMBER, 0, symbol->second });
+                    break;
+                }
+                case OT_GLOBAL: {
+                    auto symbol = this->global_symbols.find(operand);
+                    if (symbol == this->global_symbols.end()) return;
+                    module.relocations.push_back({ offset, RELOCATION_GLOBAL, 0, symbol->second });
+                    break;
+                }
+                default: { /* Do nothing */ }
+            }
+        }
+    }
+    // Add the source locations relative to the module.
+    for (const auto &[index, module_file] : memory->files) if (index >= code_start) module.memory.files[index - code_start] = module_file;
+    for (const auto &[index, line] : memory->lines) if (index >= code_start) module.memory.lines[index - code_start] = line;
+    for (const auto &[index, column] : memory->columns) if (index >= code_start) module.memory.columns[index - code_start] = column;
+    this->module_cache->save(file, module);
+}
+
 void Compiler::register_tld(const std::shared_ptr<std::vector<std::shared_ptr<Statement>>> &code, const std::shared_ptr<Block> &block)
 {
     static std::vector<std::shared_ptr<std::vector<std::shared_ptr<Statement>>>> registered_modules;
@@ -123,19 +363,39 @@ void Compiler::register_tld(const std::shared_ptr<std::vector<std::shared_ptr<St
             }
             case RULE_CLASS: {
                 std::shared_ptr<Class> c = std::static_pointer_cast<Class>(tld);
-                for (auto &[vn, vt] : c->block->variables) {
+                // The members are registered in declaration order, so their
+                // registers only change when the class interface does.
+                for (const std::shared_ptr<Statement> &member : c->body) {
+                    std::string name;
+                    switch (member->rule) {
+                        case RULE_DECLARATION: { name = std::static_pointer_cast<Declaration>(member)->name; break; }
+                        case RULE_FUNCTION: { name = std::static_pointer_cast<Function>(member)->value->name; break; }
+                        default: { continue; }
+                    }
+                    symbol_t vn = symbols->find(name);
+                    BlockVariableType &vt = c->block->variables.at(vn);
                     // Set the class register.
                     vt.reg = this->local.get_register(true);
                     // Set the constant register.
-                    class_constant_pool[c][vn] = this->add_constant({ vt.type });
+                    this->program->memory->constants.push_back({ vt.type });
+                    size_t constant = class_constant_pool[c][vn] = this->program->memory->constants.size() - 1;
+                    // Set the member symbol.
+                    std::string symbol = *logger->file(c->file) + ":" + c->name + "." + name;
+                    this->member_symbols[constant] = symbol;
+                    this->link_symbols[symbol] = constant;
                 }
                 this->local.reset();
                 break;
             }
             case RULE_FUNCTION: {
                 std::shared_ptr<FunctionValue> fun = std::static_pointer_cast<Function>(tld)->value;
+                if (fun->generic) break;
                 BlockVariableType *var = block->get_variable(fun->name);
                 var->reg = this->global.get_register(true);
+                // Set the function symbol.
+                std::string symbol = *logger->file(tld->file) + ":" + fun->name;
+                this->global_symbols[var->reg] = symbol;
+                this->link_symbols[symbol] = var->reg;
                 break;
             }
             default: {
@@ -158,12 +418,65 @@ void Compiler::register_tld(const std::shared_ptr<std::vector<std::shared_ptr<St
             BlockVariableType *var = use->block->get_variable(name);
             if (var) block->get_variable(name)->reg = var->reg;
         }
+        // Register the instances of its generic functions with the same register as use block.
+        for (auto &[symbol, var] : block->variables) {
+            if (!var.node || var.node->rule != RULE_FUNCTION || *logger->file(var.node->file) != *use->module) continue;
+            if (std::static_pointer_cast<FunctionValue>(var.node)->instance) var.reg = use->block->get_variable(symbol)->reg;
+        }
     }
     // block->debug();
 }
 
+void Compiler::measure_dead(const std::shared_ptr<Statement> &rule)
+{
+    // Nested dead statements are part of the one being measured.
+    if (this->measuring_dead) {
+        this->compile(rule);
+        return;
+    }
+    Memory *memory = this->program->memory.get();
+    const size_t code_start = memory->code.size(), constants_start = this->constants.size();
+    const FrameInfo local = this->local;
+    const std::vector<reg_t> dead_variables = this->dead_variables, protected_dead_variables = this->protected_dead_variables;
+    const file_t current_file = this->current_file;
+    const line_t current_line = this->current_line;
+    const column_t current_column = this->current_column;
+    const auto file = memory->files.find(code_start);
+    const auto line = memory->lines.find(code_start);
+    const auto column = memory->columns.find(code_start);
+    const std::shared_ptr<const std::string> start_file = file != memory->files.end() ? file->second : nullptr;
+    const bool has_line = line != memory->lines.end(), has_column = column != memory->columns.end();
+    const line_t start_line = has_line ? line->second : 0;
+    const column_t start_column = has_column ? column->second : 0;
+    this->measuring_dead = true;
+    this->compile(rule);
+    this->measuring_dead = false;
+    this->dead_statements++;
+    this->dead_code += memory->code.size() - code_start;
+    // Remove the compiled code again.
+    memory->code.resize(code_start);
+    this->constants.resize(constants_start);
+    std::erase_if(memory->files, [code_start](const auto &entry) { return entry.first >= code_start; });
+    std::erase_if(memory->lines, [code_start](const auto &entry) { return entry.first >= code_start; });
+    std::erase_if(memory->columns, [code_start](const auto &entry) { return entry.first >= code_start; });
+    if (start_file) memory->files[code_start] = start_file;
+    if (has_line) memory->lines[code_start] = start_line;
+    if (has_column) memory->columns[code_start] = start_column;
+    this->local = local;
+    this->dead_variables = dead_variables;
+    this->protected_dead_variables = protected_dead_variables;
+    this->current_file = current_file;
+    this->current_line = current_line;
+    this->current_column = current_column;
+}
+
 void Compiler::compile(const std::shared_ptr<Statement> &rule)
 {
+    // Dead statements are not compiled (they are only measured to show the removed code).
+    if (rule->dead && !this->measuring_dead) {
+        if (logger->show_opcodes) this->measure_dead(rule);
+        return;
+    }
     // Check if the local registers were reset.
     if (logger->linear_scan) {
         if (this->local.current_register == 0 && this->dead_variables.size() > 0) {
@@ -237,6 +550,21 @@ void Compiler::compile(const std::shared_ptr<Statement> &rule)
         }
         case RULE_IF: {
             std::shared_ptr<If> rif = std::static_pointer_cast<If>(rule);
+            // Only the taken branch of a constant condition is compiled.
+            if (rif->condition->rule == RULE_BOOLEAN) {
+                bool condition = std::static_pointer_cast<Boolean>(rif->condition)->value;
+                if (!(condition ? rif->then_branch : rif->else_branch).empty()) {
+                    this->blocks.push_back(condition ? rif->then_block : rif->else_block);
+                    for (const std::shared_ptr<Statement> &stmt : condition ? rif->then_branch : rif->else_branch) this->compile(stmt);
+                    this->blocks.pop_back();
+                }
+                if (logger->show_opcodes && !(condition ? rif->else_branch : rif->then_branch).empty()) {
+                    this->blocks.push_back(condition ? rif->else_block : rif->then_block);
+                    for (const std::shared_ptr<Statement> &stmt : condition ? rif->else_branch : rif->then_branch) this->measure_dead(stmt);
+                    this->blocks.pop_back();
+                }
+                break;
+            }
             reg_t rx = this->compile(rif->condition);
             SET_SOURCE_LOCATION(rule);
             this->add_opcodes({{ OP_CFNJUMP, 0, rx }});
@@ -435,9 +763,7 @@ reg_t Compiler::compile(
                     SET_SOURCE_LOCATION(rule);
                     this->add_opcodes({{ OP_LOAD_C, result = suggested_register ? *suggested_register : this->local.get_register() }});
                 }
-                Value v = Value(list->type);
-                this->constant_list(list, v);
-                this->add_opcodes({{ this->add_constant(v) }});
+                this->add_opcodes({{ this->add_constant(std::static_pointer_cast<Expression>(list)) }});
             } else {
                 result = suggested_register ? *suggested_register : this->local.get_register();
                 // The list needs to be constructed from the groud up
@@ -465,9 +791,7 @@ reg_t Compiler::compile(
                     SET_SOURCE_LOCATION(rule);
                     this->add_opcodes({{ OP_LOAD_C, result = suggested_register ? *suggested_register : this->local.get_register() }});
                 }
-                Value v = dict->type;
-                this->constant_dict(dict, v);
-                this->add_opcodes({{ this->add_constant(v) }});
+                this->add_opcodes({{ this->add_constant(std::static_pointer_cast<Expression>(dict)) }});
             } else {
                 result = suggested_register ? *suggested_register : this->local.get_register();
                 // The list needs to be constructed from the groud up
@@ -496,22 +820,19 @@ reg_t Compiler::compile(
                 this->add_opcodes({{ OP_LOAD_C, result = suggested_register ? *suggested_register : this->local.get_register() }});
             }
             // Create the constant object.
-            std::vector<std::string> props;
-            for (const auto &[name, type] : object->c->block->variables) props.push_back(name);
-            size_t objr = this->add_constant({ object->c->name, props });
-            this->add_opcodes({{ objr }});
+            this->add_opcodes({{ this->add_constant(object->c) }});
             // Assign each register its corresponding values.
-            for (const auto &[name, type] : object->c->block->variables) {
+            for (const auto &[symbol, type] : object->c->block->variables) {
                 reg_t val;
                 // Check if the value is part of the init arguments.
                 for (const auto &[n, e] : object->arguments) {
-                    if (n == name) {
+                    if (n == symbols->name(symbol)) {
                         val = this->compile(e);
                         goto object_add_prop;
                     }
                 }
                 SET_SOURCE_LOCATION(rule);
-                this->add_opcodes({{ OP_LOAD_C, val = this->local.get_register(), class_constant_pool[object->c][name] }});
+                this->add_opcodes({{ OP_LOAD_C, val = this->local.get_register(), class_constant_pool.at(object->c).at(symbol) }});
                 object_add_prop:
                 SET_SOURCE_LOCATION(rule);
                 this->add_opcodes({{ OP_SPROP, type.reg, result, val }});
@@ -566,7 +887,7 @@ reg_t Compiler::compile(
         }
         case RULE_VARIABLE: {
             // std::pair<BlockVariableType *, bool> var = this->get_variable(std::static_pointer_cast<Variable>(rule)->name);
-            const auto [variable, is_global] = this->get_variable(std::static_pointer_cast<Variable>(rule)->name);
+            const auto [variable, is_global] = this->get_variable(std::static_pointer_cast<Variable>(rule)->symbol);
             if (is_global) {
                 // The variable is global, and needs to be loaded first.
                 result = suggested_register ? *suggested_register : this->local.get_register();
@@ -596,7 +917,7 @@ reg_t Compiler::compile(
                     // Check if it's a global variable.
                     if (assign->target->rule == RULE_VARIABLE) {
                         // Check if the assignment is to a global variable
-                        const auto [variable, is_global] = this->get_variable(std::static_pointer_cast<Variable>(assign->target)->name);
+                        const auto [variable, is_global] = this->get_variable(std::static_pointer_cast<Variable>(assign->target)->symbol);
                         if (is_global) {
                             // Assign it to it.
                             SET_SOURCE_LOCATION(rule);
@@ -646,6 +967,11 @@ reg_t Compiler::compile(
         }
         case RULE_CALL: {
             std::shared_ptr<Call> call = std::static_pointer_cast<Call>(rule);
+            // Small functions are inlined at the calls that always call them.
+            if (const auto function = this->inline_target(call)) {
+                result = this->compile_inline(call, *function, suggested_register);
+                break;
+            }
             reg_t target;
             if (call->is_method) {
                 reg_t objr;
@@ -710,7 +1036,7 @@ reg_t Compiler::compile(
                     // Re-assign the result to the prop.
                     SET_SOURCE_LOCATION(rule);
                     this->add_opcodes({{
-                        OP_SPROP, prop->c->block->get_variable(prop->name)->reg,
+                        OP_SPROP, prop->c->block->get_variable(prop->symbol)->reg,
                         objr, target,
                     }});
                     this->local.free_register(objr);
@@ -744,7 +1070,7 @@ reg_t Compiler::compile(
                     // Re-assign the result to the prop.
                     SET_SOURCE_LOCATION(rule);
                     this->add_opcodes({{
-                        OP_SPROP, prop->c->block->get_variable(prop->name)->reg,
+                        OP_SPROP, prop->c->block->get_variable(prop->symbol)->reg,
                         objr, target,
                     }});
                     this->local.free_register(objr);
@@ -833,14 +1159,14 @@ reg_t Compiler::compile(
                 result = this->compile(assignment_value);
                 SET_SOURCE_LOCATION(rule);
                 this->add_opcodes({{
-                    OP_SPROP, prop->c->block->get_variable(prop->name)->reg,
+                    OP_SPROP, prop->c->block->get_variable(prop->symbol)->reg,
                     ry, result,
                 }});
             } else {
                 SET_SOURCE_LOCATION(rule);
                 this->add_opcodes({{
                     OP_LPROP, result = suggested_register ? *suggested_register : this->local.get_register(),
-                    ry, prop->c->block->get_variable(prop->name)->reg
+                    ry, prop->c->block->get_variable(prop->symbol)->reg
                 }});
             }
             if (object_reg) *object_reg = ry;
@@ -855,10 +1181,10 @@ reg_t Compiler::compile(
     return result;
 }
 
-std::pair<BlockVariableType *, bool> Compiler::get_variable(const std::string &name)
+std::pair<BlockVariableType *, bool> Compiler::get_variable(const symbol_t symbol)
 {
     for (size_t i = this->blocks.size() - 1;; i--) {
-        BlockVariableType *var = this->blocks[i]->get_variable(name);
+        BlockVariableType *var = this->blocks[i]->get_variable(symbol);
         if (var) return { var, i == 0 };
         else if (i == 0) return { nullptr, false };
     }
@@ -866,6 +1192,14 @@ std::pair<BlockVariableType *, bool> Compiler::get_variable(const std::string &n
     return { nullptr, false }; // Compiler warning... Totally useless.
 }
 
+std::pair<BlockVariableType *, bool> Compiler::get_variable(const std::string &name)
+{
+    // Resolve the name once instead of hashing it on each block.
+    symbol_t symbol = symbols->find(name);
+    if (symbol == SYMBOL_NONE) return { nullptr, false };
+    return this->get_variable(symbol);
+}
+
 BlockClassType *Compiler::get_class(const std::string &name)
 {
     for (size_t i = this->blocks.size() - 1;; i--) {
@@ -882,30 +1216,55 @@ void Compiler::add_opcodes(const std::vector<opcode_t> &opcodes)
     for (const opcode_t &op : opcodes) this->program->memory->code.push_back(op);
 }
 
-size_t Compiler::add_constant(const Value &value)
+size_t Compiler::add_constant(const constant_t &constant)
+{
+    this->constants.push_back(constant);
+    return this->constants_base + this->constants.size() - 1;
+}
+
+Value Compiler::make_constant(const constant_t &constant)
 {
-    this->program->memory->constants.push_back(std::move(value));
-    return this->program->memory->constants.size() - 1;
+    if (const nint_t *value = std::get_if<nint_t>(&constant)) return Value(*value);
+    if (const nfloat_t *value = std::get_if<nfloat_t>(&constant)) return Value(*value);
+    if (const nbool_t *value = std::get_if<nbool_t>(&constant)) return Value(*value);
+    if (const nstring_t *value = std::get_if<nstring_t>(&constant)) return Value(*value);
+    if (const auto type = std::get_if<std::shared_ptr<Type>>(&constant)) return Value(*type);
+    if (const auto c = std::get_if<std::shared_ptr<Class>>(&constant)) {
+        std::vector<std::string> props = std::vector<std::string>((*c)->block->variables.size());
+        for (const auto &[symbol, type] : (*c)->block->variables) props[type.reg] = symbols->name(symbol);
+        return Value((*c)->name, props);
+    }
+    const std::shared_ptr<Expression> &expression = std::get<std::shared_ptr<Expression>>(constant);
+    if (expression->rule == RULE_LIST) {
+        const std::shared_ptr<List> list = std::static_pointer_cast<List>(expression);
+        Value v = Value(list->type);
+        this->constant_list(list, v);
+        return v;
+    }
+    const std::shared_ptr<Dictionary> dict = std::static_pointer_cast<Dictionary>(expression);
+    Value v = Value(dict->type);
+    this->constant_dict(dict, v);
+    return v;
 }
 
 void Compiler::constant_list(const std::shared_ptr<List> &list, Value &dest)
 {
     for (const std::shared_ptr<Expression> &value : list->value) {
         switch (value->rule) {
-            case RULE_INTEGER: { std::get<std::shared_ptr<nlist_t>>(dest.value)->push_back({ std::static_pointer_cast<Integer>(value)->value }); break; }
-            case RULE_FLOAT: { std::get<std::shared_ptr<nlist_t>>(dest.value)->push_back({ std::static_pointer_cast<Float>(value)->value }); break; }
-            case RULE_BOOLEAN: { std::get<std::shared_ptr<nlist_t>>(dest.value)->push_back({ std::static_pointer_cast<Boolean>(value)->value }); break; }
-            case RULE_STRING:  { std::get<std::shared_ptr<nlist_t>>(dest.value)->push_back({ std::static_pointer_cast<String>(value)->value }); break; }
+            case RULE_INTEGER: { std::get<nlist_t *>(dest.value)->push_back({ std::static_pointer_cast<Integer>(value)->value }); break; }
+            case RULE_FLOAT: { std::get<nlist_t *>(dest.value)->push_back({ std::static_pointer_cast<Float>(value)->value }); break; }
+            case RULE_BOOLEAN: { std::get<nlist_t *>(dest.value)->push_back({ std::static_pointer_cast<Boolean>(value)->value }); break; }
+            case RULE_STRING:  { std::get<nlist_t *>(dest.value)->push_back({ std::static_pointer_cast<String>(value)->value }); break; }
             case RULE_LIST: {
                 Value v = Value(std::static_pointer_cast<List>(value)->type);
                 this->constant_list(std::static_pointer_cast<List>(value), v);
-                std::get<std::shared_ptr<nlist_t>>(dest.value)->push_back(std::move(v));
+                std::get<nlist_t *>(dest.value)->push_back(std::move(v));
                 break;
             }
             case RULE_DICTIONARY: {
                 Value v = Value(std::static_pointer_cast<Dictionary>(value)->type);
                 this->constant_dict(std::static_pointer_cast<Dictionary>(value), v);
-                std::get<std::shared_ptr<nlist_t>>(dest.value)->push_back(std::move(v));
+                std::get<nlist_t *>(dest.value)->push_back(std::move(v));
                 break;
             }
             default: {
@@ -920,20 +1279,20 @@ void Compiler::constant_dict(const std::shared_ptr<Dictionary> &dict, Value &des
 {
     for (const auto &[key, value] : dict->value) {
         switch (value->rule) {
-            case RULE_INTEGER: { std::get<std::shared_ptr<ndict_t>>(dest.value)->insert(key, { std::static_pointer_cast<Integer>(value)->value }); break; }
-            case RULE_FLOAT: { std::get<std::shared_ptr<ndict_t>>(dest.value)->insert(key, { std::static_pointer_cast<Float>(value)->value }); break; }
-            case RULE_BOOLEAN: { std::get<std::shared_ptr<ndict_t>>(dest.value)->insert(key, { std::static_pointer_cast<Boolean>(value)->value }); break; }
-            case RULE_STRING:  { std::get<std::shared_ptr<ndict_t>>(dest.value)->insert(key, { std::static_pointer_cast<String>(value)->value }); break; }
+            case RULE_INTEGER: { std::get<ndict_t *>(dest.value)->insert(key, { std::static_pointer_cast<Integer>(value)->value }); break; }
+            case RULE_FLOAT: { std::get<ndict_t *>(dest.value)->insert(key, { std::static_pointer_cast<Float>(value)->value }); break; }
+            case RULE_BOOLEAN: { std::get<ndict_t *>(dest.value)->insert(key, { std::static_pointer_cast<Boolean>(value)->value }); break; }
+            case RULE_STRING:  { std::get<ndict_t *>(dest.value)->insert(key, { std::static_pointer_cast<String>(value)->value }); break; }
             case RULE_LIST: {
                 Value v = Value(std::static_pointer_cast<List>(value)->type);
                 this->constant_list(std::static_pointer_cast<List>(value), v);
-                std::get<std::shared_ptr<ndict_t>>(dest.value)->insert(key, std::move(v));
+                std::get<ndict_t *>(dest.value)->insert(key, std::move(v));
                 break;
             }
             case RULE_DICTIONARY: {
                 Value v = Value(std::static_pointer_cast<Dictionary>(value)->type);
                 this->constant_dict(std::static_pointer_cast<Dictionary>(value), v);
-                std::get<std::shared_ptr<ndict_t>>(dest.value)->insert(key, std::move(v));
+                std::get<ndict_t *>(dest.value)->insert(key, std::move(v));
                 break;
             }
             default: {
@@ -967,9 +1326,9 @@ bool Compiler::is_constant(const std::shared_ptr<Expression> &expression)
     }
 }
 
-void Compiler::set_file(const std::shared_ptr<const std::string> &file)
+void Compiler::set_file(const file_t file)
 {
-    this->program->memory->files[this->program->memory->code.size()] = file;
+    this->program->memory->files[this->program->memory->code.size()] = logger->file(file);
     this->current_file = file;
 }
 
@@ -984,13 +1343,180 @@ void Compiler::set_column(const column_t column)
     this->current_column = column;
 }
 
-Value Compiler::compile_function(const std::shared_ptr<Function> &f)
+void Compiler::register_inline(const std::vector<std::shared_ptr<Statement>> &code)
+{
+    // The functions of the previous module may still be used by its compilers, so a new table is used.
+    std::shared_ptr<std::unordered_map<const Node *, InlineFunction>> inline_functions = std::make_shared<std::unordered_map<const Node *, InlineFunction>>();
+    this->inline_functions = inline_functions;
+    if (!logger->inline_functions) return;
+    // Only the functions with a few guarded returns of small expressions before the last return are inlined.
+    auto add = [&inline_functions](const std::shared_ptr<FunctionValue> &fun) {
+        if (fun->precompiled || fun->body.empty()) return;
+        InlineFunction function = { fun, std::make_shared<Block>(*fun->block), {} };
+        const symbol_t symbol = symbols->find(fun->name);
+        size_t size = 0;
+        for (size_t i = 0; i < fun->body.size(); i++) {
+            std::shared_ptr<Statement> statement = fun->body[i];
+            std::shared_ptr<Expression> condition;
+            if (statement->dead) return;
+            if (statement->rule == RULE_IF && i + 1 < fun->body.size()) {
+                const std::shared_ptr<If> rif = std::static_pointer_cast<If>(statement);
+                if (rif->then_branch.size() != 1 || !rif->else_branch.empty()) return;
+                condition = rif->condition;
+                statement = rif->then_branch.front();
+                size += inline_size(condition, symbol);
+            }
+            if (statement->rule != RULE_RETURN || (!condition && i + 1 < fun->body.size())) return;
+            const std::shared_ptr<Expression> &value = std::static_pointer_cast<Return>(statement)->value;
+            if (!value || (size += inline_size(value, symbol)) > INLINE_NODES) return;
+            function.cases.push_back({ condition, value });
+        }
+        (*inline_functions)[fun.get()] = std::move(function);
+    };
+    for (std::shared_ptr<Statement> node : code) {
+        if (node->rule == RULE_EXPORT) node = std::static_pointer_cast<Export>(node)->statement;
+        if (node->rule == RULE_FUNCTION) add(std::static_pointer_cast<Function>(node)->value);
+        if (node->rule != RULE_CLASS) continue;
+        for (const std::shared_ptr<Statement> &member : std::static_pointer_cast<Class>(node)->body) {
+            if (member->rule == RULE_FUNCTION) add(std::static_pointer_cast<Function>(member)->value);
+        }
+    }
+}
+
+const InlineFunction *Compiler::inline_target(const std::shared_ptr<Call> &call)
+{
+    if (this->inline_functions->empty() || !call->has_return) return nullptr;
+    // The methods are the class ones and the global variables are the top level functions.
+    const Node *node;
+    if (call->is_method && call->target->rule == RULE_PROPERTY) {
+        const std::shared_ptr<Property> prop = std::static_pointer_cast<Property>(call->target);
+        node = prop->c->block->get_variable(prop->symbol)->node.get();
+    } else if (!call->is_method && call->target->rule == RULE_VARIABLE) {
+        const auto [variable, is_global] = this->get_variable(std::static_pointer_cast<Variable>(call->target)->symbol);
+        if (!is_global) return nullptr;
+        node = variable->node.get();
+    } else return nullptr;
+    const auto function = this->inline_functions->find(node);
+    if (function == this->inline_functions->end()) return nullptr;
+    if (std::find(this->compiling.begin(), this->compiling.end(), function->second.function.get()) != this->compiling.end()) return nullptr;
+    return &function->second;
+}
+
+reg_t Compiler::compile_inline(const std::shared_ptr<Call> &call, const InlineFunction &function, const reg_t *suggested_register)
+{
+    const std::shared_ptr<FunctionValue> &fun = function.function;
+    // Compile the object of the method and the arguments into the parameter registers.
+    std::vector<std::shared_ptr<Expression>> arguments = call->arguments;
+    if (call->is_method) arguments.insert(arguments.begin(), std::static_pointer_cast<Property>(call->target)->object);
+    std::vector<reg_t> parameters;
+    for (const std::shared_ptr<Expression> &argument : arguments) {
+        const reg_t rx = this->local.get_register(true);
+        this->compile(argument, true, &rx);
+        parameters.push_back(rx);
+    }
+    // An uninitialized object fails at the method (like the method load of a call that isn't inlined).
+    if (call->is_method) {
+        SET_SOURCE_LOCATION(call->target);
+        this->add_opcodes({{ OP_CHECK_OBJECT, parameters.front() }});
+    }
+    // The returned values are compiled in a copy of the function block (over the module one), since
+    // the function and the other calls to it may be compiled at the same time.
+    std::shared_ptr<Block> block = std::make_shared<Block>(*function.block);
+    std::vector<std::shared_ptr<Block>> blocks = { this->blocks.front(), block };
+    std::swap(this->blocks, blocks);
+    for (size_t i = 0; i < fun->parameters.size(); i++) block->get_variable(fun->parameters[i]->name)->reg = parameters[i];
+    this->compiling.push_back(fun.get());
+    const reg_t result = suggested_register ? *suggested_register : this->local.get_register();
+    std::vector<size_t> jumps;
+    for (const auto &[condition, value] : function.cases) {
+        if (!condition) {
+            this->compile(value, true, &result);
+            break;
+        }
+        reg_t rx = this->compile(condition);
+        SET_SOURCE_LOCATION(condition);
+        this->add_opcodes({{ OP_CFNJUMP, 0, rx }});
+        size_t jump_index = this->program->memory->code.size() - 2;
+        this->local.free_register(rx);
+        this->compile(value, true, &result);
+        // Jump to the end after the value is set.
+        SET_SOURCE_LOCATION(value);
+        this->add_opcodes({{ OP_FJUMP, 0 }});
+        jumps.push_back(this->program->memory->code.size() - 1);
+        this->program->memory->code[jump_index] = this->program->memory->code.size() - (jump_index - 1);
+    }
+    for (const size_t jump : jumps) this->program->memory->code[jump] = this->program->memory->code.size() - (jump - 1);
+    this->compiling.pop_back();
+    std::swap(this->blocks, blocks);
+    // The parameter registers are freed now instead of at their last use.
+    for (const reg_t parameter : parameters) {
+        this->dead_variables.erase(std::remove(this->dead_variables.begin(), this->dead_variables.end(), parameter), this->dead_variables.end());
+        this->local.free_register(parameter, true);
+    }
+    return result;
+}
+
+std::vector<Value> Compiler::compile_functions(const std::vector<std::shared_ptr<Function>> &functions)
+{
+    // Each function body is compiled by its own compiler, so the workers only share the
+    // syntax tree and the module declarations (which are not modified while compiling).
+    std::vector<std::unique_ptr<Compiler>> compilers(functions.size());
+    std::atomic<size_t> next = 0;
+    // The errors are reported once the workers are joined, so no thread exits while they run.
+    std::exception_ptr error;
+    std::mutex error_mutex;
+    auto work = [&]() {
+        logger->defer_crashes(true);
+        for (size_t i; (i = next++) < functions.size();) {
+            // The precompiled functions are already linked.
+            if (functions[i]->value->precompiled) continue;
+            compilers[i] = std::unique_ptr<Compiler>(new Compiler(this));
+            try {
+                compilers[i]->compile_function(functions[i]);
+            } catch (const LoggerCrash &) {
+                std::lock_guard<std::mutex> lock(error_mutex);
+                if (!error) error = std::current_exception();
+                next = functions.size();
+            }
+        }
+        logger->defer_crashes(false);
+    };
+    const unsigned int count = std::min<size_t>(std::thread::hardware_concurrency(), functions.size());
+    std::vector<std::thread> workers;
+    for (unsigned int i = 1; i < count; i++) workers.push_back(std::thread(work));
+    work();
+    for (std::thread &worker : workers) worker.join();
+    if (error) {
+        try {
+            std::rethrow_exception(error);
+        } catch (const LoggerCrash &crash) {
+            exit(logger->crash(crash));
+        }
+    }
+    // The functions are linked in order, so the program is the same with any number of workers.
+    std::vector<Value> values;
+    for (size_t i = 0; i < functions.size(); i++) {
+        if (compilers[i]) {
+            values.push_back(this->link_function(functions[i], *compilers[i]));
+            continue;
+        }
+        const std::pair<size_t, registers_size_t> &linked = this->linked_functions.at(functions[i]->value.get());
+        values.push_back(Value(linked.first, linked.second, Type(functions[i])));
+    }
+    return values;
+}
+
+void Compiler::compile_function(const std::shared_ptr<Function> &f)
 {
     const std::shared_ptr<FunctionValue> &fun = f->value;
-    // Get the entry point of the function.
-    size_t entry = this->program->memory->code.size();
     // Push the function block.
     this->blocks.push_back(fun->block);
+    this->compiling.push_back(fun.get());
+    // The memoized functions look for the result of their arguments before popping them.
+    if (fun->memoize) {
+        SET_SOURCE_LOCATION(fun);
+        this->add_opcodes({{ OP_MEMO, this->add_constant(fun->name), fun->parameters.size() }});
+    }
     // Pop the function parameters.
     if (fun->parameters.size() > 0) {
         for (size_t i = fun->parameters.size() - 1;; i--) {
@@ -1010,16 +1536,54 @@ Value Compiler::compile_function(const std::shared_ptr<Function> &f)
     }
     // Compile the function body.
     for (const std::shared_ptr<Statement> &statement : fun->body) this->compile(statement);
-    // Clear the function body (so that the elements may be freed)
-    fun->body.clear();
     this->blocks.pop_back();
-    // Get the number of registers needed.
-    registers_size_t regs = this->local.current_register;
-    // Reset the local frame info.
-    this->local.reset();
+    this->compiling.pop_back();
+}
+
+Value Compiler::link_function(const std::shared_ptr<Function> &f, Compiler &function)
+{
+    const std::shared_ptr<FunctionValue> &fun = f->value;
+    // Clear the function body (so that the elements may be freed). It's done here since
+    // the nodes of a module are freed from its arena, which is not thread safe.
+    fun->body.clear();
+    Memory *memory = this->program->memory.get(), *code = function.program->memory.get();
+    // The function is optimized in its own memory (so the passes only see its source locations)
+    // with the program constants, since the passes read and add constants.
+    const size_t constants_start = memory->constants.size();
+    std::swap(memory->constants, code->constants);
+    for (const constant_t &constant : function.constants) code->constants.push_back(this->make_constant(constant));
+    // The jumps are relative, so only the constants of the function depend on where it's linked.
+    for (size_t i = 0; i < code->code.size(); i++) {
+        for (const OpCodeType &ot : *opcode_operands(code->code[i])) {
+            opcode_t &operand = code->code[++i];
+            if (ot == OT_CONST && operand >= function.constants_base) operand += constants_start - function.constants_base;
+        }
+    }
+    // Optimize the function in SSA form and lower it back to the bytecode.
+    registers_size_t regs = function.local.current_register;
+    IRFunction ir(code, 0, regs);
+    if (ir.built) {
+        IRPassManager().run(ir);
+        if (logger->show_ir) ir.dump(fun->name);
+        regs = ir.lower();
+    }
+    // Allocate the registers by liveness and get the number of registers needed.
+    regs = RegisterAllocator(code).allocate(0, regs);
+    // Optimize the function bytecode.
+    Peephole(code).optimize(0);
+    std::swap(memory->constants, code->constants);
+    // Get the entry point of the function and add its code.
+    const size_t entry = memory->code.size();
+    memory->code.insert(memory->code.end(), code->code.begin(), code->code.end());
+    for (const auto &[index, file] : code->files) memory->files[entry + index] = file;
+    for (const auto &[index, line] : code->lines) memory->lines[entry + index] = line;
+    for (const auto &[index, column] : code->columns) memory->columns[entry + index] = column;
+    this->dead_statements += function.dead_statements;
+    this->dead_code += function.dead_code;
     // Create the function value and return it.
     Value v = Value(entry, regs, Type(f));
     return v;
 }
 
 #undef ADD_LOG
+#undef INLINE_NODES
@@ -0,0 +1,136 @@
+/**
+ * |----------------------|
+ * | Nuua Escape Analysis |
+ * |----------------------|
+ *
+ * Copyright 2019 Erik Campobadal <soc@erik.cat>
+ * https://nuua.io
+ */
+#include "../include/ir.hpp"
+#include <unordered_set>
+
+// Determines if an operand of an instruction only reads or writes the object or list
+// (so a value used only by these operands never escapes the function).
+static bool is_access(const opcode_t opcode, const size_t operand)
+{
+    switch (opcode) {
+        case OP_LPROP: case OP_LGET: case OP_LGET_U: { return operand == 0; }
+        case OP_SPROP: { return operand == 1; }
+        case OP_CAST_LIST_INT: case OP_CHECK_OBJECT: { return true; }
+        default: { return false; }
+    }
+}
+
+bool ir_scalar_replacement(IRFunction &function)
+{
+    function.compute_dominators();
+    Memory *memory = function.memory;
+    // Stores the instruction that sets each value, the accesses to each value
+    // (block and instruction) and the values that escape.
+    std::vector<IRInstruction *> definitions(function.values.size(), nullptr);
+    std::vector<std::vector<std::pair<size_t, size_t>>> accesses(function.values.size());
+    std::vector<bool> escapes(function.values.size(), false);
+    for (size_t b = 0; b < function.blocks.size(); b++) {
+        IRBlock &block = function.blocks[b];
+        for (const IRPhi &phi : block.phis) for (const ir_value_t input : phi.inputs) escapes[input] = true;
+        if (block.condition != IR_NONE) escapes[block.condition] = true;
+        for (size_t i = 0; i < block.instructions.size(); i++) {
+            IRInstruction &instruction = block.instructions[i];
+            if (instruction.result != IR_NONE) definitions[instruction.result] = &instruction;
+            for (size_t k = 0; k < instruction.operands.size(); k++) {
+                const IROperand &operand = instruction.operands[k];
+                if (!operand.value) continue;
+                if (is_access(instruction.opcode, k)) accesses[operand.word].push_back({ b, i });
+                else escapes[operand.word] = true;
+            }
+        }
+    }
+    // The values that load the same constant share the object or list, so only the constants loaded once are replaced.
+    std::unordered_set<opcode_t> loaded, shared;
+    for (ir_value_t value = 0; value < definitions.size(); value++) {
+        if (!definitions[value] || definitions[value]->opcode != OP_LOAD_C) continue;
+        const opcode_t constant = definitions[value]->operands[0].word;
+        if (!loaded.insert(constant).second) shared.insert(constant);
+    }
+    std::vector<ir_value_t> replacements(function.values.size(), IR_NONE);
+    std::vector<std::vector<bool>> removed(function.blocks.size());
+    for (size_t b = 0; b < function.blocks.size(); b++) removed[b].resize(function.blocks[b].instructions.size(), false);
+    // Adds a constant and returns its index.
+    auto add_constant = [memory](const Value &value) {
+        memory->constants.push_back(value);
+        return static_cast<opcode_t>(memory->constants.size() - 1);
+    };
+    bool changed = false;
+    for (ir_value_t value = 0; value < definitions.size(); value++) {
+        const IRInstruction *definition = definitions[value];
+        if (escapes[value] || accesses[value].empty() || !definition || definition->opcode != OP_LOAD_C || shared.count(definition->operands[0].word)) continue;
+        const Value &constant = memory->constants[definition->operands[0].word];
+        const std::vector<std::pair<size_t, size_t>> &uses = accesses[value];
+        if (constant.type->type == VALUE_OBJECT) {
+            // The props are kept in the values stored if all the stores are in a single block and
+            // every load is after a store of its prop in the block (or in a block it dominates).
+            size_t stores = IR_NO_BLOCK;
+            bool replaceable = true;
+            for (const auto &[b, i] : uses) {
+                if (function.blocks[b].instructions[i].opcode != OP_SPROP) continue;
+                if (stores != IR_NO_BLOCK && stores != b) replaceable = false;
+                stores = b;
+            }
+            if (stores == IR_NO_BLOCK || !replaceable) continue;
+            const std::vector<IRInstruction> &instructions = function.blocks[stores].instructions;
+            // Returns the value of the last store of a prop before the given instruction of the block.
+            auto stored = [&instructions, value](const opcode_t prop, const size_t before) -> ir_value_t {
+                for (size_t i = before; i-- > 0;) {
+                    const IRInstruction &instruction = instructions[i];
+                    if (instruction.opcode == OP_SPROP && instruction.operands[0].word == prop && instruction.operands[1].word == value) {
+                        return instruction.operands[2].word;
+                    }
+                }
+                return IR_NONE;
+            };
+            std::vector<std::pair<ir_value_t, ir_value_t>> loads;
+            for (const auto &[b, i] : uses) {
+                const IRInstruction &instruction = function.blocks[b].instructions[i];
+                if (instruction.opcode != OP_LPROP) continue;
+                ir_value_t prop = IR_NONE;
+                if (b == stores) prop = stored(instruction.operands[1].word, i);
+                else if (function.dominates(stores, b)) prop = stored(instruction.operands[1].word, instructions.size());
+                if (prop == IR_NONE) replaceable = false;
+                loads.push_back({ instruction.result, prop });
+            }
+            if (!replaceable) continue;
+            for (const auto &[load, prop] : loads) replacements[load] = prop;
+            for (const auto &[b, i] : uses) removed[b][i] = true;
+        } else if (constant.type->type == VALUE_LIST) {
+            // The list is never modified, so its length and the elements at constant indexes are constants.
+            const nlist_t &list = *GETV(constant.value, nlist_t *);
+            bool replaced = false;
+            for (const auto &[b, i] : uses) {
+                IRInstruction &instruction = function.blocks[b].instructions[i];
+                opcode_t index;
+                if (instruction.opcode == OP_CAST_LIST_INT) index = add_constant(Value(static_cast<nint_t>(list.size())));
+                else {
+                    const IRInstruction *position = definitions[instruction.operands[1].word];
+                    if (!position || position->opcode != OP_LOAD_C) continue;
+                    const Value &number = memory->constants[position->operands[0].word];
+                    if (number.type->type != VALUE_INT || GETV(number.value, nint_t) < 0 || static_cast<size_t>(GETV(number.value, nint_t)) >= list.size()) continue;
+                    index = add_constant(list[GETV(number.value, nint_t)]);
+                }
+                instruction.opcode = OP_LOAD_C;
+                instruction.operands = { { false, index } };
+                replaced = true;
+            }
+            if (!replaced) continue;
+        } else continue;
+        changed = true;
+    }
+    if (!changed) return false;
+    for (size_t b = 0; b < function.blocks.size(); b++) {
+        std::vector<IRInstruction> &instructions = function.blocks[b].instructions;
+        std::vector<IRInstruction> kept;
+        for (size_t i = 0; i < instructions.size(); i++) if (!removed[b][i]) kept.push_back(std::move(instructions[i]));
+        instructions = std::move(kept);
+    }
+    function.replace_values(replacements);
+    return true;
+}
@@ -0,0 +1,137 @@
+/**
+ * |------------------|
+ * | Nuua Memory Heap |
+ * |------------------|
+ *
+ * Copyright 2019 Erik Campobadal <soc@erik.cat>
+ * https://nuua.io
+ */
+#include "../include/heap.hpp"
+#include "../include/value.hpp"
+#include <chrono>
+#include <stdio.h>
+
+Heap *heap = new Heap;
+
+void *HeapObject::operator new(size_t size)
+{
+    return heap->slab.allocate(size);
+}
+
+void HeapObject::operator delete(void *block, size_t size)
+{
+    heap->slab.free(block, size);
+}
+
+void Slab::refill(size_t size_class)
+{
+    size_t size = (size_class + 1) * SLAB_GRANULARITY;
+    char *chunk = static_cast<char *>(::operator new(SLAB_CHUNK_SIZE));
+    this->chunks.push_back(chunk);
+    this->stats.chunks++;
+    // Carve the chunk into blocks of the size class.
+    for (size_t offset = 0; offset + size <= SLAB_CHUNK_SIZE; offset += size) {
+        FreeBlock *block = reinterpret_cast<FreeBlock *>(chunk + offset);
+        block->next = this->free_blocks[size_class];
+        this->free_blocks[size_class] = block;
+    }
+}
+
+Slab::~Slab()
+{
+    for (void *chunk : this->chunks) ::operator delete(chunk);
+}
+
+Value *Heap::allocate_values(size_t count)
+{
+    Value *values = static_cast<Value *>(this->slab.allocate(count * sizeof(Value)));
+    for (size_t i = 0; i < count; i++) new (values + i) Value();
+    return values;
+}
+
+void Heap::free_values(Value *values, size_t count)
+{
+    for (size_t i = 0; i < count; i++) values[i].~Value();
+    this->slab.free(values, count * sizeof(Value));
+}
+
+void Heap::track(HeapObject *object)
+{
+    // Link the object to the heap object list.
+    object->next = this->objects;
+    this->objects = object;
+    // Update the heap statistics.
+    this->stats.allocated_objects++;
+    this->grow(object->footprint());
+}
+
+void Heap::mark(const Value &value)
+{
+    std::visit([this](const auto &v) {
+        if constexpr (std::is_pointer_v<std::decay_t<decltype(v)>>) this->mark(v);
+    }, value.value);
+}
+
+void Heap::mark(const HeapObject *object)
+{
+    // Uninitialized values and already marked objects are skipped.
+    if (!object || object->marked) return;
+    object->marked = true;
+    this->gray_objects.push_back(object);
+}
+
+void Heap::collect(const std::function<void()> &mark_roots)
+{
+    auto start = std::chrono::steady_clock::now();
+    // Mark the roots.
+    mark_roots();
+    // Trace the reachable objects. An explicit stack is used to
+    // avoid deep recursion on long chains of objects.
+    while (!this->gray_objects.empty()) {
+        const HeapObject *object = this->gray_objects.back();
+        this->gray_objects.pop_back();
+        object->trace(this);
+    }
+    // Sweep the unreachable objects.
+    this->bytes = 0;
+    for (HeapObject **object = &this->objects; *object;) {
+        if ((*object)->marked) {
+            (*object)->marked = false;
+            this->bytes += (*object)->footprint();
+            object = &(*object)->next;
+        } else {
+            HeapObject *unreached = *object;
+            *object = unreached->next;
+            this->stats.freed_objects++;
+            this->stats.freed_bytes += unreached->footprint();
+            delete unreached;
+        }
+    }
+    // Set the next collection threshold given the live bytes.
+    this->next_collection = static_cast<size_t>(this->bytes * this->growth_factor);
+    if (this->next_collection < HEAP_INITIAL_THRESHOLD) this->next_collection = HEAP_INITIAL_THRESHOLD;
+    this->stats.collections++;
+    this->stats.pause_time += std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count();
+}
+
+void Heap::report() const
+{
+    printf("GC statistics:\n");
+    printf("%20s: %zu\n", "Collections", this->stats.collections);
+    printf("%20s: %zu\n", "Allocated objects", this->stats.allocated_objects);
+    printf("%20s: %zu\n", "Freed objects", this->stats.freed_objects);
+    printf("%20s: %zu\n", "Live objects", this->stats.allocated_objects - this->stats.freed_objects);
+    printf("%20s: %zu\n", "Allocated bytes", this->stats.allocated_bytes);
+    printf("%20s: %zu\n", "Freed bytes", this->stats.freed_bytes);
+    printf("%20s: %zu\n", "Live bytes", this->bytes);
+    printf("%20s: %zu\n", "Peak bytes", this->stats.peak_bytes);
+    printf("%20s: %.2f\n", "Growth factor", this->growth_factor);
+    printf("%20s: %.3f ms\n", "Total pause", this->stats.pause_time / 1000.0);
+    printf("Slab statistics:\n");
+    printf("%20s: %zu (%zu KB)\n", "Chunks", this->slab.stats.chunks, this->slab.stats.chunks * SLAB_CHUNK_SIZE / 1024);
+    printf("%20s: %zu\n", "Large allocations", this->slab.stats.large_allocations);
+    for (size_t i = 0; i < SLAB_CLASSES; i++) {
+        if (this->slab.stats.allocations[i] == 0) continue;
+        printf("%16zu B: %zu allocated, %zu freed\n", (i + 1) * SLAB_GRANULARITY, this->slab.stats.allocations[i], this->slab.stats.frees[i]);
+    }
+}
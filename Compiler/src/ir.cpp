@@ -0,0 +1,660 @@
+/**
+ * |----------------------------------|
+ * | Nuua Intermediate Representation |
+ * |----------------------------------|
+ *
+ * Copyright 2019 Erik Campobadal <soc@erik.cat>
+ * https://nuua.io
+ */
+#include "../include/ir.hpp"
+#include <algorithm>
+
+// Returns the location the markers set before the given position.
+template <typename T>
+static T location_before(const std::unordered_map<size_t, T> &locations, const size_t position, T location)
+{
+    size_t last = 0;
+    bool found = false;
+    for (const auto &[key, value] : locations) {
+        if (key < position && (!found || key > last)) {
+            last = key;
+            location = value;
+            found = true;
+        }
+    }
+    return location;
+}
+
+// Returns the markers set from the given position (sorted by position).
+template <typename T>
+static std::vector<std::pair<size_t, T>> locations_from(const std::unordered_map<size_t, T> &locations, const size_t position)
+{
+    std::vector<std::pair<size_t, T>> result;
+    for (const auto &location : locations) if (location.first >= position) result.push_back(location);
+    std::sort(result.begin(), result.end(), [](const auto &a, const auto &b) { return a.first < b.first; });
+    return result;
+}
+
+// Removes the markers set from the given position.
+template <typename T>
+static void erase_locations(std::unordered_map<size_t, T> &locations, const size_t position)
+{
+    for (auto location = locations.begin(); location != locations.end();) {
+        if (location->first >= position) location = locations.erase(location);
+        else location++;
+    }
+}
+
+IRMemory ir_loaded_memory(const opcode_t opcode)
+{
+    switch (opcode) {
+        case OP_MOVE: { return IR_MEMORY_ALL; }
+        case OP_SGET: case OP_DIV_INT: case OP_DIV_FLOAT: case OP_CAST_STRING_INT:
+        case OP_MUL_INT_STRING: case OP_MUL_STRING_INT: { return IR_MEMORY_NONE; }
+        case OP_LGET: case OP_LGET_U: case OP_CAST_LIST_INT: case OP_CAST_LIST_BOOL: { return IR_MEMORY_LIST; }
+        case OP_DGET: case OP_DKEY: case OP_DKEY_U: case OP_CAST_DICT_INT: case OP_CAST_DICT_BOOL: { return IR_MEMORY_DICT; }
+        case OP_LPROP: { return IR_MEMORY_PROP; }
+        case OP_LOAD_G: { return IR_MEMORY_GLOBAL; }
+        default: { return opcode_is_pure(opcode) ? IR_MEMORY_NONE : IR_MEMORY_ALL; }
+    }
+}
+
+IRMemory ir_stored_memory(const opcode_t opcode)
+{
+    switch (opcode) {
+        case OP_LPUSH: case OP_LPUSH_C: case OP_LSET: case OP_LSET_U: case OP_LDELETE: { return IR_MEMORY_LIST; }
+        case OP_DSET: case OP_DDELETE: { return IR_MEMORY_DICT; }
+        case OP_SPROP: { return IR_MEMORY_PROP; }
+        case OP_SET_G: { return IR_MEMORY_GLOBAL; }
+        case OP_CALL: { return IR_MEMORY_ALL; }
+        default: { return IR_MEMORY_NONE; }
+    }
+}
+
+IRFunction::IRFunction(Memory *memory, const size_t entry, const registers_size_t registers)
+    : entry(entry), registers(registers), memory(memory)
+{
+    if (entry >= memory->code.size() || !this->build_blocks()) return;
+    this->build_ssa();
+    this->built = true;
+}
+
+bool IRFunction::build_blocks()
+{
+    const std::vector<opcode_t> &code = this->memory->code;
+    // Decode the instructions.
+    std::vector<size_t> starts;
+    std::vector<size_t> instruction_at(code.size() - this->entry + 1, IR_NO_BLOCK);
+    for (size_t i = this->entry; i < code.size();) {
+        const size_t size = opcode_operands(code[i])->size() + 1;
+        if (i + size > code.size()) return false;
+        instruction_at[i - this->entry] = starts.size();
+        starts.push_back(i);
+        i += size;
+    }
+    const size_t count = starts.size();
+    instruction_at[code.size() - this->entry] = count;
+    // Find the jump targets and the instructions that start a block.
+    // The position past the last instruction is a block of its own (removed if nothing gets there).
+    std::vector<size_t> targets(count, IR_NO_BLOCK);
+    std::vector<bool> leaders(count + 1, false);
+    leaders[0] = leaders[count] = true;
+    for (size_t i = 0; i < count; i++) {
+        const opcode_t opcode = code[starts[i]];
+        if (opcode_is_jump(opcode)) {
+            const size_t offset = code[starts[i] + 1];
+            const size_t target = opcode_is_backward_jump(opcode) ? starts[i] - offset : starts[i] + offset;
+            // Leave the function as it is if a jump goes out of it.
+            if (target < this->entry || target > code.size() || instruction_at[target - this->entry] == IR_NO_BLOCK) return false;
+            // The jump conditions must be registers of the function.
+            if (!opcode_is_unconditional_jump(opcode) && code[starts[i] + 2] >= this->registers) return false;
+            targets[i] = instruction_at[target - this->entry];
+            leaders[targets[i]] = true;
+        }
+        if (opcode_is_jump(opcode) || opcode == OP_RETURN || opcode == OP_EXIT) leaders[i + 1] = true;
+    }
+    std::vector<size_t> block_at(count + 1, IR_NO_BLOCK), firsts;
+    for (size_t i = 0; i <= count; i++) {
+        if (!leaders[i]) continue;
+        block_at[i] = firsts.size();
+        firsts.push_back(i);
+    }
+    firsts.push_back(count + 1);
+    // Get the source location markers of the function.
+    IRLocation location = {
+        location_before(this->memory->files, this->entry, std::shared_ptr<const std::string>()),
+        location_before(this->memory->lines, this->entry, static_cast<line_t>(0)),
+        location_before(this->memory->columns, this->entry, static_cast<column_t>(0))
+    };
+    const auto files = locations_from(this->memory->files, this->entry);
+    const auto lines = locations_from(this->memory->lines, this->entry);
+    const auto columns = locations_from(this->memory->columns, this->entry);
+    size_t file = 0, line = 0, column = 0;
+    // Build the blocks.
+    std::vector<IRBlock> blocks(firsts.size() - 1);
+    for (size_t b = 0; b < blocks.size(); b++) {
+        IRBlock &block = blocks[b];
+        for (size_t i = firsts[b]; i < firsts[b + 1] && i < count; i++) {
+            const size_t position = starts[i];
+            for (; file < files.size() && files[file].first <= position; file++) location.file = files[file].second;
+            for (; line < lines.size() && lines[line].first <= position; line++) location.line = lines[line].second;
+            for (; column < columns.size() && columns[column].first <= position; column++) location.column = columns[column].second;
+            const opcode_t opcode = code[position];
+            const opcode_t *words = code.data() + position + 1;
+            // The jumps end the block.
+            if (opcode_is_jump(opcode)) {
+                block.location = location;
+                block.successors.push_back(block_at[targets[i]]);
+                if (!opcode_is_unconditional_jump(opcode)) {
+                    block.condition = words[1];
+                    block.jump_if = opcode == OP_CFJUMP || opcode == OP_CBJUMP;
+                    block.successors.push_back(b + 1);
+                }
+                continue;
+            }
+            // The registers are kept as the operands until they are converted into values.
+            IRInstruction instruction = { opcode, IR_NONE, {}, location };
+            const std::vector<OpCodeType> *operands = opcode_operands(opcode);
+            for (size_t k = 0; k < operands->size(); k++) {
+                const bool reg = (*operands)[k] == OT_REG && words[k] < this->registers;
+                if (k == 0 && reg && opcode_defines_register(opcode)) {
+                    instruction.result = words[k];
+                    continue;
+                }
+                if (k == 0 && reg && opcode_modifies_register(opcode)) instruction.result = words[k];
+                instruction.operands.push_back({ reg, words[k] });
+            }
+            if (opcode == OP_RETURN || opcode == OP_EXIT) block.exits = true;
+            block.instructions.push_back(std::move(instruction));
+        }
+        if (block.successors.empty() && !block.exits && b + 1 < blocks.size()) block.successors.push_back(b + 1);
+        // A conditional jump to the next block always goes there.
+        if (block.condition != IR_NONE && block.successors[0] == block.successors[1]) {
+            block.condition = IR_NONE;
+            block.successors.pop_back();
+        }
+    }
+    // Remove the blocks that are never reached.
+    std::vector<size_t> indexes(blocks.size(), IR_NO_BLOCK), stack = { 0 };
+    indexes[0] = 0;
+    while (!stack.empty()) {
+        const size_t b = stack.back();
+        stack.pop_back();
+        for (const size_t successor : blocks[b].successors) {
+            if (indexes[successor] != IR_NO_BLOCK) continue;
+            indexes[successor] = 0;
+            stack.push_back(successor);
+        }
+    }
+    // The entry block can't have predecessors, so an empty one is added if something jumps there.
+    bool entry_block = false;
+    for (size_t b = 0; b < blocks.size() && !entry_block; b++) {
+        if (indexes[b] == IR_NO_BLOCK) continue;
+        for (const size_t successor : blocks[b].successors) if (successor == 0) entry_block = true;
+    }
+    if (entry_block) {
+        IRBlock block;
+        block.successors.push_back(0);
+        this->blocks.push_back(std::move(block));
+    }
+    for (size_t b = 0, index = this->blocks.size(); b < blocks.size(); b++) {
+        if (indexes[b] != IR_NO_BLOCK) indexes[b] = index++;
+    }
+    for (size_t b = 0; b < blocks.size(); b++) {
+        if (indexes[b] == IR_NO_BLOCK) continue;
+        for (size_t &successor : blocks[b].successors) successor = indexes[successor];
+        this->blocks.push_back(std::move(blocks[b]));
+    }
+    if (entry_block) this->blocks[0].successors[0] = 1;
+    this->compute_predecessors();
+    return true;
+}
+
+void IRFunction::compute_predecessors()
+{
+    for (IRBlock &block : this->blocks) block.predecessors.clear();
+    for (size_t b = 0; b < this->blocks.size(); b++) {
+        for (const size_t successor : this->blocks[b].successors) this->blocks[successor].predecessors.push_back(b);
+    }
+}
+
+void IRFunction::compute_dominators()
+{
+    const size_t count = this->blocks.size();
+    // Get the reverse postorder of the blocks.
+    this->order.clear();
+    std::vector<size_t> number(count, IR_NO_BLOCK);
+    std::vector<std::pair<size_t, size_t>> stack = { { 0, 0 } };
+    number[0] = 0;
+    while (!stack.empty()) {
+        const size_t b = stack.back().first, next = stack.back().second;
+        if (next < this->blocks[b].successors.size()) {
+            stack.back().second++;
+            const size_t successor = this->blocks[b].successors[next];
+            if (number[successor] != IR_NO_BLOCK) continue;
+            number[successor] = 0;
+            stack.push_back({ successor, 0 });
+        } else {
+            this->order.push_back(b);
+            stack.pop_back();
+        }
+    }
+    std::reverse(this->order.begin(), this->order.end());
+    for (size_t i = 0; i < this->order.size(); i++) number[this->order[i]] = i;
+    // Compute the immediate dominators (Cooper, Harvey and Kennedy).
+    this->dominators.assign(count, IR_NO_BLOCK);
+    this->dominators[0] = 0;
+    for (bool changed = true; changed;) {
+        changed = false;
+        for (size_t i = 1; i < this->order.size(); i++) {
+            const size_t b = this->order[i];
+            size_t dominator = IR_NO_BLOCK;
+            for (size_t predecessor : this->blocks[b].predecessors) {
+                if (this->dominators[predecessor] == IR_NO_BLOCK) continue;
+                if (dominator == IR_NO_BLOCK) {
+                    dominator = predecessor;
+                    continue;
+                }
+                while (predecessor != dominator) {
+                    while (number[predecessor] > number[dominator]) predecessor = this->dominators[predecessor];
+                    while (number[dominator] > number[predecessor]) dominator = this->dominators[dominator];
+                }
+            }
+            if (this->dominators[b] != dominator) {
+                this->dominators[b] = dominator;
+                changed = true;
+            }
+        }
+    }
+}
+
+std::vector<std::vector<size_t>> IRFunction::dominator_tree() const
+{
+    std::vector<std::vector<size_t>> children(this->blocks.size());
+    for (size_t b = 1; b < this->blocks.size(); b++) {
+        if (this->dominators[b] != IR_NO_BLOCK) children[this->dominators[b]].push_back(b);
+    }
+    return children;
+}
+
+bool IRFunction::dominates(size_t a, size_t b) const
+{
+    for (;;) {
+        if (a == b) return true;
+        if (b == 0 || this->dominators[b] == IR_NO_BLOCK) return false;
+        b = this->dominators[b];
+    }
+}
+
+ir_value_t IRFunction::new_value(const ValueType type)
+{
+    this->values.push_back({ type });
+    return this->values.size() - 1;
+}
+
+ValueType IRFunction::result_type(const IRInstruction &instruction) const
+{
+    switch (instruction.opcode) {
+        case OP_MOVE: { return instruction.operands[0].value ? this->values[instruction.operands[0].word].type : VALUE_NO_TYPE; }
+        case OP_LOAD_C: { return this->memory->constants[instruction.operands[0].word].type->type; }
+        case OP_IINC: case OP_IDEC: case OP_MINUS_INT: case OP_MINUS_BOOL: case OP_PLUS_INT: case OP_PLUS_BOOL:
+        case OP_ADD_INT: case OP_ADD_BOOL: case OP_SUB_INT: case OP_SUB_FLOAT: case OP_SUB_BOOL: case OP_MUL_INT: case OP_MUL_BOOL:
+        case OP_CAST_FLOAT_INT: case OP_CAST_BOOL_INT: case OP_CAST_LIST_INT: case OP_CAST_DICT_INT: case OP_CAST_STRING_INT: { return VALUE_INT; }
+        case OP_MINUS_FLOAT: case OP_PLUS_FLOAT: case OP_ADD_FLOAT: case OP_MUL_FLOAT: case OP_DIV_INT: case OP_DIV_FLOAT:
+        case OP_CAST_INT_FLOAT: case OP_CAST_BOOL_FLOAT: { return VALUE_FLOAT; }
+        case OP_NEG_BOOL: case OP_OR: case OP_AND: case OP_CAST_INT_BOOL: case OP_CAST_FLOAT_BOOL: case OP_CAST_LIST_BOOL:
+        case OP_CAST_DICT_BOOL: case OP_CAST_STRING_BOOL: { return VALUE_BOOL; }
+        case OP_SGET: case OP_SSET: case OP_SDELETE: case OP_DKEY: case OP_DKEY_U: case OP_ADD_STRING: case OP_MUL_INT_STRING: case OP_MUL_STRING_INT:
+        case OP_CAST_INT_STRING: case OP_CAST_FLOAT_STRING: case OP_CAST_BOOL_STRING: case OP_CAST_LIST_STRING:
+        case OP_CAST_DICT_STRING: case OP_SSLICE: { return VALUE_STRING; }
+        case OP_ADD_LIST: case OP_MUL_INT_LIST: case OP_MUL_LIST_INT: case OP_DIV_STRING_INT: case OP_DIV_LIST_INT:
+        case OP_RANGEE: case OP_RANGEI: { return VALUE_LIST; }
+        case OP_ADD_DICT: { return VALUE_DICT; }
+        default: { return instruction.opcode >= OP_EQ_INT && instruction.opcode <= OP_LTE_BOOL ? VALUE_BOOL : VALUE_NO_TYPE; }
+    }
+}
+
+void IRFunction::infer_types()
+{
+    for (bool changed = true; changed;) {
+        changed = false;
+        for (const IRBlock &block : this->blocks) {
+            // A phi has a type if all its (set) inputs have the same one.
+            for (const IRPhi &phi : block.phis) {
+                if (this->values[phi.result].type != VALUE_NO_TYPE) continue;
+                ValueType type = VALUE_NO_TYPE;
+                bool known = true;
+                for (const ir_value_t input : phi.inputs) {
+                    if (input == phi.result || this->values[input].undefined) continue;
+                    if (this->values[input].type == VALUE_NO_TYPE || (type != VALUE_NO_TYPE && type != this->values[input].type)) known = false;
+                    type = this->values[input].type;
+                }
+                if (!known || type == VALUE_NO_TYPE) continue;
+                this->values[phi.result].type = type;
+                changed = true;
+            }
+            for (const IRInstruction &instruction : block.instructions) {
+                if (instruction.opcode != OP_MOVE || instruction.result == IR_NONE || this->values[instruction.result].type != VALUE_NO_TYPE) continue;
+                if ((this->values[instruction.result].type = this->result_type(instruction)) != VALUE_NO_TYPE) changed = true;
+            }
+        }
+    }
+}
+
+void IRFunction::build_ssa()
+{
+    this->compute_dominators();
+    const size_t count = this->blocks.size();
+    // Compute the dominance frontiers.
+    std::vector<std::vector<size_t>> frontiers(count);
+    for (size_t b = 0; b < count; b++) {
+        if (this->blocks[b].predecessors.size() < 2) continue;
+        for (size_t runner : this->blocks[b].predecessors) {
+            while (runner != this->dominators[b]) {
+                if (frontiers[runner].empty() || frontiers[runner].back() != b) frontiers[runner].push_back(b);
+                runner = this->dominators[runner];
+            }
+        }
+    }
+    // Place the phis of each register at the iterated dominance frontier of its definitions.
+    std::vector<std::vector<size_t>> definitions(this->registers);
+    for (size_t b = 0; b < count; b++) {
+        for (const IRInstruction &instruction : this->blocks[b].instructions) {
+            if (instruction.result == IR_NONE) continue;
+            std::vector<size_t> &blocks = definitions[instruction.result];
+            if (blocks.empty() || blocks.back() != b) blocks.push_back(b);
+        }
+    }
+    std::vector<size_t> placed(count, IR_NO_BLOCK), queued(count, IR_NO_BLOCK);
+    for (reg_t reg = 0; reg < this->registers; reg++) {
+        std::vector<size_t> worklist = definitions[reg];
+        for (const size_t b : worklist) queued[b] = reg;
+        while (!worklist.empty()) {
+            const size_t b = worklist.back();
+            worklist.pop_back();
+            for (const size_t frontier : frontiers[b]) {
+                if (placed[frontier] == reg) continue;
+                placed[frontier] = reg;
+                IRBlock &block = this->blocks[frontier];
+                block.phis.push_back({ IR_NONE, std::vector<ir_value_t>(block.predecessors.size(), IR_NONE), reg });
+                if (queued[frontier] == reg) continue;
+                queued[frontier] = reg;
+                worklist.push_back(frontier);
+            }
+        }
+    }
+    // Rename the registers walking the dominator tree.
+    const std::vector<std::vector<size_t>> children = this->dominator_tree();
+    std::vector<std::vector<ir_value_t>> stacks(this->registers);
+    std::vector<ir_value_t> undefined(this->registers, IR_NONE);
+    std::vector<std::vector<reg_t>> pushed(count);
+    auto current = [&](const opcode_t reg) {
+        if (!stacks[reg].empty()) return stacks[reg].back();
+        // The register is read before it's set.
+        if (undefined[reg] == IR_NONE) {
+            undefined[reg] = this->new_value();
+            this->values[undefined[reg]].undefined = true;
+        }
+        return undefined[reg];
+    };
+    auto rename = [&](const size_t b) {
+        IRBlock &block = this->blocks[b];
+        for (IRPhi &phi : block.phis) {
+            phi.result = this->new_value();
+            stacks[phi.reg].push_back(phi.result);
+            pushed[b].push_back(phi.reg);
+        }
+        for (IRInstruction &instruction : block.instructions) {
+            for (IROperand &operand : instruction.operands) if (operand.value) operand.word = current(operand.word);
+            if (instruction.result == IR_NONE) continue;
+            const reg_t reg = instruction.result;
+            instruction.result = this->new_value(this->result_type(instruction));
+            stacks[reg].push_back(instruction.result);
+            pushed[b].push_back(reg);
+        }
+        if (block.condition != IR_NONE) block.condition = current(block.condition);
+        for (const size_t successor : block.successors) {
+            IRBlock &next = this->blocks[successor];
+            for (size_t p = 0; p < next.predecessors.size(); p++) {
+                if (next.predecessors[p] != b) continue;
+                for (IRPhi &phi : next.phis) phi.inputs[p] = current(phi.reg);
+            }
+        }
+    };
+    std::vector<size_t> stack = { 0 }, next_child(count, 0);
+    rename(0);
+    while (!stack.empty()) {
+        const size_t b = stack.back();
+        if (next_child[b] < children[b].size()) {
+            const size_t child = children[b][next_child[b]++];
+            rename(child);
+            stack.push_back(child);
+            continue;
+        }
+        for (const reg_t reg : pushed[b]) stacks[reg].pop_back();
+        stack.pop_back();
+    }
+    this->infer_types();
+}
+
+void IRFunction::replace_values(std::vector<ir_value_t> &replacements)
+{
+    replacements.resize(this->values.size(), IR_NONE);
+    auto find = [&replacements](ir_value_t value) {
+        ir_value_t root = value;
+        while (replacements[root] != IR_NONE) root = replacements[root];
+        // Compress the path so the next lookups are direct.
+        while (replacements[value] != IR_NONE) {
+            const ir_value_t next = replacements[value];
+            replacements[value] = root;
+            value = next;
+        }
+        return root;
+    };
+    for (IRBlock &block : this->blocks) {
+        for (IRPhi &phi : block.phis) for (ir_value_t &input : phi.inputs) input = find(input);
+        for (IRInstruction &instruction : block.instructions) {
+            for (IROperand &operand : instruction.operands) if (operand.value) operand.word = find(operand.word);
+        }
+        if (block.condition != IR_NONE) block.condition = find(block.condition);
+    }
+}
+
+std::vector<size_t> IRFunction::count_uses() const
+{
+    std::vector<size_t> uses(this->values.size(), 0);
+    for (const IRBlock &block : this->blocks) {
+        for (const IRPhi &phi : block.phis) for (const ir_value_t input : phi.inputs) uses[input]++;
+        for (const IRInstruction &instruction : block.instructions) {
+            for (const IROperand &operand : instruction.operands) if (operand.value) uses[operand.word]++;
+        }
+        if (block.condition != IR_NONE) uses[block.condition]++;
+    }
+    return uses;
+}
+
+void IRFunction::destroy_ssa()
+{
+    const size_t count = this->blocks.size();
+    for (size_t b = 0; b < count; b++) {
+        if (this->blocks[b].phis.empty()) continue;
+        for (size_t p = 0; p < this->blocks[b].predecessors.size(); p++) {
+            const size_t predecessor = this->blocks[b].predecessors[p];
+            // Get the copies of the edge (they happen at the same time).
+            std::vector<std::pair<ir_value_t, ir_value_t>> copies;
+            for (const IRPhi &phi : this->blocks[b].phis) {
+                if (phi.inputs[p] != phi.result) copies.push_back({ phi.result, phi.inputs[p] });
+            }
+            if (copies.empty()) continue;
+            // The copies of a predecessor with more successors go in a new block between them.
+            size_t target = predecessor;
+            if (this->blocks[predecessor].successors.size() > 1) {
+                IRBlock block;
+                block.location = this->blocks[predecessor].location;
+                block.successors.push_back(b);
+                block.predecessors.push_back(predecessor);
+                target = this->blocks.size();
+                for (size_t &successor : this->blocks[predecessor].successors) if (successor == b) successor = target;
+                this->blocks[b].predecessors[p] = target;
+                this->blocks.push_back(std::move(block));
+            }
+            IRBlock &block = this->blocks[target];
+            const IRLocation location = block.instructions.empty() ? block.location : block.instructions.back().location;
+            // A phi that is the input of another one is copied to a temporary value first.
+            bool overlap = false;
+            for (const auto &copy : copies) {
+                for (const auto &other : copies) if (other.second == copy.first) overlap = true;
+            }
+            if (overlap) {
+                for (auto &copy : copies) {
+                    const ir_value_t temporary = this->new_value(this->values[copy.second].type);
+                    block.instructions.push_back({ OP_MOVE, temporary, { { true, copy.second } }, location });
+                    copy.second = temporary;
+                }
+            }
+            for (const auto &copy : copies) block.instructions.push_back({ OP_MOVE, copy.first, { { true, copy.second } }, location });
+        }
+        this->blocks[b].phis.clear();
+    }
+}
+
+registers_size_t IRFunction::lower()
+{
+    const size_t count = this->blocks.size();
+    this->destroy_ssa();
+    std::vector<opcode_t> &code = this->memory->code;
+    // The source locations before and after the function.
+    IRLocation current = {
+        location_before(this->memory->files, this->entry, std::shared_ptr<const std::string>()),
+        location_before(this->memory->lines, this->entry, static_cast<line_t>(0)),
+        location_before(this->memory->columns, this->entry, static_cast<column_t>(0))
+    };
+    const IRLocation last = {
+        location_before(this->memory->files, code.size() + 1, std::shared_ptr<const std::string>()),
+        location_before(this->memory->lines, code.size() + 1, static_cast<line_t>(0)),
+        location_before(this->memory->columns, code.size() + 1, static_cast<column_t>(0))
+    };
+    erase_locations(this->memory->files, this->entry);
+    erase_locations(this->memory->lines, this->entry);
+    erase_locations(this->memory->columns, this->entry);
+    code.resize(this->entry);
+    auto locate = [this, &code, &current](const IRLocation &location) {
+        // The jumps added by the compiler have no location.
+        if (!location.file && location.line == 0) return;
+        if (location.file != current.file && location.file) this->memory->files[code.size()] = location.file;
+        if (location.line != current.line) this->memory->lines[code.size()] = location.line;
+        if (location.column != current.column) this->memory->columns[code.size()] = location.column;
+        current = location;
+    };
+    // Write the blocks in their order. The blocks added for the copies of the
+    // edges to the next block go right after the conditional jump.
+    std::vector<size_t> layout;
+    std::vector<bool> placed(this->blocks.size(), false);
+    for (size_t b = 0; b < count; b++) {
+        layout.push_back(b);
+        const IRBlock &block = this->blocks[b];
+        if (block.condition == IR_NONE || block.successors[1] < count) continue;
+        layout.push_back(block.successors[1]);
+        placed[block.successors[1]] = true;
+    }
+    for (size_t b = count; b < this->blocks.size(); b++) if (!placed[b]) layout.push_back(b);
+    std::vector<size_t> starts(this->blocks.size());
+    // Stores the position of each jump and the block it goes to.
+    std::vector<std::pair<size_t, size_t>> jumps;
+    for (size_t l = 0; l < layout.size(); l++) {
+        const IRBlock &block = this->blocks[layout[l]];
+        starts[layout[l]] = code.size();
+        for (const IRInstruction &instruction : block.instructions) {
+            locate(instruction.location);
+            code.push_back(instruction.opcode);
+            if (instruction.result != IR_NONE) {
+                if (opcode_modifies_register(instruction.opcode)) {
+                    // Modify a copy of the value, unless it's the same.
+                    if (instruction.result != instruction.operands[0].word) {
+                        code.back() = OP_MOVE;
+                        code.insert(code.end(), { instruction.result, instruction.operands[0].word, instruction.opcode });
+                    }
+                    code.push_back(instruction.result);
+                    for (size_t k = 1; k < instruction.operands.size(); k++) code.push_back(instruction.operands[k].word);
+                    continue;
+                }
+                code.push_back(instruction.result);
+            }
+            for (const IROperand &operand : instruction.operands) code.push_back(operand.word);
+        }
+        if (block.successors.empty()) continue;
+        const size_t next = l + 1 < layout.size() ? layout[l + 1] : IR_NO_BLOCK;
+        if (block.condition != IR_NONE) {
+            locate(block.location);
+            jumps.push_back({ code.size(), block.successors[0] });
+            code.insert(code.end(), { block.jump_if ? OP_CFJUMP : OP_CFNJUMP, 0, block.condition });
+        }
+        const size_t fallthrough = block.successors.back();
+        if (fallthrough != next) {
+            locate(block.location);
+            jumps.push_back({ code.size(), fallthrough });
+            code.insert(code.end(), { OP_FJUMP, 0 });
+        }
+    }
+    // Set the jump offsets.
+    for (const auto &[position, block] : jumps) {
+        const size_t target = starts[block];
+        code[position] = opcode_jump(code[position], target < position);
+        code[position + 1] = target < position ? position - target : target - position;
+    }
+    locate(last);
+    return this->values.size();
+}
+
+void IRFunction::dump(const std::string &name) const
+{
+    static const char *types[] = { "int", "float", "bool", "string", "list", "dict", "fun", "object" };
+    auto print_value = [this](const ir_value_t value) {
+        printf("v%u", value);
+        if (this->values[value].type != VALUE_NO_TYPE) printf(":%s", types[this->values[value].type]);
+    };
+    printf("IR of %s (%zu blocks, %zu values):\n", name.c_str(), this->blocks.size(), this->values.size());
+    for (size_t b = 0; b < this->blocks.size(); b++) {
+        const IRBlock &block = this->blocks[b];
+        printf("  b%zu:", b);
+        for (size_t p = 0; p < block.predecessors.size(); p++) printf("%s b%zu", p == 0 ? " <-" : ",", block.predecessors[p]);
+        printf("\n");
+        for (const IRPhi &phi : block.phis) {
+            printf("    ");
+            print_value(phi.result);
+            printf(" = %17.17s", "PHI");
+            for (size_t p = 0; p < phi.inputs.size(); p++) printf(" v%u (b%zu)", phi.inputs[p], block.predecessors[p]);
+            printf("\n");
+        }
+        for (const IRInstruction &instruction : block.instructions) {
+            printf("    ");
+            if (instruction.result != IR_NONE) {
+                print_value(instruction.result);
+                printf(" = ");
+            }
+            print_opcode(instruction.opcode);
+            const std::vector<OpCodeType> *operands = opcode_operands(instruction.opcode);
+            const size_t offset = instruction.result != IR_NONE && opcode_defines_register(instruction.opcode);
+            for (size_t k = 0; k < instruction.operands.size(); k++) {
+                const IROperand &operand = instruction.operands[k];
+                if (operand.value) {
+                    printf(" v%zu", operand.word);
+                    continue;
+                }
+                switch ((*operands)[k + offset]) {
+                    case OT_REG: { printf(" R-%05zu", static_cast<size_t>(operand.word)); break; }
+                    case OT_CONST: { printf(" C-%05zu", static_cast<size_t>(operand.word)); break; }
+                    case OT_GLOBAL: { printf(" G-%05zu", static_cast<size_t>(operand.word)); break; }
+                    case OT_LITERAL: { printf(" L-%05zu", static_cast<size_t>(operand.word)); break; }
+                    case OT_PROP: { printf(" P-%05zu", static_cast<size_t>(operand.word)); break; }
+                }
+            }
+            printf("\n");
+        }
+        if (block.condition != IR_NONE) {
+            printf("    %17.17s v%u b%zu b%zu\n", block.jump_if ? "BRANCH_IF" : "BRANCH_UNLESS", block.condition, block.successors[0], block.successors[1]);
+        } else if (!block.successors.empty()) {
+            printf("    %17.17s b%zu\n", "JUMP", block.successors[0]);
+        }
+    }
+}
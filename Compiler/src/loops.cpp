@@ -0,0 +1,430 @@
+/**
+ * |---------------------|
+ * | Nuua Loop Optimizer |
+ * |---------------------|
+ *
+ * Copyright 2019 Erik Campobadal <soc@erik.cat>
+ * https://nuua.io
+ */
+#include "../include/ir.hpp"
+#include <algorithm>
+
+// Returns the instruction that sets each value (nullptr for the phis).
+static std::vector<IRInstruction *> find_definitions(IRFunction &function)
+{
+    std::vector<IRInstruction *> definitions(function.values.size(), nullptr);
+    for (IRBlock &block : function.blocks) {
+        for (IRInstruction &instruction : block.instructions) if (instruction.result != IR_NONE) definitions[instruction.result] = &instruction;
+    }
+    return definitions;
+}
+
+// Gets the integer a value is set to, if it's a constant.
+static bool int_constant(const IRFunction &function, const std::vector<IRInstruction *> &definitions, const ir_value_t value, nint_t &result)
+{
+    const IRInstruction *definition = definitions[value];
+    if (!definition || definition->opcode != OP_LOAD_C) return false;
+    const Value &constant = function.memory->constants[definition->operands[0].word];
+    if (constant.type->type != VALUE_INT) return false;
+    result = GETV(constant.value, nint_t);
+    return true;
+}
+
+std::vector<IRLoop> IRFunction::find_loops()
+{
+    this->compute_dominators();
+    std::vector<size_t> number(this->blocks.size(), IR_NO_BLOCK);
+    for (size_t i = 0; i < this->order.size(); i++) number[this->order[i]] = i;
+    std::vector<IRLoop> loops;
+    std::vector<size_t> loop_at(this->blocks.size(), IR_NO_BLOCK);
+    for (const size_t b : this->order) {
+        for (const size_t header : this->blocks[b].successors) {
+            // A jump to a block that dominates it goes back to the header of a loop.
+            if (!this->dominates(header, b)) continue;
+            if (loop_at[header] == IR_NO_BLOCK) {
+                loop_at[header] = loops.size();
+                loops.push_back({ header, {}, { header }, std::vector<bool>(this->blocks.size(), false) });
+                loops.back().body[header] = true;
+            }
+            IRLoop &loop = loops[loop_at[header]];
+            loop.latches.push_back(b);
+            // The blocks that get to the latch without going through the header are part of the loop.
+            std::vector<size_t> stack = { b };
+            while (!stack.empty()) {
+                const size_t block = stack.back();
+                stack.pop_back();
+                if (loop.body[block]) continue;
+                loop.body[block] = true;
+                loop.blocks.push_back(block);
+                for (const size_t predecessor : this->blocks[block].predecessors) {
+                    if (!loop.body[predecessor] && number[predecessor] != IR_NO_BLOCK) stack.push_back(predecessor);
+                }
+            }
+        }
+    }
+    for (IRLoop &loop : loops) {
+        std::sort(loop.blocks.begin(), loop.blocks.end(), [&number](const size_t a, const size_t b) { return number[a] < number[b]; });
+    }
+    std::stable_sort(loops.begin(), loops.end(), [](const IRLoop &a, const IRLoop &b) { return a.blocks.size() < b.blocks.size(); });
+    return loops;
+}
+
+size_t IRFunction::preheader(std::vector<IRLoop> &loops, const size_t loop)
+{
+    const size_t header = loops[loop].header;
+    // Get the predecessors from outside and inside the loop.
+    std::vector<size_t> outside, inside;
+    for (size_t p = 0; p < this->blocks[header].predecessors.size(); p++) {
+        (loops[loop].body[this->blocks[header].predecessors[p]] ? inside : outside).push_back(p);
+    }
+    const size_t predecessor = this->blocks[header].predecessors[outside[0]];
+    if (outside.size() == 1 && this->blocks[predecessor].successors.size() == 1) return predecessor;
+    const size_t preheader = this->blocks.size();
+    IRBlock block;
+    block.successors.push_back(header);
+    for (const size_t p : outside) {
+        const size_t from = this->blocks[header].predecessors[p];
+        block.predecessors.push_back(from);
+        for (size_t &successor : this->blocks[from].successors) if (successor == header) successor = preheader;
+    }
+    // The phis get a single input from the preheader (a phi of the preheader if the inputs differ).
+    IRBlock &target = this->blocks[header];
+    std::vector<size_t> predecessors = { preheader };
+    for (const size_t p : inside) predecessors.push_back(target.predecessors[p]);
+    for (IRPhi &phi : target.phis) {
+        std::vector<ir_value_t> inputs, outer;
+        for (const size_t p : outside) outer.push_back(phi.inputs[p]);
+        ir_value_t input = outer[0];
+        if (std::any_of(outer.begin(), outer.end(), [&outer](const ir_value_t value) { return value != outer[0]; })) {
+            input = this->new_value(this->values[phi.result].type);
+            block.phis.push_back({ input, outer });
+        }
+        inputs.push_back(input);
+        for (const size_t p : inside) inputs.push_back(phi.inputs[p]);
+        phi.inputs = std::move(inputs);
+    }
+    target.predecessors = std::move(predecessors);
+    this->blocks.push_back(std::move(block));
+    // The preheader is part of the loops the header is in (but its own).
+    for (size_t l = 0; l < loops.size(); l++) {
+        const bool inner = l != loop && loops[l].body[header];
+        loops[l].body.push_back(inner);
+        if (inner) loops[l].blocks.insert(std::find(loops[l].blocks.begin(), loops[l].blocks.end(), header), preheader);
+    }
+    return preheader;
+}
+
+bool ir_loop_invariants(IRFunction &function)
+{
+    std::vector<IRLoop> loops = function.find_loops();
+    bool changed = false;
+    for (size_t l = 0; l < loops.size(); l++) {
+        // Get the values set in the loop and the memory it modifies.
+        std::vector<bool> variant(function.values.size(), false);
+        bool stores[IR_MEMORY_ALL + 1] = {};
+        std::vector<opcode_t> properties, globals;
+        for (const size_t b : loops[l].blocks) {
+            const IRBlock &block = function.blocks[b];
+            for (const IRPhi &phi : block.phis) variant[phi.result] = true;
+            for (const IRInstruction &instruction : block.instructions) {
+                if (instruction.result != IR_NONE) variant[instruction.result] = true;
+                const IRMemory stored = ir_stored_memory(instruction.opcode);
+                stores[stored] = true;
+                if (stored == IR_MEMORY_PROP) properties.push_back(instruction.operands[0].word);
+                if (stored == IR_MEMORY_GLOBAL) globals.push_back(instruction.operands[0].word);
+            }
+        }
+        // Determines if the loop never modifies the memory an instruction loads.
+        auto unchanged = [&](const IRInstruction &instruction) {
+            const IRMemory loaded = ir_loaded_memory(instruction.opcode);
+            if (loaded == IR_MEMORY_ALL || stores[IR_MEMORY_ALL]) return false;
+            if (loaded == IR_MEMORY_PROP) return std::find(properties.begin(), properties.end(), instruction.operands.back().word) == properties.end();
+            if (loaded == IR_MEMORY_GLOBAL) return std::find(globals.begin(), globals.end(), instruction.operands[0].word) == globals.end();
+            return loaded == IR_MEMORY_NONE || !stores[loaded];
+        };
+        std::vector<IRInstruction> hoisted;
+        for (const size_t b : loops[l].blocks) {
+            IRBlock &block = function.blocks[b];
+            // The header runs whenever the loop does, so the loads and the opcodes that may fail
+            // can be moved from it, as long as nothing else happens before them.
+            bool guaranteed = b == loops[l].header;
+            block.instructions.erase(std::remove_if(block.instructions.begin(), block.instructions.end(), [&](const IRInstruction &instruction) {
+                bool invariant = instruction.result != IR_NONE && std::none_of(instruction.operands.begin(), instruction.operands.end(), [&variant](const IROperand &operand) {
+                    return operand.value && variant[operand.word];
+                });
+                if (invariant && !opcode_is_pure(instruction.opcode)) invariant = guaranteed && unchanged(instruction);
+                if (!invariant) {
+                    if (!opcode_is_removable(instruction.opcode)) guaranteed = false;
+                    return false;
+                }
+                variant[instruction.result] = false;
+                hoisted.push_back(instruction);
+                return true;
+            }), block.instructions.end());
+        }
+        if (hoisted.empty()) continue;
+        std::vector<IRInstruction> &instructions = function.blocks[function.preheader(loops, l)].instructions;
+        instructions.insert(instructions.end(), hoisted.begin(), hoisted.end());
+        changed = true;
+    }
+    return changed;
+}
+
+bool ir_induction_variables(IRFunction &function)
+{
+    const std::vector<IRLoop> loops = function.find_loops();
+    std::vector<IRInstruction *> definitions = find_definitions(function);
+    // Determines if a value is not used after the given instruction in the loop. Then the
+    // increment of the value can modify its register instead of a copy.
+    auto last_use = [&function](const IRLoop &loop, const ir_value_t value, const size_t in, const IRInstruction *step) {
+        for (size_t b = 0; b < function.blocks.size(); b++) {
+            const IRBlock &block = function.blocks[b];
+            for (const IRPhi &phi : block.phis) {
+                if (std::find(phi.inputs.begin(), phi.inputs.end(), value) != phi.inputs.end()) return false;
+            }
+            if (!loop.body[b] || (b == loop.header && b != in)) continue;
+            bool after = b != in;
+            for (const IRInstruction &instruction : block.instructions) {
+                if (&instruction == step) {
+                    after = true;
+                    continue;
+                }
+                for (const IROperand &operand : instruction.operands) if (after && operand.value && operand.word == value) return false;
+            }
+            if (block.condition == value) return false;
+        }
+        return true;
+    };
+    bool changed = false;
+    for (const IRLoop &loop : loops) {
+        const IRBlock &header = function.blocks[loop.header];
+        for (const IRPhi &phi : header.phis) {
+            for (size_t p = 0; p < header.predecessors.size(); p++) {
+                if (!loop.body[header.predecessors[p]]) continue;
+                // The phi is set to itself plus one in the iteration.
+                IRInstruction *step = definitions[phi.inputs[p]];
+                if (!step || step->opcode != OP_ADD_INT || !step->operands[0].value || !step->operands[1].value) continue;
+                const size_t other = step->operands[0].word == phi.result ? 1 : 0;
+                nint_t constant;
+                if (step->operands[1 - other].word != phi.result || !int_constant(function, definitions, step->operands[other].word, constant) || constant != 1) continue;
+                size_t in = IR_NO_BLOCK;
+                for (const size_t b : loop.blocks) {
+                    const std::vector<IRInstruction> &instructions = function.blocks[b].instructions;
+                    if (!instructions.empty() && step >= instructions.data() && step < instructions.data() + instructions.size()) in = b;
+                }
+                if (in == IR_NO_BLOCK || !last_use(loop, phi.result, in, step)) continue;
+                step->opcode = OP_IINC;
+                step->operands = { { true, phi.result } };
+                changed = true;
+            }
+        }
+    }
+    return changed;
+}
+
+bool ir_loop_unrolling(IRFunction &function)
+{
+    const std::vector<IRLoop> loops = function.find_loops();
+    const std::vector<IRInstruction *> definitions = find_definitions(function);
+    for (const IRLoop &loop : loops) {
+        // Only the loops with the check in the header and a single block for the iteration.
+        if (loop.blocks.size() != 2 || loop.latches.size() != 1) continue;
+        IRBlock &header = function.blocks[loop.header], &body = function.blocks[loop.latches[0]];
+        if (header.condition == IR_NONE || header.predecessors.size() != 2 || body.predecessors.size() != 1 || body.successors.size() != 1) continue;
+        const size_t exit = header.successors[0] == loop.latches[0] ? header.successors[1] : header.successors[0];
+        const size_t outside = header.predecessors[0] == loop.latches[0] ? 1 : 0, latch = 1 - outside;
+        // The loop goes on while the condition is this.
+        const bool repeat = header.successors[0] == loop.latches[0] ? header.jump_if : !header.jump_if;
+        // The condition compares a phi of the header with a constant.
+        const IRInstruction *condition = definitions[header.condition];
+        if (!condition || condition < header.instructions.data() || condition >= header.instructions.data() + header.instructions.size()) continue;
+        const opcode_t opcode = condition->opcode;
+        if (opcode != OP_EQ_INT && opcode != OP_NEQ_INT && opcode != OP_HT_INT && opcode != OP_HTE_INT && opcode != OP_LT_INT && opcode != OP_LTE_INT) continue;
+        if (!condition->operands[0].value || !condition->operands[1].value) continue;
+        const IRPhi *variable = nullptr;
+        size_t side = 0;
+        for (const IRPhi &phi : header.phis) {
+            for (size_t k = 0; k < 2; k++) {
+                if (condition->operands[k].word != phi.result) continue;
+                variable = &phi;
+                side = k;
+            }
+        }
+        if (!variable) continue;
+        // Get the start, the step and the bound.
+        nint_t start, step, bound;
+        if (!int_constant(function, definitions, variable->inputs[outside], start)) continue;
+        const IRInstruction *next = definitions[variable->inputs[latch]];
+        if (!next) continue;
+        if (next->opcode == OP_IINC && next->operands[0].word == variable->result) step = 1;
+        else if ((next->opcode == OP_ADD_INT || next->opcode == OP_SUB_INT) && next->operands[0].value && next->operands[1].value) {
+            const size_t other = next->operands[0].word == variable->result ? 1 : 0;
+            if (next->operands[1 - other].word != variable->result || (next->opcode == OP_SUB_INT && other == 0)) continue;
+            if (!int_constant(function, definitions, next->operands[other].word, step)) continue;
+            if (next->opcode == OP_SUB_INT) step = -step;
+        } else continue;
+        const ir_value_t limit = condition->operands[1 - side].word;
+        if (!int_constant(function, definitions, limit, bound)) {
+            // The length of a range of constants (the list is never modified in the loop).
+            const IRInstruction *length = definitions[limit];
+            if (!length || length->opcode != OP_CAST_LIST_INT || !definitions[length->operands[0].word]) continue;
+            const IRInstruction *range = definitions[length->operands[0].word];
+            nint_t from, to;
+            if (range->opcode != OP_RANGEE && range->opcode != OP_RANGEI) continue;
+            if (!int_constant(function, definitions, range->operands[0].word, from) || !int_constant(function, definitions, range->operands[1].word, to)) continue;
+            bool modified = false;
+            for (const IRBlock *block : { &header, &body }) {
+                for (const IRInstruction &instruction : block->instructions) {
+                    const IRMemory stored = ir_stored_memory(instruction.opcode);
+                    if (stored == IR_MEMORY_LIST || stored == IR_MEMORY_ALL) modified = true;
+                }
+            }
+            if (modified) continue;
+            bound = std::max(static_cast<nint_t>(0), to - from + (range->opcode == OP_RANGEI));
+        }
+        // Count the iterations.
+        auto check = [opcode](const nint_t a, const nint_t b) {
+            switch (opcode) {
+                case OP_EQ_INT: { return a == b; }
+                case OP_NEQ_INT: { return a != b; }
+                case OP_HT_INT: { return a > b; }
+                case OP_HTE_INT: { return a >= b; }
+                case OP_LT_INT: { return a < b; }
+                default: { return a <= b; }
+            }
+        };
+        size_t trips = 0;
+        for (nint_t value = start; trips <= IR_UNROLL_TRIPS && check(side == 0 ? value : bound, side == 0 ? bound : value) == repeat; value += step) trips++;
+        if (trips > IR_UNROLL_TRIPS || (trips + 1) * header.instructions.size() + trips * body.instructions.size() > IR_UNROLL_SIZE) continue;
+        // Copy the header and the iteration for each iteration, and then the header for the last check.
+        std::vector<ir_value_t> map(function.values.size(), IR_NONE);
+        auto remap = [&map](const ir_value_t value) { return value < map.size() && map[value] != IR_NONE ? map[value] : value; };
+        std::vector<IRInstruction> code;
+        auto copy = [&](const std::vector<IRInstruction> &instructions) {
+            for (IRInstruction instruction : instructions) {
+                for (IROperand &operand : instruction.operands) if (operand.value) operand.word = remap(operand.word);
+                if (instruction.result != IR_NONE) {
+                    const ir_value_t result = function.new_value(function.values[instruction.result].type);
+                    map[instruction.result] = result;
+                    instruction.result = result;
+                }
+                code.push_back(std::move(instruction));
+            }
+        };
+        for (const IRPhi &phi : header.phis) map[phi.result] = phi.inputs[outside];
+        for (size_t t = 0; t < trips; t++) {
+            copy(header.instructions);
+            copy(body.instructions);
+            std::vector<ir_value_t> inputs;
+            for (const IRPhi &phi : header.phis) inputs.push_back(remap(phi.inputs[latch]));
+            for (size_t k = 0; k < header.phis.size(); k++) map[header.phis[k].result] = inputs[k];
+        }
+        copy(header.instructions);
+        // The code after the loop uses the values of the last check.
+        std::vector<ir_value_t> replacements(function.values.size(), IR_NONE);
+        for (const IRPhi &phi : header.phis) replacements[phi.result] = map[phi.result];
+        for (const IRInstruction &instruction : header.instructions) {
+            if (instruction.result != IR_NONE) replacements[instruction.result] = map[instruction.result];
+        }
+        header.instructions = std::move(code);
+        header.phis.clear();
+        header.condition = IR_NONE;
+        header.successors = { exit };
+        header.predecessors = { header.predecessors[outside] };
+        body = IRBlock();
+        function.replace_values(replacements);
+        return true;
+    }
+    return false;
+}
+
+bool ir_bounds_checks(IRFunction &function)
+{
+    const std::vector<IRLoop> loops = function.find_loops();
+    const std::vector<IRInstruction *> definitions = find_definitions(function);
+    // Determines if an instruction may remove elements of a list or dictionary.
+    auto shrinks = [](const IRInstruction &instruction) {
+        const IRMemory stored = ir_stored_memory(instruction.opcode);
+        return stored == IR_MEMORY_ALL || instruction.opcode == OP_LDELETE || instruction.opcode == OP_DDELETE;
+    };
+    // Returns the block an instruction is in.
+    auto block_of = [&function](const IRInstruction *instruction) {
+        for (size_t b = 0; b < function.blocks.size(); b++) {
+            const std::vector<IRInstruction> &instructions = function.blocks[b].instructions;
+            if (!instructions.empty() && instruction >= instructions.data() && instruction < instructions.data() + instructions.size()) return b;
+        }
+        return IR_NO_BLOCK;
+    };
+    bool changed = false;
+    for (const IRLoop &loop : loops) {
+        const IRBlock &header = function.blocks[loop.header];
+        if (header.condition == IR_NONE || header.successors.size() != 2 || header.successors[0] == header.successors[1]) continue;
+        // The condition is index < length (or length > index), checked in the header.
+        const IRInstruction *condition = definitions[header.condition];
+        if (!condition || block_of(condition) != loop.header || !condition->operands[0].value || !condition->operands[1].value) continue;
+        if (condition->opcode != OP_LT_INT && condition->opcode != OP_HT_INT) continue;
+        const size_t side = condition->opcode == OP_LT_INT ? 0 : 1;
+        const ir_value_t index = condition->operands[side].word;
+        const IRInstruction *length = definitions[condition->operands[1 - side].word];
+        if (!length || (length->opcode != OP_CAST_LIST_INT && length->opcode != OP_CAST_DICT_INT)) continue;
+        const ir_value_t container = length->operands[0].word;
+        // The iteration starts where the condition is true and is only entered from the header.
+        const size_t taken = header.jump_if ? header.successors[0] : header.successors[1];
+        if (!loop.body[taken] || function.blocks[taken].predecessors.size() != 1) continue;
+        // The index is a phi of the header that starts at a non negative constant and never decreases.
+        const IRPhi *variable = nullptr;
+        for (const IRPhi &phi : header.phis) if (phi.result == index) variable = &phi;
+        if (!variable) continue;
+        bool increasing = true;
+        for (size_t p = 0; p < header.predecessors.size(); p++) {
+            const ir_value_t input = variable->inputs[p];
+            nint_t constant;
+            if (!loop.body[header.predecessors[p]]) {
+                if (!int_constant(function, definitions, input, constant) || constant < 0) increasing = false;
+                continue;
+            }
+            const IRInstruction *next = definitions[input];
+            if (next && next->opcode == OP_IINC && next->operands[0].word == index) continue;
+            if (next && next->opcode == OP_ADD_INT && next->operands[0].value && next->operands[1].value) {
+                const size_t other = next->operands[0].word == index ? 1 : 0;
+                if (next->operands[1 - other].word == index && int_constant(function, definitions, next->operands[other].word, constant) && constant >= 0) continue;
+            }
+            increasing = false;
+        }
+        if (!increasing) continue;
+        // The length is still the same (or bigger) when the elements are accessed: it's computed in the header,
+        // or in the only block before the loop with nothing after it that removes elements.
+        const size_t computed = block_of(length);
+        bool valid = computed == loop.header;
+        if (!valid && !loop.body[computed]) {
+            size_t outside = IR_NO_BLOCK, entries = 0;
+            for (const size_t predecessor : header.predecessors) if (!loop.body[predecessor]) outside = predecessor, entries++;
+            if (entries == 1 && outside == computed) {
+                const std::vector<IRInstruction> &instructions = function.blocks[computed].instructions;
+                valid = std::none_of(instructions.begin() + (length - instructions.data()), instructions.end(), shrinks);
+            }
+        }
+        if (!valid) continue;
+        // If the loop removes elements, only the accesses before it in the first block of the iteration are safe.
+        bool removes = false;
+        for (const size_t b : loop.blocks) {
+            const std::vector<IRInstruction> &instructions = function.blocks[b].instructions;
+            if (std::any_of(instructions.begin(), instructions.end(), shrinks)) removes = true;
+        }
+        for (const size_t b : loop.blocks) {
+            if (removes ? b != taken : !function.dominates(taken, b)) continue;
+            for (IRInstruction &instruction : function.blocks[b].instructions) {
+                if (shrinks(instruction)) break;
+                if (instruction.operands.size() < 2 || instruction.operands[0].word != container || instruction.operands[1].word != index) continue;
+                if (!instruction.operands[0].value || !instruction.operands[1].value) continue;
+                const bool list = length->opcode == OP_CAST_LIST_INT;
+                if (list && instruction.opcode == OP_LGET) instruction.opcode = OP_LGET_U;
+                else if (list && instruction.opcode == OP_LSET) instruction.opcode = OP_LSET_U;
+                else if (!list && instruction.opcode == OP_DKEY) instruction.opcode = OP_DKEY_U;
+                else continue;
+                changed = true;
+            }
+        }
+    }
+    return changed;
+}
@@ -0,0 +1,236 @@
+/**
+ * |------------------------|
+ * | Nuua Optimization Pass |
+ * |------------------------|
+ *
+ * Copyright 2019 Erik Campobadal <soc@erik.cat>
+ * https://nuua.io
+ */
+#include "../include/ir.hpp"
+#include <algorithm>
+#include <map>
+
+// Determines if the two operands of an opcode can be swapped.
+static bool is_commutative(const opcode_t opcode)
+{
+    switch (opcode) {
+        case OP_ADD_INT: case OP_ADD_FLOAT: case OP_ADD_BOOL: case OP_MUL_INT: case OP_MUL_FLOAT: case OP_MUL_BOOL:
+        case OP_EQ_INT: case OP_EQ_FLOAT: case OP_EQ_STRING: case OP_EQ_BOOL:
+        case OP_NEQ_INT: case OP_NEQ_FLOAT: case OP_NEQ_STRING: case OP_NEQ_BOOL: case OP_OR: case OP_AND: { return true; }
+        default: { return false; }
+    }
+}
+
+IRPassManager::IRPassManager()
+{
+    this->add("copy-propagation", ir_copy_propagation);
+    this->add("value-numbering", ir_value_numbering);
+    this->add("scalar-replacement", ir_scalar_replacement);
+    this->add("loop-invariants", ir_loop_invariants);
+    this->add("induction-variables", ir_induction_variables);
+    this->add("loop-unrolling", ir_loop_unrolling);
+    this->add("bounds-checks", ir_bounds_checks);
+    this->add("dead-code", ir_dead_code);
+}
+
+void IRPassManager::add(const std::string &name, const IRPass &pass)
+{
+    this->passes.push_back({ name, pass });
+}
+
+void IRPassManager::run(IRFunction &function) const
+{
+    for (bool changed = true; changed;) {
+        changed = false;
+        for (const auto &[name, pass] : this->passes) if (pass(function)) changed = true;
+    }
+}
+
+bool ir_copy_propagation(IRFunction &function)
+{
+    std::vector<ir_value_t> replacements(function.values.size(), IR_NONE);
+    auto find = [&replacements](ir_value_t value) {
+        while (replacements[value] != IR_NONE) value = replacements[value];
+        return value;
+    };
+    bool changed = false;
+    for (IRBlock &block : function.blocks) {
+        // A phi whose inputs are all the same value (or itself) is that value.
+        block.phis.erase(std::remove_if(block.phis.begin(), block.phis.end(), [&](const IRPhi &phi) {
+            ir_value_t same = IR_NONE;
+            for (const ir_value_t input : phi.inputs) {
+                const ir_value_t value = find(input);
+                if (value == phi.result || value == same) continue;
+                if (same != IR_NONE) return false;
+                same = value;
+            }
+            if (same == IR_NONE) return false;
+            replacements[phi.result] = same;
+            return changed = true;
+        }), block.phis.end());
+        block.instructions.erase(std::remove_if(block.instructions.begin(), block.instructions.end(), [&](const IRInstruction &instruction) {
+            if (instruction.opcode != OP_MOVE || instruction.result == IR_NONE || !instruction.operands[0].value) return false;
+            replacements[instruction.result] = find(instruction.operands[0].word);
+            return changed = true;
+        }), block.instructions.end());
+    }
+    if (changed) function.replace_values(replacements);
+    return changed;
+}
+
+bool ir_dead_code(IRFunction &function)
+{
+    // Stores where each value is set.
+    std::vector<const IRInstruction *> instructions(function.values.size(), nullptr);
+    std::vector<const IRPhi *> phis(function.values.size(), nullptr);
+    // Stores the values that are used (by an instruction that stays or by a used value).
+    std::vector<bool> live(function.values.size(), false);
+    std::vector<ir_value_t> worklist;
+    auto use = [&live, &worklist](const ir_value_t value) {
+        if (live[value]) return;
+        live[value] = true;
+        worklist.push_back(value);
+    };
+    for (const IRBlock &block : function.blocks) {
+        for (const IRPhi &phi : block.phis) phis[phi.result] = &phi;
+        for (const IRInstruction &instruction : block.instructions) {
+            if (instruction.result != IR_NONE && opcode_is_removable(instruction.opcode)) {
+                instructions[instruction.result] = &instruction;
+                continue;
+            }
+            for (const IROperand &operand : instruction.operands) if (operand.value) use(operand.word);
+        }
+        if (block.condition != IR_NONE) use(block.condition);
+    }
+    while (!worklist.empty()) {
+        const ir_value_t value = worklist.back();
+        worklist.pop_back();
+        if (instructions[value]) {
+            for (const IROperand &operand : instructions[value]->operands) if (operand.value) use(operand.word);
+        } else if (phis[value]) {
+            for (const ir_value_t input : phis[value]->inputs) use(input);
+        }
+    }
+    bool changed = false;
+    for (IRBlock &block : function.blocks) {
+        block.phis.erase(std::remove_if(block.phis.begin(), block.phis.end(), [&](const IRPhi &phi) {
+            if (live[phi.result]) return false;
+            changed = true;
+            return true;
+        }), block.phis.end());
+        block.instructions.erase(std::remove_if(block.instructions.begin(), block.instructions.end(), [&](const IRInstruction &instruction) {
+            if (instruction.result == IR_NONE || live[instruction.result] || !opcode_is_removable(instruction.opcode)) return false;
+            return changed = true;
+        }), block.instructions.end());
+    }
+    return changed;
+}
+
+bool ir_value_numbering(IRFunction &function)
+{
+    function.compute_dominators();
+    const std::vector<std::vector<size_t>> children = function.dominator_tree();
+    std::vector<ir_value_t> replacements(function.values.size(), IR_NONE);
+    auto find = [&replacements](ir_value_t value) {
+        while (replacements[value] != IR_NONE) value = replacements[value];
+        return value;
+    };
+    // Stores the values computed by the dominating instructions: the ones that only depend
+    // on their operands and the ones that load the memory (until something modifies it).
+    std::map<std::vector<opcode_t>, ir_value_t> tables[2];
+    // Stores the changes to the tables to undo them when leaving a block.
+    std::vector<std::tuple<size_t, std::vector<opcode_t>, ir_value_t>> changes;
+    auto set = [&tables, &changes](const size_t table, const std::vector<opcode_t> &key, const ir_value_t value) {
+        const auto entry = tables[table].find(key);
+        changes.push_back({ table, key, entry == tables[table].end() ? IR_NONE : entry->second });
+        if (value == IR_NONE) tables[table].erase(entry);
+        else tables[table][key] = value;
+    };
+    auto kill = [&tables, &set](const IRMemory memory, const opcode_t word) {
+        std::vector<std::vector<opcode_t>> killed;
+        for (const auto &[key, value] : tables[1]) {
+            const IRMemory loaded = ir_loaded_memory(key[0]);
+            // The properties and globals are only modified if they are the same one.
+            if (memory == IR_MEMORY_ALL || (loaded == memory && ((memory != IR_MEMORY_PROP && memory != IR_MEMORY_GLOBAL) || key.back() == word))) {
+                killed.push_back(key);
+            }
+        }
+        for (const std::vector<opcode_t> &key : killed) set(1, key, IR_NONE);
+    };
+    // Stores the first constant with each value.
+    std::map<std::pair<ValueType, std::string>, opcode_t> constants;
+    auto constant = [&function, &constants](const opcode_t index) {
+        const Value &value = function.memory->constants[index];
+        std::string content;
+        switch (value.type->type) {
+            case VALUE_INT: { content = std::to_string(GETV(value.value, nint_t)); break; }
+            case VALUE_FLOAT: {
+                const nfloat_t number = GETV(value.value, nfloat_t);
+                content = std::string(reinterpret_cast<const char *>(&number), sizeof(nfloat_t));
+                break;
+            }
+            case VALUE_BOOL: { content = GETV(value.value, nbool_t) ? "1" : "0"; break; }
+            case VALUE_STRING: { content = GETV(value.value, nstring_t); break; }
+            // The other constants are objects, so only the same constant is the same value.
+            default: { return index; }
+        }
+        return constants.insert({ { value.type->type, content }, index }).first->second;
+    };
+    bool changed = false;
+    auto number = [&](const size_t b) {
+        IRBlock &block = function.blocks[b];
+        // The memory may be modified in another path to the block.
+        if (block.predecessors.size() != 1) kill(IR_MEMORY_ALL, 0);
+        for (const IRInstruction &instruction : block.instructions) {
+            const IRMemory stored = ir_stored_memory(instruction.opcode);
+            if (stored != IR_MEMORY_NONE) kill(stored, instruction.operands[0].word);
+            if (instruction.result == IR_NONE) continue;
+            const IRMemory loaded = ir_loaded_memory(instruction.opcode);
+            if (loaded == IR_MEMORY_ALL) continue;
+            std::vector<opcode_t> key = { instruction.opcode };
+            for (const IROperand &operand : instruction.operands) {
+                key.push_back(operand.value);
+                key.push_back(!operand.value ? operand.word : find(operand.word));
+            }
+            if (instruction.opcode == OP_LOAD_C) key[2] = constant(key[2]);
+            if (is_commutative(instruction.opcode) && key[1] && key[3] && key[2] > key[4]) std::swap(key[2], key[4]);
+            const size_t table = loaded != IR_MEMORY_NONE;
+            const auto entry = tables[table].find(key);
+            if (entry == tables[table].end()) {
+                set(table, key, instruction.result);
+                continue;
+            }
+            replacements[instruction.result] = entry->second;
+            changed = true;
+        }
+    };
+    // Walk the dominator tree.
+    std::vector<std::pair<size_t, size_t>> stack = { { 0, 0 } };
+    std::vector<size_t> marks = { 0 };
+    number(0);
+    while (!stack.empty()) {
+        auto &[b, next] = stack.back();
+        if (next < children[b].size()) {
+            const size_t child = children[b][next++];
+            marks.push_back(changes.size());
+            number(child);
+            stack.push_back({ child, 0 });
+            continue;
+        }
+        for (; changes.size() > marks.back(); changes.pop_back()) {
+            auto &[table, key, value] = changes.back();
+            if (value == IR_NONE) tables[table].erase(key);
+            else tables[table][key] = value;
+        }
+        marks.pop_back();
+        stack.pop_back();
+    }
+    if (!changed) return false;
+    for (IRBlock &block : function.blocks) {
+        block.instructions.erase(std::remove_if(block.instructions.begin(), block.instructions.end(), [&replacements](const IRInstruction &instruction) {
+            return instruction.result != IR_NONE && replacements[instruction.result] != IR_NONE;
+        }), block.instructions.end());
+    }
+    function.replace_values(replacements);
+    return true;
+}
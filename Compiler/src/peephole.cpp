@@ -0,0 +1,215 @@
+/**
+ * |-------------------------|
+ * | Nuua Peephole Optimizer |
+ * |-------------------------|
+ *
+ * Copyright 2019 Erik Campobadal <soc@erik.cat>
+ * https://nuua.io
+ */
+#include "../include/peephole.hpp"
+#include <algorithm>
+#include <unordered_map>
+
+// Determines if the instruction reads the register.
+static bool reads_register(const std::vector<opcode_t> &words, const opcode_t reg)
+{
+    const std::vector<OpCodeType> *operands = opcode_operands(words[0]);
+    for (size_t k = 0; k < operands->size(); k++) {
+        if ((*operands)[k] != OT_REG || words[k + 1] != reg) continue;
+        if (k > 0 || !opcode_defines_register(words[0])) return true;
+    }
+    return false;
+}
+
+bool Peephole::decode()
+{
+    const std::vector<opcode_t> &code = this->memory->code;
+    std::vector<size_t> instruction_at(code.size() - this->entry + 1, static_cast<size_t>(-1));
+    for (size_t i = this->entry; i < code.size();) {
+        const size_t size = opcode_operands(code[i])->size() + 1;
+        if (i + size > code.size()) return false;
+        instruction_at[i - this->entry] = this->instructions.size();
+        this->origins.push_back({ i, this->instructions.size() });
+        this->instructions.push_back({ std::vector<opcode_t>(code.begin() + i, code.begin() + i + size) });
+        i += size;
+    }
+    instruction_at[code.size() - this->entry] = this->instructions.size();
+    for (PeepholeInstruction &instruction : this->instructions) {
+        const opcode_t opcode = instruction.words[0];
+        if (!opcode_is_jump(opcode)) continue;
+        const size_t position = this->origins[&instruction - this->instructions.data()].first;
+        const size_t target = opcode_is_backward_jump(opcode) ? position - instruction.words[1] : position + instruction.words[1];
+        // Leave the function as it is if a jump goes out of it.
+        if (target < this->entry || target > code.size() || instruction_at[target - this->entry] == static_cast<size_t>(-1)) return false;
+        instruction.target = instruction_at[target - this->entry];
+        if (instruction.target < this->instructions.size()) this->instructions[instruction.target].leader = true;
+    }
+    return true;
+}
+
+void Peephole::compact()
+{
+    std::vector<size_t> indexes(this->instructions.size() + 1);
+    std::vector<PeepholeInstruction> instructions;
+    for (size_t i = 0; i < this->instructions.size(); i++) {
+        indexes[i] = instructions.size();
+        if (!this->instructions[i].removed) instructions.push_back(std::move(this->instructions[i]));
+    }
+    indexes[this->instructions.size()] = instructions.size();
+    for (PeepholeInstruction &instruction : instructions) {
+        instruction.leader = false;
+        if (opcode_is_jump(instruction.words[0])) instruction.target = indexes[instruction.target];
+    }
+    for (const PeepholeInstruction &instruction : instructions) {
+        if (opcode_is_jump(instruction.words[0]) && instruction.target < instructions.size()) instructions[instruction.target].leader = true;
+    }
+    for (std::pair<size_t, size_t> &origin : this->origins) origin.second = indexes[origin.second];
+    this->instructions = std::move(instructions);
+}
+
+bool Peephole::remove_self_moves()
+{
+    bool changed = false;
+    for (PeepholeInstruction &instruction : this->instructions) {
+        if (instruction.words[0] == OP_MOVE && instruction.words[1] == instruction.words[2]) changed = instruction.removed = true;
+    }
+    return changed;
+}
+
+bool Peephole::remove_overwritten_loads()
+{
+    bool changed = false;
+    for (size_t i = 0; i + 1 < this->instructions.size(); i++) {
+        PeepholeInstruction &instruction = this->instructions[i];
+        if (instruction.words[0] != OP_MOVE && instruction.words[0] != OP_LOAD_C) continue;
+        // The next opcode sets the register without reading it.
+        const std::vector<opcode_t> &next = this->instructions[i + 1].words;
+        const std::vector<OpCodeType> *operands = opcode_operands(next[0]);
+        if (operands->empty() || (*operands)[0] != OT_REG || !opcode_defines_register(next[0])) continue;
+        if (next[1] != instruction.words[1] || reads_register(next, instruction.words[1])) continue;
+        changed = instruction.removed = true;
+    }
+    return changed;
+}
+
+bool Peephole::remove_repeated_constants()
+{
+    bool changed = false;
+    // Stores the constant each register has.
+    std::unordered_map<opcode_t, opcode_t> constants;
+    for (PeepholeInstruction &instruction : this->instructions) {
+        // Other paths get here with other register values.
+        if (instruction.leader) constants.clear();
+        if (instruction.words[0] == OP_LOAD_C) {
+            const auto constant = constants.find(instruction.words[1]);
+            if (constant != constants.end() && constant->second == instruction.words[2]) changed = instruction.removed = true;
+            else constants[instruction.words[1]] = instruction.words[2];
+            continue;
+        }
+        // The first register is the one opcodes set or modify.
+        const std::vector<OpCodeType> *operands = opcode_operands(instruction.words[0]);
+        if (!operands->empty() && (*operands)[0] == OT_REG) constants.erase(instruction.words[1]);
+    }
+    return changed;
+}
+
+bool Peephole::merge_push_pop()
+{
+    bool changed = false;
+    for (size_t i = 0; i + 1 < this->instructions.size(); i++) {
+        PeepholeInstruction &push = this->instructions[i], &pop = this->instructions[i + 1];
+        if ((push.words[0] != OP_PUSH && push.words[0] != OP_PUSH_C) || pop.words[0] != OP_POP || pop.leader) continue;
+        if (push.words[0] == OP_PUSH && push.words[1] == pop.words[1]) push.removed = true;
+        else push.words = { push.words[0] == OP_PUSH ? OP_MOVE : OP_LOAD_C, pop.words[1], push.words[1] };
+        pop.removed = changed = true;
+        i++;
+    }
+    return changed;
+}
+
+bool Peephole::thread_jumps()
+{
+    bool changed = false;
+    for (size_t i = 0; i < this->instructions.size(); i++) {
+        PeepholeInstruction &instruction = this->instructions[i];
+        if (!opcode_is_jump(instruction.words[0])) continue;
+        size_t target = instruction.target;
+        for (size_t jumps = 0; jumps < PEEPHOLE_MAX_THREAD && target < this->instructions.size() && target != i; jumps++) {
+            if (!opcode_is_unconditional_jump(this->instructions[target].words[0])) break;
+            target = this->instructions[target].target;
+        }
+        if (target != instruction.target) {
+            instruction.target = target;
+            changed = true;
+        }
+        // A jump to the next opcode does nothing.
+        if (instruction.target == i + 1) changed = instruction.removed = true;
+    }
+    return changed;
+}
+
+void Peephole::encode()
+{
+    std::vector<size_t> positions(this->instructions.size() + 1);
+    std::vector<opcode_t> function;
+    for (size_t i = 0; i < this->instructions.size(); i++) {
+        positions[i] = this->entry + function.size();
+        function.insert(function.end(), this->instructions[i].words.begin(), this->instructions[i].words.end());
+    }
+    positions[this->instructions.size()] = this->entry + function.size();
+    // Set the jump offsets.
+    for (size_t i = 0; i < this->instructions.size(); i++) {
+        const opcode_t opcode = this->instructions[i].words[0];
+        if (!opcode_is_jump(opcode)) continue;
+        const size_t position = positions[i], target = positions[this->instructions[i].target];
+        opcode_t *jump = function.data() + (position - this->entry);
+        jump[0] = opcode_jump(opcode, target < position);
+        jump[1] = target < position ? position - target : target - position;
+    }
+    // Move the source locations to the new positions.
+    const size_t end = this->memory->code.size();
+    auto relocate = [this, &positions, end](auto &locations) {
+        std::vector<std::pair<size_t, typename std::remove_reference_t<decltype(locations)>::mapped_type>> moved;
+        for (auto location = locations.begin(); location != locations.end();) {
+            if (location->first < this->entry) location++;
+            else {
+                moved.push_back(*location);
+                location = locations.erase(location);
+            }
+        }
+        std::sort(moved.begin(), moved.end(), [](const auto &a, const auto &b) { return a.first < b.first; });
+        for (const auto &[position, location] : moved) {
+            // Locations past the last opcode stay past it.
+            size_t at = this->instructions.size();
+            if (position < end) {
+                auto origin = std::upper_bound(this->origins.begin(), this->origins.end(), position, [](const size_t p, const auto &o) { return p < o.first; });
+                at = (origin - 1)->second;
+            }
+            locations[positions[at]] = location;
+        }
+    };
+    relocate(this->memory->files);
+    relocate(this->memory->lines);
+    relocate(this->memory->columns);
+    this->memory->code.resize(this->entry);
+    this->memory->code.insert(this->memory->code.end(), function.begin(), function.end());
+}
+
+void Peephole::optimize(const size_t entry)
+{
+    this->entry = entry;
+    if (entry >= this->memory->code.size() || !this->decode()) return;
+    bool optimized = false;
+    for (bool changed = true; changed;) {
+        changed = false;
+        for (bool (Peephole::*optimization)() : {
+            &Peephole::remove_self_moves, &Peephole::remove_overwritten_loads,
+            &Peephole::remove_repeated_constants, &Peephole::merge_push_pop, &Peephole::thread_jumps
+        }) {
+            if (!(this->*optimization)()) continue;
+            this->compact();
+            changed = optimized = true;
+        }
+    }
+    if (optimized) this->encode();
+}
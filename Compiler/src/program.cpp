@@ -37,11 +37,14 @@ static std::pair<std::string, std::vector<OpCodeType>> opcode_names[] = {
     { "LPUSH_C", {{ OT_REG, OT_CONST }} }, // LPUSH_C RX C1
     // { "LPOP", {{ OT_REG }} }, // LPOP RX
     { "LGET", {{ OT_REG, OT_REG, OT_REG }} }, // LGET RX RY RZ
+    { "LGET_U", {{ OT_REG, OT_REG, OT_REG }} }, // LGET_U RX RY RZ
     { "LSET", {{ OT_REG, OT_REG, OT_REG }} }, // LSET RX RY RZ
+    { "LSET_U", {{ OT_REG, OT_REG, OT_REG }} }, // LSET_U RX RY RZ
     { "LDELETE", {{ OT_REG, OT_REG }} }, // LDELETE RX RY
 
     // Dictionary releated
     { "DKEY", {{ OT_REG, OT_REG, OT_REG }} }, // DKEY RX RY RZ
+    { "DKEY_U", {{ OT_REG, OT_REG, OT_REG }} }, // DKEY_U RX RY RZ
     { "DGET", {{ OT_REG, OT_REG, OT_REG }} }, // DGET RX RY RZ
     { "DSET", {{ OT_REG, OT_REG, OT_REG }} }, // DSET RX RY RZ
     { "DDELETE", {{ OT_REG, OT_REG }} }, // DDELETE RX RY
@@ -50,10 +53,12 @@ static std::pair<std::string, std::vector<OpCodeType>> opcode_names[] = {
     { "CALL", {{ OT_REG }} }, // CALL RX
     // { "GCALL", {{ OT_GLOBAL }} }, // CALL G1
     { "RETURN", { } }, // RETURN
+    { "MEMO", {{ OT_CONST, OT_LITERAL }} }, // MEMO C1 L1
 
     // Object releated
     { "LPROP", {{ OT_REG, OT_REG, OT_PROP }} }, // LPROP RX RY PX
     { "SPROP", {{ OT_PROP, OT_REG, OT_REG }} }, // SPROP PX RX RY
+    { "CHECK_OBJECT", {{ OT_REG }} }, // CHECK_OBJECT RX
 
     // Value casting
     { "CAST_INT_FLOAT", {{ OT_REG, OT_REG }} }, // CAST_INT_FLOAT RX RY
@@ -194,6 +199,81 @@ std::vector<OpCodeType> *opcode_operands(const opcode_t opcode)
     return &opcode_names[opcode].second;
 }
 
+bool opcode_defines_register(const opcode_t opcode)
+{
+    switch (opcode) {
+        case OP_PUSH: case OP_SSET: case OP_SDELETE: case OP_LPUSH: case OP_LPUSH_C:
+        case OP_LSET: case OP_LSET_U: case OP_LDELETE: case OP_DSET: case OP_DDELETE: case OP_CALL:
+        case OP_IINC: case OP_IDEC: case OP_PRINT: case OP_MEMO: case OP_CHECK_OBJECT: { return false; }
+        default: { return true; }
+    }
+}
+
+bool opcode_writes_before_reading(const opcode_t opcode)
+{
+    switch (opcode) {
+        case OP_SGET: case OP_LGET: case OP_LGET_U: case OP_DGET: case OP_ADD_LIST: case OP_ADD_DICT:
+        case OP_MUL_INT_LIST: case OP_MUL_LIST_INT: case OP_DIV_LIST_INT: { return true; }
+        default: { return false; }
+    }
+}
+
+bool opcode_is_jump(const opcode_t opcode)
+{
+    return opcode >= OP_FJUMP && opcode <= OP_CBNJUMP;
+}
+
+bool opcode_is_unconditional_jump(const opcode_t opcode)
+{
+    return opcode == OP_FJUMP || opcode == OP_BJUMP;
+}
+
+bool opcode_is_backward_jump(const opcode_t opcode)
+{
+    return opcode == OP_BJUMP || opcode == OP_CBJUMP || opcode == OP_CBNJUMP;
+}
+
+opcode_t opcode_jump(const opcode_t opcode, const bool backward)
+{
+    // The jumps are in (forward, backward) pairs.
+    return OP_FJUMP + ((opcode - OP_FJUMP) & ~static_cast<opcode_t>(1)) + backward;
+}
+
+bool opcode_modifies_register(const opcode_t opcode)
+{
+    return opcode == OP_IINC || opcode == OP_IDEC || opcode == OP_SSET || opcode == OP_SDELETE;
+}
+
+bool opcode_is_pure(const opcode_t opcode)
+{
+    switch (opcode) {
+        case OP_MOVE: case OP_LOAD_C: case OP_NEG_BOOL: case OP_IINC: case OP_IDEC:
+        case OP_MINUS_INT: case OP_MINUS_FLOAT: case OP_MINUS_BOOL:
+        case OP_PLUS_INT: case OP_PLUS_FLOAT: case OP_PLUS_BOOL:
+        case OP_ADD_INT: case OP_ADD_FLOAT: case OP_ADD_STRING: case OP_ADD_BOOL:
+        case OP_SUB_INT: case OP_SUB_FLOAT: case OP_SUB_BOOL:
+        case OP_MUL_INT: case OP_MUL_FLOAT: case OP_MUL_BOOL:
+        case OP_CAST_INT_FLOAT: case OP_CAST_INT_BOOL: case OP_CAST_INT_STRING:
+        case OP_CAST_FLOAT_INT: case OP_CAST_FLOAT_BOOL: case OP_CAST_FLOAT_STRING:
+        case OP_CAST_BOOL_INT: case OP_CAST_BOOL_FLOAT: case OP_CAST_BOOL_STRING:
+        case OP_CAST_STRING_BOOL: case OP_OR: case OP_AND: { return true; }
+        // The comparisons (but the list and dict ones, that compare the elements).
+        case OP_EQ_LIST: case OP_EQ_DICT: case OP_NEQ_LIST: case OP_NEQ_DICT: { return false; }
+        default: { return opcode >= OP_EQ_INT && opcode <= OP_LTE_BOOL; }
+    }
+}
+
+bool opcode_is_removable(const opcode_t opcode)
+{
+    switch (opcode) {
+        case OP_LOAD_G: case OP_LGET_U: case OP_DKEY_U: case OP_ADD_LIST: case OP_ADD_DICT:
+        case OP_CAST_LIST_STRING: case OP_CAST_LIST_BOOL: case OP_CAST_LIST_INT:
+        case OP_CAST_DICT_STRING: case OP_CAST_DICT_BOOL: case OP_CAST_DICT_INT:
+        case OP_EQ_LIST: case OP_EQ_DICT: case OP_NEQ_LIST: case OP_NEQ_DICT: { return true; }
+        default: { return opcode_is_pure(opcode); }
+    }
+}
+
 void print_opcode(const opcode_t opcode)
 {
     printf("%17.17s", opcode_to_string(opcode).c_str());
@@ -210,7 +290,8 @@ void Frame::allocate_registers(registers_size_t size)
     */
     //printf("%llu, %llu: %d\n", size, registers_size, size > registers_size);
     // if (size > registers_size) this->registers.reset(new Value[size]);
-    this->registers.reset(new Value[size]);
+    this->free_registers();
+    this->registers = heap->allocate_values(size);
     /*
     else {
         for (size_t i = 0; i < this->registers_size; i++) {
@@ -225,7 +306,8 @@ void Frame::allocate_registers(registers_size_t size)
 void Frame::free_registers()
 {
     if (this->registers) {
-        this->registers.reset();
+        heap->free_values(this->registers, this->registers_size);
+        this->registers = nullptr;
     }
 }
 
@@ -252,25 +334,28 @@ reg_t FrameInfo::get_register(bool protect)
         // Delete the register since it will be used.
         this->free_registers.pop_back();
     }
+    if (reg >= this->register_states.size()) this->register_states.resize(reg + 1, 0);
+    this->register_states[reg] &= ~REGISTER_FREE;
     // Protect it in case protect is true.
-    if (protect) this->protected_registers.push_back(reg);
+    if (protect) this->register_states[reg] |= REGISTER_PROTECTED;
     // Return the register.
     return reg;
 }
 
 void FrameInfo::free_register(reg_t reg, bool force)
 {
+    if (reg >= this->register_states.size()) this->register_states.resize(reg + 1, 0);
     // Check if it's a protected register
-    auto el = std::find(this->protected_registers.begin(), this->protected_registers.end(), reg);
-    if (el != this->protected_registers.end()) {
+    if (this->register_states[reg] & REGISTER_PROTECTED) {
         // The register is currently protected
         // Check if we're forcing a remove or not.
         if (!force) return;
-        // Remove it from the protected list.
-        this->protected_registers.erase(el);
+        // Remove the protection.
+        this->register_states[reg] &= ~REGISTER_PROTECTED;
     }
     // Add the element to the free list.
-    if (std::find(this->free_registers.begin(), this->free_registers.end(), reg) == this->free_registers.end()) {
+    if (!(this->register_states[reg] & REGISTER_FREE)) {
+        this->register_states[reg] |= REGISTER_FREE;
         this->free_registers.push_back(reg);
     }
 }
@@ -279,7 +364,7 @@ void FrameInfo::reset()
 {
     this->current_register = 0;
     this->free_registers.clear();
-    this->protected_registers.clear();
+    this->register_states.clear();
 }
 
 Program::Program()
@@ -12,14 +12,49 @@
 // #include <cmath>
 // #include <iostream>
 
+RuntimeType TypeRef::natives[VALUE_LIST] = {
+    { Type(VALUE_INT), 1 }, { Type(VALUE_FLOAT), 1 }, { Type(VALUE_BOOL), 1 }, { Type(VALUE_STRING), 1 }
+};
+
+RuntimeType::~RuntimeType()
+{
+    if (this->inner && --this->inner->references == 0) delete this->inner;
+}
+
+void TypeRef::free(RuntimeType *runtime_type)
+{
+    // The native types are static (the other ones are never scalars without an inner type).
+    if (runtime_type->type.type < VALUE_LIST && !runtime_type->type.inner_type) return;
+    delete runtime_type;
+}
+
+TypeRef::TypeRef(const Type &type)
+{
+    this->runtime_type = type.type < VALUE_LIST && !type.inner_type ? TypeRef::natives + type.type : new RuntimeType(type);
+    this->runtime_type->references++;
+}
+
+TypeRef TypeRef::inner() const
+{
+    // The inner type is created once and shared by all the references.
+    if (!this->runtime_type->inner) {
+        TypeRef ref = TypeRef(*this->runtime_type->type.inner_type);
+        (this->runtime_type->inner = ref.runtime_type)->references++;
+    }
+    return TypeRef(this->runtime_type->inner);
+}
+
+Value::Value(const nlist_t &a, const std::shared_ptr<Type> &inner_type)
+    : type(Type(VALUE_LIST, inner_type)), value(heap->allocate<nlist_t>(a)) {}
+
 Value::Value(const std::unordered_map<std::string, Value> &a, const std::vector<std::string> &b, const std::shared_ptr<Type> &inner_type)
-    : type({ VALUE_DICT, inner_type }), value(std::make_shared<ndict_t>(a, b)) {}
+    : type(Type(VALUE_DICT, inner_type)), value(heap->allocate<ndict_t>(a, b)) {}
 
 Value::Value(const size_t index, const registers_size_t registers, const Type &type)
-    : type(type), value(std::make_shared<nfun_t>(index, registers)) {}
+    : type(type), value(heap->allocate<nfun_t>(index, registers)) {}
 
 Value::Value(const std::string &class_name, const std::vector<std::string> &props)
-    : type({ class_name }), value(std::make_shared<nobject_t>(props)) {}
+    : type(Type(class_name)), value(heap->allocate<nobject_t>(props)) {}
 
 Value::Value(const std::shared_ptr<Type> &type)
 {
@@ -31,26 +66,18 @@ Value::Value(const Type &type)
     this->build_from_type(&type);
 }
 
-Value::Value(const Value &value)
-{
-    // Copy the type.
-    value.type.copy_to(this->type);
-    // Copy the value.
-    this->value = value.value;
-}
-
 void Value::build_from_type(const Type *type)
 {
-    type->copy_to(this->type);
+    this->type = TypeRef(*type);
     switch (type->type) {
         case VALUE_INT: { this->value = static_cast<nint_t>(0); break; }
         case VALUE_FLOAT: { this->value = 0.0; break; }
         case VALUE_BOOL: { this->value = false; break; }
         case VALUE_STRING: { this->value = std::string(); break; }
-        case VALUE_LIST: { this->value = std::make_shared<std::vector<Value>>(); break; }
-        case VALUE_DICT: { this->value = std::make_shared<ValueDictionary>(std::unordered_map<std::string, Value>(), std::vector<std::string>()); break; }
-        case VALUE_FUN: { this->value = std::shared_ptr<nfun_t>(); break; }
-        case VALUE_OBJECT: { this->value = std::shared_ptr<nobject_t>(); break; }
+        case VALUE_LIST: { this->value = heap->allocate<nlist_t>(); break; }
+        case VALUE_DICT: { this->value = heap->allocate<ndict_t>(std::unordered_map<std::string, Value>(), std::vector<std::string>()); break; }
+        case VALUE_FUN: { this->value = static_cast<nfun_t *>(nullptr); break; }
+        case VALUE_OBJECT: { this->value = static_cast<nobject_t *>(nullptr); break; }
         default: {
             logger->add_entity(std::shared_ptr<const std::string>(), 0, 0, "Can't declare a value given only the type: '" + type->to_string() + "'.");
             exit(logger->crash());
@@ -61,32 +88,22 @@ void Value::build_from_type(const Type *type)
 
 void Value::retype(ValueType new_type, const std::shared_ptr<Type> &new_inner_type)
 {
-    this->type.reset(new_type, new_inner_type);
-}
-
-void Value::copy_to(Value *dest) const
-{
-    // Simple check to see if there's no need to copy it.
-    if (this == dest) return;
-    // Copy the type.
-    this->type.copy_to(dest->type);
-    // Copy the value.
-    dest->value = this->value;
+    this->type = TypeRef(Type(new_type, new_inner_type));
 }
 
 bool Value::same_as(const Value &value) const
 {
     // Check if they match in type.
-    if (!this->type.same_as(value.type)) return false;
+    if (!(this->type == value.type) && !this->type->same_as(*value.type)) return false;
     // Check the value.
-    switch (this->type.type) {
+    switch (this->type->type) {
         case VALUE_INT:
         case VALUE_FLOAT:
         case VALUE_BOOL:
         case VALUE_STRING: { return this->value == value.value; }
         case VALUE_LIST: {
-            const std::shared_ptr<nlist_t> &a = GETV(this->value, std::shared_ptr<nlist_t>);
-            const std::shared_ptr<nlist_t> &b = GETV(value.value, std::shared_ptr<nlist_t>);
+            const nlist_t *a = GETV(this->value, nlist_t *);
+            const nlist_t *b = GETV(value.value, nlist_t *);
             // Do they match in length?
             if (a->size() != b->size()) return false;
             // Does it have elements?
@@ -100,8 +117,8 @@ bool Value::same_as(const Value &value) const
             break;
         }
         case VALUE_DICT: {
-            const std::shared_ptr<ndict_t> &a = GETV(this->value, std::shared_ptr<ndict_t>);
-            const std::shared_ptr<ndict_t> &b = GETV(value.value, std::shared_ptr<ndict_t>);
+            const ndict_t *a = GETV(this->value, ndict_t *);
+            const ndict_t *b = GETV(value.value, ndict_t *);
             // Do they match in length?
             if (a->values.size() != b->values.size()) return false;
             // Does it have elements?
@@ -111,15 +128,15 @@ bool Value::same_as(const Value &value) const
                 // Check if b have that key.
                 if (b->values.find(k) == b->values.end()) return false;
                 // Check if the value matches at that key.
-                if (!e.same_as(b->values[k])) return false;
+                if (!e.same_as(b->values.at(k))) return false;
             }
             // They are equal.
             break;
         }
-        case VALUE_FUN: { return GETV(this->value, std::shared_ptr<nfun_t>).get() == GETV(value.value, std::shared_ptr<nfun_t>).get(); }
+        case VALUE_FUN: { return GETV(this->value, nfun_t *) == GETV(value.value, nfun_t *); }
         case VALUE_OBJECT: {
-            const std::shared_ptr<nobject_t> &a = GETV(this->value, std::shared_ptr<nobject_t>);
-            const std::shared_ptr<nobject_t> &b = GETV(value.value, std::shared_ptr<nobject_t>);
+            const nobject_t *a = GETV(this->value, nobject_t *);
+            const nobject_t *b = GETV(value.value, nobject_t *);
             // Check the number of props.
             if (a->props.size() != b->props.size()) return false;
             // Are there any props at all?
@@ -144,13 +161,13 @@ bool Value::same_as(const Value &value) const
 std::string Value::to_string() const
 {
     std::string r;
-    switch (this->type.type) {
+    switch (this->type->type) {
         case VALUE_INT: { r = std::to_string(GETV(this->value, nint_t)); break; }
         case VALUE_FLOAT: { r = std::to_string(GETV(this->value, nfloat_t)); break; }
         case VALUE_BOOL: { r = GETV(this->value, nbool_t) ? "true" : "false"; break; }
         case VALUE_STRING: { r = GETV(this->value, nstring_t); break; }
         case VALUE_LIST: {
-            const std::shared_ptr<nlist_t> &list = GETV(this->value, std::shared_ptr<nlist_t>);
+            const nlist_t *list = GETV(this->value, nlist_t *);
             r += "[";
             if (list->size() > 0) {
                 for (const Value &el : *list) {
@@ -162,7 +179,7 @@ std::string Value::to_string() const
             break;
         }
         case VALUE_DICT: {
-            const std::shared_ptr<ndict_t> &dict = GETV(this->value, std::shared_ptr<ndict_t>);
+            const ndict_t *dict = GETV(this->value, ndict_t *);
             r += "{";
             if (dict->values.size() > 0) {
                 for (const auto &[key, value] : dict->values) {
@@ -175,15 +192,20 @@ std::string Value::to_string() const
         }
         case VALUE_FUN: {
             // const nfun_t &fun = GETV(this->value, nfun_t);
-            r += this->type.to_string();
+            r += this->type->to_string();
             break;
         }
         case VALUE_OBJECT: {
-            const std::shared_ptr<nobject_t> &object = GETV(this->value, std::shared_ptr<nobject_t>);
-            r += this->type.to_string() + "!{";
+            const nobject_t *object = GETV(this->value, nobject_t *);
+            r += this->type->to_string() + "!{";
             if (object) {
-                for (registers_size_t i = 0; i < object->props.size(); i++) {
-                    r += object->props[i] + ": " + (object->registers.get() + i)->to_string() + ", ";
+                // The props are laid out in declaration order, but they're printed in the order of
+                // a table of the member names (the order the props had before), so the output
+                // doesn't change with the layout.
+                std::unordered_map<std::string, registers_size_t> order;
+                for (registers_size_t i = 0; i < object->props.size(); i++) order[object->props[i]] = i;
+                for (const auto &[prop, i] : order) {
+                    r += prop + ": " + object->registers[i].to_string() + ", ";
                 }
                 if (object->props.size() > 0) { r.pop_back(); r.pop_back(); }
             } else {
@@ -208,7 +230,42 @@ void ValueDictionary::insert(const std::string &key, const Value &value)
     }
 }
 
+void ValueList::trace(Heap *heap) const
+{
+    for (const Value &el : *this) heap->mark(el);
+}
+
+size_t ValueList::footprint() const
+{
+    return sizeof(ValueList) + this->capacity() * sizeof(Value);
+}
+
+void ValueDictionary::trace(Heap *heap) const
+{
+    for (const auto &[key, value] : this->values) heap->mark(value);
+}
+
+size_t ValueDictionary::footprint() const
+{
+    return sizeof(ValueDictionary) + this->values.size() * (sizeof(std::string) * 2 + sizeof(Value));
+}
+
 ValueObject::ValueObject(const std::vector<std::string> &props) : props(props)
 {
-    this->registers = std::make_unique<Value[]>(props.size());
+    this->registers = heap->allocate_values(props.size());
+}
+
+ValueObject::~ValueObject()
+{
+    heap->free_values(this->registers, this->props.size());
+}
+
+void ValueObject::trace(Heap *heap) const
+{
+    for (size_t i = 0; i < this->props.size(); i++) heap->mark(this->registers[i]);
+}
+
+size_t ValueObject::footprint() const
+{
+    return sizeof(ValueObject) + this->props.size() * (sizeof(std::string) + sizeof(Value));
 }
@@ -23,12 +23,12 @@ class Lexer
     const char *start;
     // Stores the current char of the token being scanned.
     const char *current;
+    // Stores the end of the source (where the final '\0' is).
+    const char *end;
     // Stores the current line in the source file.
     line_t line;
     // Stores the current column in the source file.
     column_t column;
-    // Stores a list of reserved words for the identifiers.
-    static const std::unordered_map<std::string, TokenType> reserved_words;
     // Generates a token error.
     const std::string token_error() const;
     // Build the token and set the start char to the current one.
@@ -38,11 +38,11 @@ class Lexer
     TokenType is_string(bool simple);
     TokenType is_number();
     TokenType is_identifier();
-    // Reads a file and stores the contents in the current instance.
+    // Opens a file and stores the contents in the current instance.
     void read_from_file(const std::shared_ptr<const std::string> &file);
     public:
-        // Stores the source code of the file.
-        std::unique_ptr<std::string> source;
+        // Stores the source code of the file (the tokens point to it).
+        std::shared_ptr<const SourceFile> source;
         // Scans the source and stores the tokens.
         void scan(std::unique_ptr<std::vector<Token>> &tokens);
         // Initializes a lexer given a file name.
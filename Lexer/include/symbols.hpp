@@ -0,0 +1,59 @@
+/**
+ * |-------------------|
+ * | Nuua Symbol Table |
+ * |-------------------|
+ *
+ * Copyright 2019 Erik Campobadal <soc@erik.cat>
+ * https://nuua.io
+ */
+#ifndef SYMBOLS_HPP
+#define SYMBOLS_HPP
+
+#include <stdint.h>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+#include <functional>
+#include <mutex>
+#include <shared_mutex>
+
+// Represents the id of an interned identifier.
+typedef uint32_t symbol_t;
+
+// Defines the id that no identifier has.
+#define SYMBOL_NONE 0
+
+// Hash used to look up symbols without building a string.
+class SymbolHash
+{
+    public:
+        typedef void is_transparent;
+        size_t operator ()(std::string_view name) const { return std::hash<std::string_view>()(name); }
+};
+
+// The symbol table gives each identifier of the compilation a dense id
+// when it's scanned, so the later stages can compare and hash integers
+// instead of full names.
+class SymbolTable
+{
+    // Stores the id of each interned name.
+    std::unordered_map<std::string, symbol_t, SymbolHash, std::equal_to<>> ids;
+    // Stores the interned names (indexed by symbol id).
+    std::vector<const std::string *> names = { nullptr };
+    // Guards the table (the modules are scanned and the functions compiled concurrently).
+    // The lookups share it, so only the new names block the other threads.
+    mutable std::shared_mutex mutex;
+    public:
+        // Returns the id of the given name, interning it if needed.
+        symbol_t intern(std::string_view name);
+        // Returns the id of the given name or SYMBOL_NONE if it was never interned.
+        symbol_t find(std::string_view name) const;
+        // Returns the name of the given symbol.
+        const std::string &name(const symbol_t symbol) const;
+};
+
+// symbols will be a global class instance.
+extern SymbolTable *symbols;
+
+#endif
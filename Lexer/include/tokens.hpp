@@ -15,6 +15,7 @@
 #include <string>
 #include <stdint.h>
 #include "../../Logger/include/logger.hpp" // For the file_t line_t and column_t
+#include "symbols.hpp"
 
 typedef enum : uint8_t {
     TOKEN_NEW_LINE, // \n
@@ -80,6 +81,8 @@ class Token
         const uint32_t length;
         const line_t line;
         const column_t column;
+        // Stores the interned identifier (SYMBOL_NONE for other tokens).
+        const symbol_t symbol;
 
         static std::vector<std::string> token_names;
         static std::vector<std::string> type_names;
@@ -87,8 +90,8 @@ class Token
         // Contains the escaped chars of the language.
         static const std::unordered_map<char, char> escaped_chars;
 
-        Token(const TokenType type, const char *start, const uint32_t length, const line_t line, const column_t column)
-            : type(type), start(start), length(length), line(line), column(column) {}
+        Token(const TokenType type, const char *start, const uint32_t length, const line_t line, const column_t column, const symbol_t symbol = SYMBOL_NONE)
+            : type(type), start(start), length(length), line(line), column(column), symbol(symbol) {}
 
         void debug_token() const;
         std::string to_string() const;
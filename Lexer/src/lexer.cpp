@@ -9,7 +9,11 @@
 
 #include "../include/lexer.hpp"
 #include <string.h>
-#include <fstream>
+#include <array>
+#include <string_view>
+#if defined(__SSE2__)
+    #include <emmintrin.h>
+#endif
 
 #define ADD_TOKEN(token) (tokens->push_back(this->make_token(token)))
 #define TOK_LENGTH() ((int) (this->current - this->start))
@@ -18,12 +22,35 @@
 #define SKIP() NEXT(); this->start = this->current;
 #define PEEK() (*this->current)
 #define PEEK_ON(offset) (*(this->current + (offset)))
-#define IS_DIGIT(character) ((character) >= '0' && (character) <= '9')
-#define IS_ALPHA(character) (((character) >= 'a' && (character) <= 'z') || ((character) >= 'A' && (character) <= 'Z') || (character) == '_')
-#define IS_ALPHANUM(character) (IS_ALPHA(character) || IS_DIGIT(character))
+#define IS_DIGIT(character) (char_classes[static_cast<uint8_t>(character)] & CHAR_DIGIT)
+#define IS_ALPHA(character) (char_classes[static_cast<uint8_t>(character)] & CHAR_ALPHA)
+#define IS_ALPHANUM(character) (char_classes[static_cast<uint8_t>(character)] & (CHAR_DIGIT | CHAR_ALPHA))
 #define ADD_LOG(msg) logger->add_entity(this->file, this->line, this->column, msg);
 
-const std::unordered_map<std::string, TokenType> Lexer::reserved_words = {
+// Byte classes used by the scanner.
+#define CHAR_DIGIT 1
+#define CHAR_ALPHA 2
+
+// Classifies each byte with the CHAR_* flags.
+static constexpr std::array<uint8_t, 256> char_classes = [] {
+    std::array<uint8_t, 256> classes = {};
+    for (int c = '0'; c <= '9'; c++) classes[c] = CHAR_DIGIT;
+    for (int c = 'a'; c <= 'z'; c++) classes[c] = CHAR_ALPHA;
+    for (int c = 'A'; c <= 'Z'; c++) classes[c] = CHAR_ALPHA;
+    classes['_'] = CHAR_ALPHA;
+    return classes;
+}();
+
+// Represents a reserved word of the language.
+class Keyword
+{
+    public:
+        std::string_view name;
+        TokenType type;
+};
+
+// Stores the reserved words of the language.
+static constexpr Keyword keywords[] = {
     { "true", TOKEN_TRUE },
     { "false", TOKEN_FALSE },
     { "as", TOKEN_AS },
@@ -45,6 +72,133 @@ const std::unordered_map<std::string, TokenType> Lexer::reserved_words = {
     { "delete", TOKEN_DELETE }
 };
 
+// Defines the number of slots of the keyword hash table (power of two).
+#define KEYWORD_SLOTS 64
+// Defines the length limits of the reserved words.
+#define KEYWORD_MIN_LENGTH 2
+#define KEYWORD_MAX_LENGTH 6
+
+// Hashes a word given its first and last char and its length.
+static constexpr uint32_t keyword_hash(const char *word, const size_t length, const uint32_t seed)
+{
+    return (static_cast<uint8_t>(word[0]) * (seed >> 8) + static_cast<uint8_t>(word[length - 1]) * (seed & 0xFF) + length) & (KEYWORD_SLOTS - 1);
+}
+
+// Finds a seed that gives every reserved word its own slot.
+static constexpr uint32_t keyword_seed = [] {
+    for (uint32_t seed = 0x0101; seed <= 0xFFFF; seed++) {
+        bool used[KEYWORD_SLOTS] = {};
+        bool perfect = true;
+        for (const Keyword &keyword : keywords) {
+            uint32_t slot = keyword_hash(keyword.name.data(), keyword.name.length(), seed);
+            if (used[slot]) { perfect = false; break; }
+            used[slot] = true;
+        }
+        if (perfect) return seed;
+    }
+    return 0u;
+}();
+static_assert(keyword_seed != 0, "No perfect hash found for the reserved words.");
+
+// Stores the keyword index of each slot (-1 if empty).
+static constexpr std::array<int8_t, KEYWORD_SLOTS> keyword_slots = [] {
+    std::array<int8_t, KEYWORD_SLOTS> slots = {};
+    for (int8_t &slot : slots) slot = -1;
+    for (size_t i = 0; i < sizeof(keywords) / sizeof(Keyword); i++) {
+        slots[keyword_hash(keywords[i].name.data(), keywords[i].name.length(), keyword_seed)] = i;
+    }
+    return slots;
+}();
+
+// Returns the token type of the given word (TOKEN_IDENTIFIER if it's not reserved).
+static TokenType keyword(const char *word, const size_t length)
+{
+    if (length < KEYWORD_MIN_LENGTH || length > KEYWORD_MAX_LENGTH) return TOKEN_IDENTIFIER;
+    int8_t slot = keyword_slots[keyword_hash(word, length, keyword_seed)];
+    if (slot < 0 || keywords[slot].name != std::string_view(word, length)) return TOKEN_IDENTIFIER;
+    return keywords[slot].type;
+}
+
+#if defined(__SSE2__)
+// Returns a mask with the bytes of the chunk that are between low and high.
+static inline __m128i in_range(const __m128i chunk, const char low, const char high)
+{
+    return _mm_and_si128(_mm_cmpgt_epi8(chunk, _mm_set1_epi8(low - 1)), _mm_cmplt_epi8(chunk, _mm_set1_epi8(high + 1)));
+}
+
+// Returns the offset of the first byte not set in the mask (16 if all are set).
+static inline int first_unset(const __m128i mask)
+{
+    uint32_t bits = ~static_cast<uint32_t>(_mm_movemask_epi8(mask)) & 0xFFFF;
+    return bits ? __builtin_ctz(bits) : 16;
+}
+#endif
+
+// The following functions return the first char that is not part of the run
+// starting at current. The chunks are only scanned 16 bytes at a time while
+// they are fully inside the source. The source is always '\0' terminated.
+
+static const char *skip_spaces(const char *current, const char *end)
+{
+    #if defined(__SSE2__)
+        for (; current + 16 <= end; current += 16) {
+            __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i *>(current));
+            int offset = first_unset(_mm_cmpeq_epi8(chunk, _mm_set1_epi8(' ')));
+            if (offset < 16) return current + offset;
+        }
+    #endif
+    while (*current == ' ') current++;
+    return current;
+}
+
+static const char *skip_digits(const char *current, const char *end)
+{
+    #if defined(__SSE2__)
+        for (; current + 16 <= end; current += 16) {
+            __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i *>(current));
+            int offset = first_unset(in_range(chunk, '0', '9'));
+            if (offset < 16) return current + offset;
+        }
+    #endif
+    while (IS_DIGIT(*current)) current++;
+    return current;
+}
+
+static const char *skip_alphanumeric(const char *current, const char *end)
+{
+    #if defined(__SSE2__)
+        for (; current + 16 <= end; current += 16) {
+            __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i *>(current));
+            __m128i mask = _mm_or_si128(
+                _mm_or_si128(in_range(chunk, 'a', 'z'), in_range(chunk, 'A', 'Z')),
+                _mm_or_si128(in_range(chunk, '0', '9'), _mm_cmpeq_epi8(chunk, _mm_set1_epi8('_')))
+            );
+            int offset = first_unset(mask);
+            if (offset < 16) return current + offset;
+        }
+    #endif
+    while (IS_ALPHANUM(*current)) current++;
+    return current;
+}
+
+// Stops at the quote, a new line, a backslash or the end of the source.
+static const char *skip_string_chars(const char *current, const char *end, const char quote)
+{
+    #if defined(__SSE2__)
+        for (; current + 16 <= end; current += 16) {
+            __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i *>(current));
+            __m128i stop = _mm_or_si128(
+                _mm_or_si128(_mm_cmpeq_epi8(chunk, _mm_set1_epi8(quote)), _mm_cmpeq_epi8(chunk, _mm_set1_epi8('\n'))),
+                _mm_or_si128(_mm_cmpeq_epi8(chunk, _mm_set1_epi8('\\')), _mm_cmpeq_epi8(chunk, _mm_setzero_si128()))
+            );
+            uint32_t bits = static_cast<uint32_t>(_mm_movemask_epi8(stop));
+            if (bits) return current + __builtin_ctz(bits);
+        }
+    #endif
+    while (*current != quote && *current != '\n' && *current != '\\' && *current != '\0') current++;
+    return current;
+}
+
 const std::string Lexer::token_error() const
 {
     return std::string("Unexpected token '") + *this->start + "'";
@@ -66,7 +220,10 @@ Token Lexer::make_token(TokenType type)
 
     this->start = *this->current == ' ' ? this->current + 1 : this->current;
 
-    Token t = Token(type, start, length, this->line, this->column);
+    // Identifiers are interned as they are scanned.
+    symbol_t symbol = type == TOKEN_IDENTIFIER ? symbols->intern(std::string_view(start, length)) : SYMBOL_NONE;
+
+    Token t = Token(type, start, length, this->line, this->column, symbol);
 
     this->column += length_cpy;
 
@@ -87,7 +244,10 @@ TokenType Lexer::is_string(bool simple)
     std::shared_ptr<const std::string> f = this->file;
     line_t l = this->line;
     column_t c = this->column;
-    while (PEEK() != (simple ? '\'' : '"') && !IS_AT_END()) {
+    const char quote = simple ? '\'' : '"';
+    for (;;) {
+        this->current = skip_string_chars(this->current, this->end, quote);
+        if (PEEK() == quote || IS_AT_END()) break;
         if (PEEK() == '\n') this->line++;
         else if (PEEK() == '\\') { NEXT(); }
         NEXT();
@@ -105,11 +265,11 @@ TokenType Lexer::is_string(bool simple)
 
 TokenType Lexer::is_number()
 {
-    while (IS_DIGIT(PEEK())) NEXT();
+    this->current = skip_digits(this->current, this->end);
 
     if (PEEK() == '.' && IS_DIGIT(PEEK_ON(1))) {
         NEXT(); // The . itelf
-        while (IS_DIGIT(PEEK())) NEXT();
+        this->current = skip_digits(this->current, this->end);
         return TOKEN_FLOAT;
     }
 
@@ -118,47 +278,41 @@ TokenType Lexer::is_number()
 
 TokenType Lexer::is_identifier()
 {
-    while (IS_ALPHANUM(PEEK())) NEXT();
+    this->current = skip_alphanumeric(this->current, this->end);
 
-    std::string key;
-    for (int i = 0; i < TOK_LENGTH(); i++) key += *(this->start + i);
-
-    /*
-    printf(
-        "Word is: '%s' - Found: %d - Number: %d\n",
-        key.c_str(),
-        Lexer::reserved_words.find(key) != Lexer::reserved_words.end(),
-        (Lexer::reserved_words.find(key) != Lexer::reserved_words.end()) ? Lexer::reserved_words.at(key) : TOKEN_IDENTIFIER
-    );
-    */
-
-    return (Lexer::reserved_words.find(key) != Lexer::reserved_words.end()) ? Lexer::reserved_words.at(key) : TOKEN_IDENTIFIER;
+    return keyword(this->start, TOK_LENGTH());
 }
 
 void Lexer::read_from_file(const std::shared_ptr<const std::string> &file)
 {
-    std::ifstream file_stream = std::ifstream(file->c_str());
-    if (!file_stream.is_open()) {
+    this->source = std::make_shared<const SourceFile>(*file);
+    if (!this->source->is_open()) {
         ADD_LOG("Unable to open file '" + *file + "'");
         exit(logger->crash());
     }
-
-    *this->source = std::string((std::istreambuf_iterator<char>(file_stream)), (std::istreambuf_iterator<char>()));
+    // The logger keeps the source alive to display the errors.
+    logger->share_source(*file, this->source);
 }
 
 void Lexer::scan(std::unique_ptr<std::vector<Token>> &tokens)
 {
-    this->source = std::make_unique<std::string>();
     this->read_from_file(this->file);
 
-    this->start = this->source->c_str();
+    this->start = this->source->data;
+    this->end = this->source->data + this->source->length;
     this->current = this->start;
     this->line = 1;
     this->column = 1;
 
     while (!IS_AT_END()) {
         switch (char c = NEXT()) {
-            case ' ': { this->start = this->current; ++this->column; break; }
+            case ' ': {
+                // Skip the whole run of spaces at once.
+                const char *run = skip_spaces(this->current, this->end);
+                this->column += run - this->current + 1;
+                this->start = this->current = run;
+                break;
+            }
             case '\r': { break; }
             case '\t': { ++this->column; break; }
             case '\n': {
@@ -249,3 +403,8 @@ Lexer::Lexer(const std::shared_ptr<const std::string> &file)
 #undef IS_ALPHA
 #undef IS_ALPHANUM
 #undef ADD_LOG
+#undef CHAR_DIGIT
+#undef CHAR_ALPHA
+#undef KEYWORD_SLOTS
+#undef KEYWORD_MIN_LENGTH
+#undef KEYWORD_MAX_LENGTH
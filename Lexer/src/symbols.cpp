@@ -0,0 +1,38 @@
+/**
+ * |-------------------|
+ * | Nuua Symbol Table |
+ * |-------------------|
+ *
+ * Copyright 2019 Erik Campobadal <soc@erik.cat>
+ * https://nuua.io
+ */
+#include "../include/symbols.hpp"
+
+SymbolTable *symbols = new SymbolTable;
+
+symbol_t SymbolTable::intern(std::string_view name)
+{
+    // Most names are already interned.
+    if (const symbol_t symbol = this->find(name); symbol != SYMBOL_NONE) return symbol;
+    std::unique_lock<std::shared_mutex> lock(this->mutex);
+    // Another thread may have interned it meanwhile.
+    auto symbol = this->ids.find(name);
+    if (symbol != this->ids.end()) return symbol->second;
+    // The map nodes are stable, so the key can be used as the name.
+    auto inserted = this->ids.emplace(std::string(name), this->names.size()).first;
+    this->names.push_back(&inserted->first);
+    return inserted->second;
+}
+
+symbol_t SymbolTable::find(std::string_view name) const
+{
+    std::shared_lock<std::shared_mutex> lock(this->mutex);
+    auto symbol = this->ids.find(name);
+    return symbol == this->ids.end() ? SYMBOL_NONE : symbol->second;
+}
+
+const std::string &SymbolTable::name(const symbol_t symbol) const
+{
+    std::shared_lock<std::shared_mutex> lock(this->mutex);
+    return *this->names[symbol];
+}
@@ -9,10 +9,13 @@
 #ifndef LOGGER_HPP
 #define LOGGER_HPP
 
+#include "source.hpp"
 #include <string>
 #include <vector>
 #include <memory>
 #include <utility>
+#include <unordered_map>
+#include <mutex>
 
 // Defines a max line length when printing file lengths.
 #define MAX_LINE_LENGTH 500
@@ -21,6 +24,7 @@
 
 typedef uint32_t line_t;
 typedef uint16_t column_t;
+typedef uint32_t file_t;
 
 // Represents a log entity.
 class LoggerEntity {
@@ -37,11 +41,29 @@ class LoggerEntity {
             : file(file), line(line), column(column), msg(msg) {}
 };
 
+// Represents a crash of a thread that defers its crashes (see Logger::defer_crashes).
+class LoggerCrash
+{
+    public:
+        // Stores the entity stack of the thread that crashed.
+        std::vector<LoggerEntity> entities;
+};
+
 // Represents the logger used in the whole toolchain.
 class Logger
 {
-    // Stores all the log entities.
-    std::vector<LoggerEntity> entities;
+    // Stores all the log entities. Each thread has its own entity stack
+    // since the modules are parsed concurrently.
+    static thread_local std::vector<LoggerEntity> entities;
+    // Determines if the crashes of the current thread are thrown as a LoggerCrash.
+    static thread_local bool deferred;
+    // Stores the interned source files, the rest of the toolchain refers
+    // to them using their index. The index 0 is reserved for no file.
+    std::vector<std::shared_ptr<const std::string>> files = { std::shared_ptr<const std::string>() };
+    // Stores the source files shared by the lexer (by file name).
+    std::unordered_map<std::string, std::shared_ptr<const SourceFile>> sources;
+    // Guards the files, the sources and the crash report.
+    mutable std::mutex mutex;
     // Displays a specific log entity.
     void display_log(const uint16_t index, const bool red) const;
     public:
@@ -51,15 +73,38 @@ class Logger
         bool show_tokens = false;
         bool show_ast = false;
         bool show_opcodes = false;
+        bool show_ir = false;
         bool show_references = false;
         bool linear_scan = false;
+        bool inline_functions = true;
         bool tld_blocks = false;
+        bool gc_stats = false;
+        bool memoize = false;
+        bool memo_stats = false;
+        bool use_cache = true;
+        double gc_growth = 2.0;
+        // Interns a file and returns its index.
+        file_t intern_file(const std::shared_ptr<const std::string> &file);
+        // Returns the file of the given index.
+        std::shared_ptr<const std::string> file(const file_t file) const;
+        // Returns the number of interned files (including the reserved one).
+        file_t file_count() const;
+        // Shares the contents of a source file so the errors can display
+        // its lines without opening the file again.
+        void share_source(const std::string &file, const std::shared_ptr<const SourceFile> &source);
         // Adds a new entity to the entity stack.
         void add_entity(const std::shared_ptr<const std::string> &file, const line_t line, const column_t column, const std::string &msg);
+        void add_entity(const file_t file, const line_t line, const column_t column, const std::string &msg);
         // Pops an entity from the entity stack.
         void pop_entity();
+        // Makes the crashes of the current thread throw its entity stack as a LoggerCrash
+        // instead of exiting, so the main thread reports them. Used by the worker threads.
+        void defer_crashes(const bool defer = true);
         // Crashes the program by emmiting the whole entity stack as an error.
         int crash() const;
+        // Crashes the program with the entity stack of a crash of another thread
+        // on top of the current one.
+        int crash(const LoggerCrash &crash);
 };
 
 // logger will be a global class instance.
@@ -0,0 +1,46 @@
+/**
+ * |------------------|
+ * | Nuua Source File |
+ * |------------------|
+ *
+ * Copyright 2019 Erik Campobadal <soc@erik.cat>
+ * https://nuua.io
+ */
+#ifndef SOURCE_HPP
+#define SOURCE_HPP
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+
+// Returns the 64 bit FNV-1a hash of the given bytes.
+uint64_t hash_bytes(const char *data, const size_t length, uint64_t hash = 14695981039346656037ull);
+
+// Represents the contents of a source file. The file is memory mapped when
+// possible so the tokens can point to it directly. The contents are always
+// followed by a '\0' so the lexer can use it as the end mark.
+class SourceFile
+{
+    // Stores the size of the memory mapping (0 if the contents are in a heap buffer).
+    size_t mapping_size = 0;
+    // Maps the file into memory. Returns false if it can't be mapped.
+    bool map(const int descriptor);
+    // Reads the whole file into a heap buffer.
+    bool read(const std::string &path);
+    public:
+        // Stores the contents of the file (nullptr if it could not be opened).
+        const char *data = nullptr;
+        // Stores the length of the contents (without the final '\0').
+        size_t length = 0;
+        // Opens the given file.
+        SourceFile(const std::string &path);
+        SourceFile(const SourceFile &) = delete;
+        SourceFile &operator =(const SourceFile &) = delete;
+        ~SourceFile();
+        // Determines if the file was opened.
+        bool is_open() const { return this->data != nullptr; }
+        // Returns the hash of the contents.
+        uint64_t hash() const { return hash_bytes(this->data, this->length); }
+};
+
+#endif
@@ -17,6 +17,9 @@
 
 Logger *logger = new Logger;
 
+thread_local std::vector<LoggerEntity> Logger::entities;
+thread_local bool Logger::deferred = false;
+
 static int red_printf(const char *format, ...)
 {
     va_list arg;
@@ -43,6 +46,17 @@ static int red_printf(const char *format, ...)
     return result;
 }
 
+static void print_line(const char *buffer, const column_t column)
+{
+    // Trim the initial spaces / tabs.
+    uint16_t offset = 0;
+    while (buffer[offset] == '\t' || buffer[offset] == ' ') offset++;
+    printf("\n%*c%s%*c", 3, ' ', buffer + offset, 3, ' ');
+    for (column_t i = 1; i < column - offset; i++) printf(" ");
+    fflush(stdout);
+    printf("^\n");
+}
+
 static void print_file_line(const char *file, const line_t line, const column_t column)
 {
     FILE *source_file = fopen(file, "r");
@@ -63,13 +77,28 @@ static void print_file_line(const char *file, const line_t line, const column_t
         }
     }
     fclose(source_file);
-    // Trim the initial spaces / tabs.
-    uint16_t offset = 0;
-    while (buffer[offset] == '\t' || buffer[offset] == ' ') offset++;
-    printf("\n%*c%s%*c", 3, ' ', buffer + offset, 3, ' ');
-    for (column_t i = 1; i < column - offset; i++) printf(" ");
-    fflush(stdout);
-    printf("^\n");
+    print_line(buffer, column);
+}
+
+static void print_source_line(const SourceFile *source, const line_t line, const column_t column)
+{
+    const char *start = source->data, *end = source->data + source->length;
+    for (line_t current_line = 1; current_line < line; current_line++) {
+        start = static_cast<const char *>(memchr(start, '\n', end - start));
+        if (!start) {
+            printf("\n%*c<unknown>\n", 3, ' ');
+            exit(EXIT_FAILURE);
+        }
+        start++;
+    }
+    // Copy the line (with its '\n') the same way it would be read from the file.
+    char buffer[MAX_LINE_LENGTH];
+    size_t length = 0;
+    while (start + length < end && length < MAX_LINE_LENGTH - 2 && start[length] != '\n') length++;
+    memcpy(buffer, start, length);
+    buffer[length] = '\n';
+    buffer[length + 1] = '\0';
+    print_line(buffer, column);
 }
 
 static void print_msg(const std::string &msg, bool red)
@@ -95,13 +124,58 @@ void Logger::add_entity(const std::shared_ptr<const std::string> &file, const li
     this->entities.push_back({ file, line, column, msg });
 }
 
+void Logger::add_entity(const file_t file, const line_t line, const column_t column, const std::string &msg)
+{
+    this->entities.push_back({ this->file(file), line, column, msg });
+}
+
+void Logger::share_source(const std::string &file, const std::shared_ptr<const SourceFile> &source)
+{
+    std::lock_guard<std::mutex> lock(this->mutex);
+    this->sources[file] = source;
+}
+
+file_t Logger::intern_file(const std::shared_ptr<const std::string> &file)
+{
+    std::lock_guard<std::mutex> lock(this->mutex);
+    for (file_t i = 1; i < this->files.size(); i++) {
+        if (this->files[i] == file || *this->files[i] == *file) return i;
+    }
+    this->files.push_back(file);
+    return this->files.size() - 1;
+}
+
+std::shared_ptr<const std::string> Logger::file(const file_t file) const
+{
+    std::lock_guard<std::mutex> lock(this->mutex);
+    return this->files[file];
+}
+
+file_t Logger::file_count() const
+{
+    std::lock_guard<std::mutex> lock(this->mutex);
+    return this->files.size();
+}
+
 void Logger::pop_entity()
 {
     this->entities.pop_back();
 }
 
+void Logger::defer_crashes(const bool defer)
+{
+    this->deferred = defer;
+}
+
 int Logger::crash() const
 {
+    if (this->deferred) {
+        LoggerCrash crash = { std::move(this->entities) };
+        this->entities.clear();
+        throw crash;
+    }
+    // The report is not mixed with the one of another thread.
+    std::lock_guard<std::mutex> lock(this->mutex);
     if (this->entities.size() == 0) {
         // Show a generic error since no entities exists.
         red_printf("There was an error\n");
@@ -119,6 +193,12 @@ int Logger::crash() const
     return EXIT_FAILURE;
 }
 
+int Logger::crash(const LoggerCrash &crash)
+{
+    for (const LoggerEntity &entity : crash.entities) this->entities.push_back(entity);
+    return this->crash();
+}
+
 void Logger::display_log(const uint16_t index, const bool red) const
 {
     if (this->entities[index].file) {
@@ -131,11 +211,17 @@ void Logger::display_log(const uint16_t index, const bool red) const
     } else printf("\n");
     print_msg(this->entities[index].msg, red);
     if (this->entities[index].line != 0 && this->entities[index].column != 0) {
-        print_file_line(
-            this->entities[index].file->c_str(),
-            this->entities[index].line,
-            this->entities[index].column
-        );
+        // Use the shared source if the lexer shared it.
+        auto source = this->sources.find(*this->entities[index].file);
+        if (source != this->sources.end()) {
+            print_source_line(source->second.get(), this->entities[index].line, this->entities[index].column);
+        } else {
+            print_file_line(
+                this->entities[index].file->c_str(),
+                this->entities[index].line,
+                this->entities[index].column
+            );
+        }
         printf("\n");
     }
 }
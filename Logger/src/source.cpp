@@ -0,0 +1,93 @@
+/**
+ * |------------------|
+ * | Nuua Source File |
+ * |------------------|
+ *
+ * Copyright 2019 Erik Campobadal <soc@erik.cat>
+ * https://nuua.io
+ */
+#include "../include/source.hpp"
+#include <stdio.h>
+#include <stdlib.h>
+#if !defined(_WIN32) && !defined(_WIN64)
+    #include <fcntl.h>
+    #include <sys/mman.h>
+    #include <sys/stat.h>
+    #include <unistd.h>
+#endif
+
+uint64_t hash_bytes(const char *data, const size_t length, uint64_t hash)
+{
+    for (size_t i = 0; i < length; i++) {
+        hash ^= static_cast<uint8_t>(data[i]);
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
+
+SourceFile::SourceFile(const std::string &path)
+{
+    #if !defined(_WIN32) && !defined(_WIN64)
+        int descriptor = open(path.c_str(), O_RDONLY);
+        if (descriptor < 0) return;
+        bool mapped = this->map(descriptor);
+        close(descriptor);
+        if (mapped) return;
+    #endif
+    this->read(path);
+}
+
+bool SourceFile::map(const int descriptor)
+{
+    #if defined(_WIN32) || defined(_WIN64)
+        return false;
+    #else
+        struct stat info;
+        // Pipes, devices and empty files are read instead.
+        if (fstat(descriptor, &info) != 0 || !S_ISREG(info.st_mode) || info.st_size == 0) return false;
+        size_t size = static_cast<size_t>(info.st_size);
+        size_t page = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+        // The rest of the final page is filled with zeros, so that gives the '\0'.
+        // When the file fills the final page an extra zero page is reserved after it.
+        size_t mapping = size % page == 0 ? size + page : size;
+        char *data = static_cast<char *>(mmap(nullptr, mapping, PROT_READ, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0));
+        if (data == MAP_FAILED) return false;
+        if (mmap(data, size, PROT_READ, MAP_PRIVATE | MAP_FIXED, descriptor, 0) == MAP_FAILED) {
+            munmap(data, mapping);
+            return false;
+        }
+        this->data = data;
+        this->length = size;
+        this->mapping_size = mapping;
+        return true;
+    #endif
+}
+
+bool SourceFile::read(const std::string &path)
+{
+    FILE *file = fopen(path.c_str(), "rb");
+    if (!file) return false;
+    size_t capacity = 4096, size = 0;
+    char *buffer = static_cast<char *>(malloc(capacity));
+    for (size_t n; (n = fread(buffer + size, 1, capacity - size - 1, file)) > 0;) {
+        size += n;
+        if (capacity - size == 1) buffer = static_cast<char *>(realloc(buffer, capacity *= 2));
+    }
+    fclose(file);
+    buffer[size] = '\0';
+    this->data = buffer;
+    this->length = size;
+    return true;
+}
+
+SourceFile::~SourceFile()
+{
+    if (!this->data) return;
+    #if !defined(_WIN32) && !defined(_WIN64)
+        if (this->mapping_size > 0) {
+            munmap(const_cast<char *>(this->data), this->mapping_size);
+            return;
+        }
+    #endif
+    free(const_cast<char *>(this->data));
+}
@@ -0,0 +1,67 @@
+/**
+ * |-----------------|
+ * | Nuua Node Arena |
+ * |-----------------|
+ *
+ * Copyright 2019 Erik Campobadal <soc@erik.cat>
+ * https://nuua.io
+ */
+#ifndef ARENA_HPP
+#define ARENA_HPP
+
+#include <stddef.h>
+#include <vector>
+
+// Defines the size of each arena block.
+#define ARENA_BLOCK_SIZE (64 * 1024)
+
+// Stores the AST nodes of a module contiguously, in the order they are parsed.
+// Nodes are never freed one by one. The whole arena is freed once the parser
+// released it and every node allocated in it is gone.
+class NodeArena
+{
+    // Stores the allocated blocks.
+    std::vector<char *> blocks;
+    // Stores the next free byte of the current block.
+    char *current = nullptr;
+    // Stores the end of the current block.
+    char *end = nullptr;
+    // Stores the number of live allocations.
+    size_t allocations = 0;
+    // Determines if the parser released the arena.
+    bool released = false;
+    ~NodeArena();
+    public:
+        // Allocates a new block of memory.
+        void *allocate(size_t size, size_t alignment);
+        // Notifies that an allocation is no longer used.
+        void deallocate();
+        // Releases the arena from the parser. It will be freed
+        // as soon as there are no live allocations.
+        void release();
+};
+
+// Standard allocator that uses a node arena (used with std::allocate_shared).
+template <typename T>
+class NodeAllocator
+{
+    template <typename U>
+    friend class NodeAllocator;
+    // Stores the arena used.
+    NodeArena *arena;
+    public:
+        typedef T value_type;
+        NodeAllocator(NodeArena *arena)
+            : arena(arena) {}
+        template <typename U>
+        NodeAllocator(const NodeAllocator<U> &allocator)
+            : arena(allocator.arena) {}
+        T *allocate(size_t count) { return static_cast<T *>(this->arena->allocate(count * sizeof(T), alignof(T))); }
+        void deallocate(T *, size_t) { this->arena->deallocate(); }
+        template <typename U>
+        bool operator ==(const NodeAllocator<U> &allocator) const { return this->arena == allocator.arena; }
+        template <typename U>
+        bool operator !=(const NodeAllocator<U> &allocator) const { return this->arena != allocator.arena; }
+};
+
+#endif
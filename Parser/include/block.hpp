@@ -5,6 +5,7 @@
 #include <vector>
 #include <utility>
 #include <memory>
+#include "../../Lexer/include/symbols.hpp"
 
 typedef uint32_t reg_t;
 
@@ -62,15 +63,17 @@ class BlockClassType
 class Block
 {
     public:
-        // Stores the variable name and the type of it.
-        std::unordered_map<std::string, BlockVariableType> variables;
+        // Stores the variable symbol and the type of it.
+        std::unordered_map<symbol_t, BlockVariableType> variables;
         // Stores the custom types of the block.
         std::unordered_map<std::string, BlockClassType> classes;
         // Gets a variable from the current block or returns nullptr.
+        BlockVariableType *get_variable(const symbol_t symbol);
         BlockVariableType *get_variable(const std::string &name);
         // Gets a class from the current block or returns nullptr.
         BlockClassType *get_class(const std::string &name);
         // Sets a variable.
+        void set_variable(const symbol_t symbol, const BlockVariableType &var);
         void set_variable(const std::string &name, const BlockVariableType &var);
         // Sets a class.
         void set_class(const std::string &name, const BlockClassType &c);
@@ -86,7 +89,7 @@ class Block
         void debug() const;
         // Helper to get a single variable out of a list of blocks.
         // It iterates through it starting from the end till the front.
-        static BlockVariableType *get_single_variable(const std::string &name, const std::vector<std::shared_ptr<Block>> *blocks);
+        static BlockVariableType *get_single_variable(const symbol_t symbol, const std::vector<std::shared_ptr<Block>> *blocks);
 };
 
 #endif
@@ -0,0 +1,80 @@
+/**
+ * |--------------------|
+ * | Nuua Module Loader |
+ * |--------------------|
+ *
+ * Copyright 2019 Erik Campobadal <soc@erik.cat>
+ * https://nuua.io
+ */
+#ifndef LOADER_HPP
+#define LOADER_HPP
+
+#include "rules.hpp"
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <future>
+#include <mutex>
+#include <thread>
+
+// Represents the code of a parsed module.
+typedef std::shared_ptr<std::vector<std::shared_ptr<Statement>>> module_code_t;
+
+// Represents a module requested to the loader.
+class LoadedModule
+{
+    public:
+        // Stores the long lived file name of the module.
+        std::shared_ptr<const std::string> file;
+        // Stores the code of the module once it's parsed.
+        std::shared_future<module_code_t> code;
+};
+
+// The module loader lexes and parses the imported modules on a pool of
+// worker threads. Each module is parsed once, as soon as the first 'use'
+// of it is parsed, so the whole import graph is parsed concurrently.
+class ModuleLoader
+{
+    // Represents a module waiting to be parsed.
+    class Job
+    {
+        public:
+            std::shared_ptr<const std::string> file;
+            std::promise<module_code_t> code;
+    };
+    // Stores the requested modules (by file name).
+    std::unordered_map<std::string, LoadedModule> modules;
+    // Stores the modules waiting to be parsed.
+    std::deque<Job> jobs;
+    // Stores the worker threads.
+    std::vector<std::thread> workers;
+    // Stores the number of modules being parsed.
+    size_t busy = 0;
+    // Determines if the workers must not start new jobs.
+    bool stopped = false;
+    // Guards the modules, the jobs and the worker state.
+    std::mutex mutex;
+    // Notifies the workers that there are new jobs.
+    std::condition_variable available;
+    // Notifies that a worker finished its job.
+    std::condition_variable finished;
+    // Parses the modules of the job queue.
+    void work();
+    public:
+        // Called with the source hash of each parsed module (from any thread). It returns the
+        // interface hashes of the modules used by its precompiled object (by module file) or
+        // nullptr if there's no up to date one. Precompiled modules skip their function bodies.
+        std::function<const std::unordered_map<std::string, uint64_t> *(const std::string &, const uint64_t)> precompiled;
+        // Returns the given module, scheduling its parsing if it was not requested yet.
+        LoadedModule load(const std::string &file);
+        // Waits until the given module is parsed and returns its code. The errors of
+        // the module are reported from here, so only the calling thread exits.
+        module_code_t get(const std::shared_future<module_code_t> &code);
+        // Stops the workers once their current job is finished and waits for them.
+        void stop();
+};
+
+// loader will be a global class instance.
+extern ModuleLoader *loader;
+
+#endif
@@ -12,13 +12,29 @@
 #include "../../Lexer/include/tokens.hpp"
 #include "type.hpp"
 #include "rules.hpp"
+#include "arena.hpp"
 
 class Parser
 {
     // Stores the current parsing file.
     std::shared_ptr<const std::string> file;
+    // Stores the interned index of the current parsing file.
+    file_t file_id = 0;
+    // Stores the arena where the module nodes are allocated.
+    NodeArena *arena = new NodeArena;
     // Stores a pointer to the current token beeing parsed.
     Token *current = nullptr;
+    // Stores the interface hashes of the dependencies recorded by the precompiled
+    // module (by module file). Function bodies are skipped while it's set.
+    const std::unordered_map<std::string, uint64_t> *dependencies = nullptr;
+    // Determines if the precompiled module can't be used with this source.
+    bool outdated = false;
+    // Stores the source the tokens point to.
+    std::shared_ptr<const SourceFile> source;
+    // Stores the type parameters of the generic function beeing parsed.
+    const std::vector<std::string> *type_parameters = nullptr;
+    // Stores the types of the type parameters while an instance of a generic function is parsed.
+    const std::unordered_map<std::string, std::shared_ptr<Type>> *type_arguments = nullptr;
     // Consumes a token and returns it for futher use.
     Token *consume(const TokenType type, const std::string &message);
     // Returns true if the token type matches the current token.
@@ -41,6 +57,8 @@ class Parser
     std::shared_ptr<Expression> expression();
     // Statements
     std::shared_ptr<Statement> fun_declaration();
+    // Parses the rest of a function declaration (a generic one also keeps its tokens to parse its instances).
+    std::shared_ptr<Statement> fun_declaration(Token *start, const std::string &name, const bool generic);
     std::shared_ptr<Statement> use_declaration();
     std::shared_ptr<Statement> export_declaration();
     std::shared_ptr<Statement> variable_declaration();
@@ -61,6 +79,7 @@ class Parser
     std::vector<std::shared_ptr<Expression>> arguments();
     std::vector<std::shared_ptr<Statement>> body();
     std::vector<std::shared_ptr<Statement>> class_body();
+    void skip_body();
     std::shared_ptr<Type> type(bool optional = true);
     public:
         // Debugging functions
@@ -73,13 +92,20 @@ class Parser
         static void debug_ast(const std::vector<std::shared_ptr<Statement>> &statements, const uint16_t spacer = 0);
         // Helper to format a path.
         static void format_path(std::string &path, const std::shared_ptr<const std::string> &parent = std::shared_ptr<const std::string>());
-        // Parses a given source code and returns the code.
-        void parse(std::shared_ptr<std::vector<std::shared_ptr<Statement>>> &code);
+        // Parses a given source code and returns the code. Precompiled modules
+        // are parsed without their function bodies unless it's disabled.
+        void parse(std::shared_ptr<std::vector<std::shared_ptr<Statement>>> &code, const bool allow_precompiled = true);
+        // Parses an instance of a generic function given the types of its type parameters.
+        std::shared_ptr<FunctionValue> instantiate(const GenericFunction &generic, const std::unordered_map<std::string, std::shared_ptr<Type>> &types);
         // Creates a new parser and formats the path.
         Parser(const char *file);
         // Creates a new parser with a given formatted and initialized path.
         Parser(std::shared_ptr<const std::string> &file)
-            : file(file) {}
+            : file(file), file_id(logger->intern_file(file)) {}
+        // The parser owns the arena, so it can't be copied.
+        Parser(const Parser &) = delete;
+        // Releases the arena (it lives until all its nodes are freed).
+        ~Parser() { this->arena->release(); }
 };
 
 #endif
@@ -11,12 +11,14 @@
 
 #include "../../Lexer/include/tokens.hpp"
 #include "block.hpp"
+#include "../../Logger/include/source.hpp"
 // #include "type.hpp"
 #include <string>
 #include <vector>
 #include <unordered_map>
+#include <future>
 
-#define NODE_PROPS std::shared_ptr<const std::string> &file, const line_t line, const column_t column
+#define NODE_PROPS const file_t file, const line_t line, const column_t column
 
 // Forward declaration
 class Type;
@@ -170,10 +172,10 @@ class Node
 {
     public:
         const Rule rule;
-        std::shared_ptr<const std::string> file;
+        file_t file; // Interned file index (see Logger::files).
         line_t line;
         column_t column;
-        Node(const Rule r, const std::shared_ptr<const std::string> &f, const line_t l, const column_t c)
+        Node(const Rule r, const file_t f, const line_t l, const column_t c)
             : rule(r), file(f), line(l), column(c) {};
         // ~Node() { printf("Node destroyed: %s:%llu:%llu\n", file->c_str(), line, column); }
 };
@@ -181,6 +183,8 @@ class Node
 class Expression : public Node
 {
     public:
+        // Stores the type of the expression once it's been inferred.
+        std::shared_ptr<Type> resolved_type;
         explicit Expression(const Node &node)
             : Node(node) {};
 };
@@ -188,6 +192,8 @@ class Expression : public Node
 class Statement : public Node
 {
     public:
+        // Determines if the statement is never executed (set by the optimizer).
+        bool dead = false;
         explicit Statement(const Node &node)
             : Node(node) {};
 };
@@ -277,8 +283,9 @@ class Variable : public Expression
 {
     public:
         std::string name;
-        Variable(NODE_PROPS, const std::string &n)
-            : Expression({ RULE_VARIABLE, file, line, column }), name(n) {};
+        symbol_t symbol;
+        Variable(NODE_PROPS, const std::string &n, const symbol_t s)
+            : Expression({ RULE_VARIABLE, file, line, column }), name(n), symbol(s) {};
 };
 
 class Assign : public Expression
@@ -369,6 +376,21 @@ class Range : public Expression
 
 // Forward declare
 class Declaration;
+class FunctionValue;
+
+// Stores what's needed to parse a generic function again with the types of each
+// instance. Its body is checked once, but it's only compiled for the instances.
+class GenericFunction
+{
+    public:
+        // Stores the type parameters.
+        std::vector<std::string> parameters;
+        // Stores the tokens of the declaration (from its name to an EOF token) and the source they point to.
+        std::vector<Token> tokens;
+        std::shared_ptr<const SourceFile> source;
+        // Stores the instances (by name).
+        std::unordered_map<std::string, std::shared_ptr<FunctionValue>> instances;
+};
 
 class FunctionValue : public Expression
 {
@@ -378,6 +400,10 @@ class FunctionValue : public Expression
         std::shared_ptr<Type> return_type;
         std::vector<std::shared_ptr<Statement>> body;
         std::shared_ptr<Block> block;
+        bool precompiled = false; // The body was skipped since the module is precompiled.
+        bool memoize = false; // The results are cached by the virtual machine (used by the optimizer and compiler).
+        std::shared_ptr<GenericFunction> generic; // Set if it's a generic function (only its instances are compiled).
+        bool instance = false; // It's an instance of a generic function (used by the analyzer and compiler).
         FunctionValue(NODE_PROPS, const std::string &n, const std::vector<std::shared_ptr<Declaration>> &p, const std::shared_ptr<Type> &rt, const std::vector<std::shared_ptr<Statement>> &b)
             : Expression({ RULE_FUNCTION, file, line, column }), name(n), parameters(p), return_type(std::move(rt)), body(b) {}
 };
@@ -400,9 +426,10 @@ class Property : public Expression
     public:
         std::shared_ptr<Expression> object;
         std::string name;
+        symbol_t symbol;
         std::shared_ptr<Class> c; // Used by the analyzer and compiler.
-        Property(NODE_PROPS, const std::shared_ptr<Expression> &o, const std::string &n)
-            : Expression({ RULE_PROPERTY, file, line, column }), object(o), name(n) {}
+        Property(NODE_PROPS, const std::shared_ptr<Expression> &o, const std::string &n, const symbol_t s)
+            : Expression({ RULE_PROPERTY, file, line, column }), object(o), name(n), symbol(s) {}
 };
 
 /* Statements */
@@ -488,9 +515,13 @@ class Use : public Statement
         std::vector<std::string> targets;
         std::shared_ptr<const std::string> module;
         std::shared_ptr<std::vector<std::shared_ptr<Statement>>> code;
+        std::shared_future<std::shared_ptr<std::vector<std::shared_ptr<Statement>>>> parsed; // Set by the module loader.
         std::shared_ptr<Block> block;
+        uint64_t interface = 0; // Interface hash of the module (expected by a precompiled module until analyzed).
         Use(NODE_PROPS, const std::vector<std::string> &t, const std::shared_ptr<const std::string> &m)
             : Statement({ RULE_USE, file, line, column }), targets(t), module(std::move(m)) {};
+        // Waits until the module is parsed and returns its code.
+        const std::shared_ptr<std::vector<std::shared_ptr<Statement>>> &wait();
 };
 
 class Export : public Statement
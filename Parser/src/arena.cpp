@@ -0,0 +1,43 @@
+/**
+ * |-----------------|
+ * | Nuua Node Arena |
+ * |-----------------|
+ *
+ * Copyright 2019 Erik Campobadal <soc@erik.cat>
+ * https://nuua.io
+ */
+#include "../include/arena.hpp"
+#include <stdint.h>
+
+void *NodeArena::allocate(size_t size, size_t alignment)
+{
+    // Align the current position.
+    char *block = reinterpret_cast<char *>((reinterpret_cast<uintptr_t>(this->current) + alignment - 1) & ~(alignment - 1));
+    if (!this->current || block + size > this->end) {
+        // Get a new block (bigger if the allocation doesn't fit on a default one).
+        size_t block_size = size + alignment > ARENA_BLOCK_SIZE ? size + alignment : ARENA_BLOCK_SIZE;
+        this->blocks.push_back(new char[block_size]);
+        this->current = this->blocks.back();
+        this->end = this->current + block_size;
+        block = reinterpret_cast<char *>((reinterpret_cast<uintptr_t>(this->current) + alignment - 1) & ~(alignment - 1));
+    }
+    this->current = block + size;
+    this->allocations++;
+    return block;
+}
+
+void NodeArena::deallocate()
+{
+    if (--this->allocations == 0 && this->released) delete this;
+}
+
+void NodeArena::release()
+{
+    this->released = true;
+    if (this->allocations == 0) delete this;
+}
+
+NodeArena::~NodeArena()
+{
+    for (char *block : this->blocks) delete[] block;
+}
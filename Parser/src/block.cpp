@@ -1,16 +1,27 @@
 #include "../include/block.hpp"
 #include "../include/type.hpp"
 
+BlockVariableType *Block::get_variable(const symbol_t symbol)
+{
+    auto var = this->variables.find(symbol);
+    return var == this->variables.end() ? nullptr : &var->second;
+}
+
 BlockVariableType *Block::get_variable(const std::string &name)
 {
-    return this->variables.find(name) == this->variables.end()
-        ? nullptr
-        : &this->variables.at(name);
+    // A name that was never interned can't be in any block.
+    symbol_t symbol = symbols->find(name);
+    return symbol == SYMBOL_NONE ? nullptr : this->get_variable(symbol);
+}
+
+void Block::set_variable(const symbol_t symbol, const BlockVariableType &var)
+{
+    this->variables[symbol] = std::move(var);
 }
 
 void Block::set_variable(const std::string &name, const BlockVariableType &var)
 {
-    this->variables[name] = std::move(var);
+    this->set_variable(symbols->intern(name), var);
 }
 
 bool Block::is_exported(const std::string &name)
@@ -27,10 +38,10 @@ bool Block::has(const std::string &name)
     return static_cast<bool>(this->get_variable(name));
 }
 
-BlockVariableType *Block::get_single_variable(const std::string &name, const std::vector<std::shared_ptr<Block>> *blocks)
+BlockVariableType *Block::get_single_variable(const symbol_t symbol, const std::vector<std::shared_ptr<Block>> *blocks)
 {
     for (size_t i = blocks->size() - 1;; i--) {
-        BlockVariableType *res = (*blocks)[i]->get_variable(name);
+        BlockVariableType *res = (*blocks)[i]->get_variable(symbol);
         if (res) return res;
         else if (i == 0) return nullptr;
     }
@@ -41,11 +52,11 @@ BlockVariableType *Block::get_single_variable(const std::string &name, const std
 void Block::debug() const
 {
     printf("-----------\n-> Block variables: (%zu)\n", this->variables.size());
-    for (const auto &[name, variable] : this->variables) {
+    for (const auto &[symbol, variable] : this->variables) {
         printf(
             "G-%05zu -> %s%s %s\n",
             static_cast<size_t>(variable.reg),
-            name.c_str(),
+            symbols->name(symbol).c_str(),
             variable.exported ? "*:" : ":",
             variable.type->to_string().c_str()
         );
@@ -0,0 +1,82 @@
+/**
+ * |--------------------|
+ * | Nuua Module Loader |
+ * |--------------------|
+ *
+ * Copyright 2019 Erik Campobadal <soc@erik.cat>
+ * https://nuua.io
+ */
+#include "../include/loader.hpp"
+#include "../include/parser.hpp"
+#include "../../Logger/include/logger.hpp"
+
+ModuleLoader *loader = new ModuleLoader;
+
+LoadedModule ModuleLoader::load(const std::string &file)
+{
+    std::lock_guard<std::mutex> lock(this->mutex);
+    auto module = this->modules.find(file);
+    if (module != this->modules.end()) return module->second;
+    // Schedule the new module.
+    Job job = { std::make_shared<const std::string>(file), std::promise<module_code_t>() };
+    LoadedModule result = { job.file, job.code.get_future().share() };
+    this->modules[file] = result;
+    this->jobs.push_back(std::move(job));
+    // The workers are started with the first import.
+    if (this->workers.empty()) {
+        unsigned int count = std::thread::hardware_concurrency();
+        for (unsigned int i = 0; i < (count > 0 ? count : 1); i++) {
+            this->workers.push_back(std::thread(&ModuleLoader::work, this));
+            // The workers live as long as the program.
+            this->workers.back().detach();
+        }
+    }
+    this->available.notify_one();
+    return result;
+}
+
+void ModuleLoader::work()
+{
+    // The errors of a module are given to the thread that waits for it.
+    logger->defer_crashes();
+    for (;;) {
+        Job job;
+        {
+            std::unique_lock<std::mutex> lock(this->mutex);
+            this->available.wait(lock, [this] { return !this->stopped && !this->jobs.empty(); });
+            job = std::move(this->jobs.front());
+            this->jobs.pop_front();
+            this->busy++;
+        }
+        try {
+            module_code_t code = std::make_shared<std::vector<std::shared_ptr<Statement>>>();
+            Parser(job.file).parse(code);
+            job.code.set_value(code);
+        } catch (const LoggerCrash &crash) {
+            job.code.set_exception(std::current_exception());
+        }
+        {
+            std::lock_guard<std::mutex> lock(this->mutex);
+            this->busy--;
+        }
+        this->finished.notify_all();
+    }
+}
+
+module_code_t ModuleLoader::get(const std::shared_future<module_code_t> &code)
+{
+    try {
+        return code.get();
+    } catch (const LoggerCrash &crash) {
+        // The program can't exit while the other modules are being parsed.
+        this->stop();
+        exit(logger->crash(crash));
+    }
+}
+
+void ModuleLoader::stop()
+{
+    std::unique_lock<std::mutex> lock(this->mutex);
+    this->stopped = true;
+    this->finished.wait(lock, [this] { return this->busy == 0; });
+}
@@ -8,6 +8,7 @@
  */
 #include "../include/parser.hpp"
 #include "../../Lexer/include/lexer.hpp"
+#include "../include/loader.hpp"
 #include "../../Logger/include/logger.hpp"
 #include <filesystem>
 #include <algorithm>
@@ -29,31 +30,7 @@
 #define ADD_LOG_PAR(line, col, msg) logger->add_entity(this->file, line, col, msg)
 #define EXPECT_NEW_LINE() if (!this->match_any({{ TOKEN_NEW_LINE, TOKEN_EOF }})) { \
     ADD_LOG("Expected a new line or EOF but got '" + CURRENT().to_string() + "'."); exit(logger->crash()); }
-#define NEW_NODE(type, ...) (std::make_shared<type>(this->file, PLINE(), PCOL(), __VA_ARGS__))
-
-// Stores the parsing file stack, to avoid
-// cyclic imports.
-static std::vector<const std::string *> file_stack;
-
-#define PREVENT_CYCLIC(file_ptr) \
-{ \
-    if (std::find(file_stack.begin(), file_stack.end(), file_ptr) != file_stack.end()) { \
-        ADD_LOG("Cyclic import detected. Can't use '" + *file_ptr + "'. Cyclic imports are not available in nuua."); \
-        exit(logger->crash()); \
-    } \
-}
-
-// Stores the relation between a file_name and the
-// parsed Abstract Syntax Tree and the pointer to the
-// original long lived file name string.
-// Acts as a temporal cache to avoid re-parsing a file.
-static std::unordered_map<
-    std::string,
-    std::pair<
-        std::shared_ptr<std::vector<std::shared_ptr<Statement>>>,
-        std::shared_ptr<const std::string>
-    >
-> parsed_files;
+#define NEW_NODE(type, ...) (std::allocate_shared<type>(NodeAllocator<type>(this->arena), this->file_id, PLINE(), PCOL(), __VA_ARGS__))
 
 Token *Parser::consume(const TokenType type, const std::string &message)
 {
@@ -105,6 +82,7 @@ std::shared_ptr<Expression> Parser::primary()
     if (this->match(TOKEN_STRING)) return NEW_NODE(String, PREVIOUS().to_string());
     if (this->match(TOKEN_IDENTIFIER)) {
         const std::string name = PREVIOUS().to_string();
+        const symbol_t symbol = PREVIOUS().symbol;
         // It can be an object.
         if (this->match(TOKEN_BANG)) {
             // It's an object.
@@ -114,7 +92,7 @@ std::shared_ptr<Expression> Parser::primary()
             this->consume(TOKEN_RIGHT_BRACE, "Expected '}' at the end of the object creation.");
             return NEW_NODE(Object, name, arguments);
         }
-        return NEW_NODE(Variable, name);
+        return NEW_NODE(Variable, name, symbol);
     }
     if (this->match(TOKEN_LEFT_SQUARE)) {
         std::vector<std::shared_ptr<Expression> > values;
@@ -235,8 +213,8 @@ std::shared_ptr<Expression> Parser::unary_postfix()
                 break;
             }
             case TOKEN_DOT: {
-                std::string prop = this->consume(TOKEN_IDENTIFIER, "Expected an identifier after '.' in an access to an object property.")->to_string();
-                result = NEW_NODE(Property, result, prop);
+                const Token *prop = this->consume(TOKEN_IDENTIFIER, "Expected an identifier after '.' in an access to an object property.");
+                result = NEW_NODE(Property, result, prop->to_string(), prop->symbol);
                 break;
             }
             default: {
@@ -437,17 +415,14 @@ std::shared_ptr<Statement> Parser::use_declaration()
         module = this->consume(TOKEN_STRING, "Expected an identifier or 'string' after 'use'")->to_string();
     }
     Parser::format_path(module, this->file);
-    std::shared_ptr<Use> use;
-    // Parse the contents of the target.
-    if (parsed_files.find(module) == parsed_files.end()) {
-        use = NEW_NODE(Use, targets, std::make_shared<std::string>(module));
-        PREVENT_CYCLIC(use->module.get());
-        use->code = std::make_shared<std::vector<std::shared_ptr<Statement>>>();
-        Parser(use->module).parse(use->code);
-    } else {
-        use = NEW_NODE(Use, targets, parsed_files[module].second);
-        PREVENT_CYCLIC(use->module.get());
-        use->code = parsed_files[module].first;
+    // The target is parsed by the module loader while this module is still being parsed.
+    LoadedModule target = loader->load(module);
+    std::shared_ptr<Use> use = NEW_NODE(Use, targets, target.file);
+    use->parsed = target.code;
+    if (this->dependencies) {
+        auto dependency = this->dependencies->find(module);
+        if (dependency != this->dependencies->end()) use->interface = dependency->second;
+        else this->outdated = true;
     }
     return use;
 }
@@ -467,12 +442,33 @@ std::shared_ptr<Statement> Parser::export_declaration()
 }
 
 /*
-fun_declaration -> "fun" IDENTIFIER "(" parameters? ")" (":" type)? ("->" expression "\n" | "=>" statement | "{" "\n" statement* "}" "\n");
+fun_declaration -> "fun" IDENTIFIER ("<" IDENTIFIER ("," IDENTIFIER)* ">")? "(" parameters? ")" (":" type)? ("->" expression "\n" | "=>" statement | "{" "\n" statement* "}" "\n");
 parameters -> variable_declaration ("," variable_declaration)*;
 */
 std::shared_ptr<Statement> Parser::fun_declaration()
 {
+    Token *start = this->current;
     std::string name = this->consume(TOKEN_IDENTIFIER, "Expected an identifier (function name) after 'fun'.")->to_string();
+    std::vector<std::string> type_parameters;
+    if (this->match(TOKEN_LOWER)) {
+        do type_parameters.push_back(this->consume(TOKEN_IDENTIFIER, "Expected an identifier (type parameter) after '<'.")->to_string());
+        while (this->match(TOKEN_COMMA));
+        this->consume(TOKEN_HIGHER, "Expected '>' after the type parameters.");
+    }
+    // The declaration of a generic function is parsed with its type parameters as types,
+    // while its instances are parsed with the types of the type parameters instead.
+    if (!type_parameters.empty() && !this->type_arguments) {
+        const std::vector<std::string> *enclosing = this->type_parameters;
+        this->type_parameters = &type_parameters;
+        std::shared_ptr<Statement> function = this->fun_declaration(start, name, true);
+        this->type_parameters = enclosing;
+        return function;
+    }
+    return this->fun_declaration(start, name, false);
+}
+
+std::shared_ptr<Statement> Parser::fun_declaration(Token *start, const std::string &name, const bool generic)
+{
     this->consume(TOKEN_LEFT_PAREN, "Expected '(' after the function name.");
     std::vector<std::shared_ptr<Declaration>> parameters;
     if (!this->match(TOKEN_RIGHT_PAREN)) {
@@ -482,6 +478,13 @@ std::shared_ptr<Statement> Parser::fun_declaration()
     std::shared_ptr<Type> return_type;
     if (this->match(TOKEN_COLON)) return_type = this->type(false);
     std::vector<std::shared_ptr<Statement> > body;
+    if (this->dependencies && !generic) {
+        // The code of the function is already compiled.
+        this->skip_body();
+        std::shared_ptr<FunctionValue> value = NEW_NODE(FunctionValue, name, parameters, return_type, body);
+        value->precompiled = true;
+        return std::allocate_shared<Function>(NodeAllocator<Function>(this->arena), value);
+    }
     if (this->match(TOKEN_RIGHT_ARROW)) {
         body.push_back(std::move(NEW_NODE(Return, this->expression())));
     } else if (this->match(TOKEN_BIG_RIGHT_ARROW)) {
@@ -494,7 +497,16 @@ std::shared_ptr<Statement> Parser::fun_declaration()
         ADD_LOG("Unknown token found after function. Expected '->', '=>' or '{'.");
         exit(logger->crash());
     }
-    return std::make_shared<Function>(NEW_NODE(FunctionValue, name, parameters, return_type, body));
+    std::shared_ptr<FunctionValue> value = NEW_NODE(FunctionValue, name, parameters, return_type, body);
+    if (generic) {
+        // Keep the tokens to parse the instances (they end with an EOF token).
+        value->generic = std::make_shared<GenericFunction>();
+        value->generic->parameters = *this->type_parameters;
+        for (Token *token = start; token != this->current; token++) value->generic->tokens.push_back(*token);
+        value->generic->tokens.push_back(Token(TOKEN_EOF, PREVIOUS().start, 0, PLINE(), PCOL()));
+        value->generic->source = this->source;
+    }
+    return std::allocate_shared<Function>(NodeAllocator<Function>(this->arena), value);
 }
 
 /*
@@ -829,6 +841,28 @@ std::vector<std::shared_ptr<Statement> > Parser::class_body()
     return body;
 }
 
+void Parser::skip_body()
+{
+    size_t depth = 0;
+    if (this->match(TOKEN_LEFT_BRACE)) depth++;
+    else if (!this->match_any({{ TOKEN_RIGHT_ARROW, TOKEN_BIG_RIGHT_ARROW }})) {
+        ADD_LOG("Unknown token found after function. Expected '->', '=>' or '{'.");
+        exit(logger->crash());
+    }
+    // Block bodies end at the closing brace, the others at the end of the line.
+    bool block = depth > 0;
+    while (!IS_AT_END() && (depth > 0 || (!block && !CHECK(TOKEN_NEW_LINE)))) {
+        if (this->match_any({{ TOKEN_LEFT_BRACE, TOKEN_LEFT_PAREN, TOKEN_LEFT_SQUARE }})) depth++;
+        else if (this->match_any({{ TOKEN_RIGHT_BRACE, TOKEN_RIGHT_PAREN, TOKEN_RIGHT_SQUARE }})) depth--;
+        else NEXT();
+        if (block && depth == 0) return;
+    }
+    if (block) {
+        ADD_LOG("Unterminated body. Must use '}' to terminate the body.");
+        exit(logger->crash());
+    }
+}
+
 /*
 type -> "[" type "]"
     | "{" type "}"
@@ -872,6 +906,18 @@ std::shared_ptr<Type> Parser::type(bool optional)
     } else if (CHECK(TOKEN_IDENTIFIER)) {
         // Other types (native + custom).
         std::string type = this->consume(TOKEN_IDENTIFIER, "Expected an identifier as a type.")->to_string();
+        if (this->type_arguments && this->type_arguments->count(type)) {
+            // Type parameter of the instance beeing parsed.
+            std::shared_ptr<Type> argument = std::make_shared<Type>();
+            this->type_arguments->at(type)->copy_to(argument);
+            return argument;
+        }
+        if (this->type_parameters && std::find(this->type_parameters->begin(), this->type_parameters->end(), type) != this->type_parameters->end()) {
+            // Type parameter of the generic function beeing parsed.
+            std::shared_ptr<Type> parameter = std::make_shared<Type>(VALUE_NO_TYPE);
+            parameter->class_name = type;
+            return parameter;
+        }
         return std::make_shared<Type>(type);
     } else if (optional && (CHECK(TOKEN_NEW_LINE) || CHECK(TOKEN_EQUAL))) return std::shared_ptr<Type>();
 
@@ -882,16 +928,22 @@ std::shared_ptr<Type> Parser::type(bool optional)
 /*
 program -> top_level_declaration*;
 */
-void Parser::parse(std::shared_ptr<std::vector<std::shared_ptr<Statement>>> &code)
+void Parser::parse(std::shared_ptr<std::vector<std::shared_ptr<Statement>>> &code, const bool allow_precompiled)
 {
-    // Add the file we are going to parse to the file_stack.
-    file_stack.push_back(this->file.get());
     // Prepare the token list.
     std::unique_ptr<std::vector<Token>> tokens = std::make_unique<std::vector<Token>>();
     Lexer lexer = Lexer(this->file);
     // Scan the tokens.
     lexer.scan(tokens);
+    this->source = lexer.source;
     if (logger->show_tokens) Token::debug_tokens(*tokens);
+    // Check if the module is already compiled (the source hash is always
+    // given, since it's recorded when the module is compiled again).
+    if (loader->precompiled) {
+        const std::unordered_map<std::string, uint64_t> *dependencies = loader->precompiled(*this->file, lexer.source->hash());
+        if (allow_precompiled) this->dependencies = dependencies;
+    }
+    parser_parse:
     this->current = &tokens->front();
     while (!IS_AT_END()) {
         // Remove blank lines
@@ -900,12 +952,29 @@ void Parser::parse(std::shared_ptr<std::vector<std::shared_ptr<Statement>>> &cod
         // Add the TLD.
         code->push_back(std::move(this->top_level_declaration()));
     }
+    // The module uses other modules than the precompiled one, so it needs the bodies.
+    if (this->outdated) {
+        code->clear();
+        this->dependencies = nullptr;
+        this->outdated = false;
+        goto parser_parse;
+    }
     // Check the code size to avoid empty files.
     if (code->size() == 0) {
         logger->add_entity(this->file, 0, 0, "Empty file detected, you might need to check the file or make sure it's not empty.");
         exit(logger->crash());
     }
-    parsed_files[*this->file] = std::make_pair(code, this->file);
+}
+
+std::shared_ptr<FunctionValue> Parser::instantiate(const GenericFunction &generic, const std::unordered_map<std::string, std::shared_ptr<Type>> &types)
+{
+    // The tokens are copied since the parser moves through them.
+    std::vector<Token> tokens = generic.tokens;
+    this->current = &tokens.front();
+    this->type_arguments = &types;
+    std::shared_ptr<FunctionValue> fun = std::static_pointer_cast<Function>(this->fun_declaration())->value;
+    this->type_arguments = nullptr;
+    return fun;
 }
 
 Parser::Parser(const char *file)
@@ -913,6 +982,7 @@ Parser::Parser(const char *file)
     std::string source = std::string(file);
     Parser::format_path(source);
     this->file = std::move(std::make_shared<const std::string>(std::string(source)));
+    this->file_id = logger->intern_file(this->file);
 }
 
 void Parser::format_path(std::string &path, const std::shared_ptr<const std::string> &parent)
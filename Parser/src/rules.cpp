@@ -7,6 +7,7 @@
  * https://nuua.io
  */
 #include "../include/parser.hpp"
+#include "../include/loader.hpp"
 
 static std::vector<std::string> RuleNames = {
     "RULE_EXPRESSION",
@@ -66,6 +67,9 @@ void Parser::debug_rules(const std::vector<std::shared_ptr<Statement>> &rules)
     for (const std::shared_ptr<Statement> &stmt : rules) Parser::debug_rule(stmt);
 }
 
+// Stores the modules being printed.
+static std::vector<const std::vector<std::shared_ptr<Statement>> *> printing_modules;
+
 static void print_spaces(uint16_t ammount)
 {
     for (; ammount > 0; ammount--) printf("  ");
@@ -258,7 +262,11 @@ void Parser::debug_ast(const std::shared_ptr<Statement> &statement, const uint16
             }
             print_spaces(spacer + 1);
             printf("[Code]\n");
+            // The analyzer reports cyclic imports, they must not be printed forever.
+            if (std::find(printing_modules.begin(), printing_modules.end(), use->wait().get()) != printing_modules.end()) break;
+            printing_modules.push_back(use->code.get());
             Parser::debug_ast(*use->code, spacer + 2);
+            printing_modules.pop_back();
             break;
         }
         case RULE_EXPORT: {
@@ -280,3 +288,9 @@ void Parser::debug_ast(const std::vector<std::shared_ptr<Statement>> &statements
 {
     for (const std::shared_ptr<Statement> &stmt : statements) Parser::debug_ast(stmt, spacer);
 }
+
+const std::shared_ptr<std::vector<std::shared_ptr<Statement>>> &Use::wait()
+{
+    if (!this->code) this->code = loader->get(this->parsed);
+    return this->code;
+}
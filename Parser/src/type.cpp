@@ -409,8 +409,8 @@ bool Type::same_as(const Type *type) const
 
 std::string Type::to_string() const
 {
-    // Check if it's a no type.
-    if (this->type == VALUE_NO_TYPE) return "<no-type>";
+    // Check if it's a no type (or a type parameter of a generic function).
+    if (this->type == VALUE_NO_TYPE) return this->class_name.empty() ? "<no-type>" : this->class_name;
 
     // Check if it's a simple type (int, float, bool, string).
     for (auto &[key, value] : Type::value_types) {
@@ -462,6 +462,12 @@ Type::Type(const std::shared_ptr<Function> &fun)
 
 Type::Type(const std::shared_ptr<Expression> &rule, const std::vector<std::shared_ptr<Block>> *blocks)
 {
+    // The type of an expression never changes once it's analyzed,
+    // so the subexpressions are only walked the first time.
+    if (rule->resolved_type) {
+        rule->resolved_type->copy_to(this);
+        return;
+    }
     switch (rule->rule) {
         case RULE_INTEGER: { this->type = VALUE_INT; break; }
         case RULE_FLOAT: { this->type = VALUE_FLOAT; break; }
@@ -505,10 +511,10 @@ Type::Type(const std::shared_ptr<Expression> &rule, const std::vector<std::share
             break;
         }
         case RULE_VARIABLE: {
-            std::string var = std::static_pointer_cast<Variable>(rule)->name;
-            BlockVariableType *res = Block::get_single_variable(var, blocks);
+            std::shared_ptr<Variable> var = std::static_pointer_cast<Variable>(rule);
+            BlockVariableType *res = Block::get_single_variable(var->symbol, blocks);
             if (!res) {
-                logger->add_entity(rule->file, rule->line, rule->column, "No variable named '" + var + "' was found in the current or previous blocks.");
+                logger->add_entity(rule->file, rule->line, rule->column, "No variable named '" + var->name + "' was found in the current or previous blocks.");
                 exit(logger->crash());
             }
             res->type->copy_to(this);
@@ -577,7 +583,7 @@ Type::Type(const std::shared_ptr<Expression> &rule, const std::vector<std::share
                 logger->add_entity(rule->file, rule->line, rule->column, "No class named '" + t.class_name + "' was found.");
                 exit(logger->crash());
             }
-            BlockVariableType *var = c->block->get_variable(prop->name);
+            BlockVariableType *var = c->block->get_variable(prop->symbol);
             if (!var) {
                 logger->add_entity(rule->file, rule->line, rule->column, "No property named '" + prop->name + "' was found in class '" + t.class_name + "'.");
                 exit(logger->crash());
@@ -590,6 +596,8 @@ Type::Type(const std::shared_ptr<Expression> &rule, const std::vector<std::share
             exit(logger->crash());
         }
     }
+    rule->resolved_type = std::make_shared<Type>();
+    this->copy_to(rule->resolved_type);
 }
 
 std::vector<std::string> Type::classes_used(const std::string &mod) const
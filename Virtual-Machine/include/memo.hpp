@@ -0,0 +1,42 @@
+/**
+ * |------------------|
+ * | Nuua Memoization |
+ * |------------------|
+ *
+ * Copyright 2019 Erik Campobadal <soc@erik.cat>
+ * https://nuua.io
+ */
+#ifndef MEMO_HPP
+#define MEMO_HPP
+
+#include "../../Compiler/include/value.hpp"
+#include <deque>
+
+// Defines the maximum number of results stored for each memoized function.
+#define MEMO_CAPACITY 65536
+
+// Stores the results of a memoized function (a pure function whose parameters
+// and return value are scalars) keyed by the values of its arguments.
+// Once it's full, the oldest result is evicted to store a new one.
+class MemoTable
+{
+    // Stores the results.
+    std::unordered_map<std::string, Value> results;
+    // Stores the keys in the order they were stored (the first one is evicted first).
+    std::deque<std::string> order;
+    public:
+        // Stores the function name.
+        std::string name;
+        // Stores the calls that found their result, the ones that didn't and the evicted results.
+        size_t hits = 0, misses = 0, evictions = 0;
+        // Returns the key of the given arguments.
+        static std::string key(const Value *arguments, const size_t count);
+        // Returns the result stored for the key (nullptr if it's not stored).
+        const Value *find(const std::string &key);
+        // Stores the result of the key.
+        void store(const std::string &key, const Value &result);
+        // Prints the table statistics.
+        void report() const;
+};
+
+#endif
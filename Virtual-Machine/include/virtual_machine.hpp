@@ -10,6 +10,7 @@
 #define VIRTUAL_MACHINE_HPP
 
 #include "../../Compiler/include/compiler.hpp"
+#include "memo.hpp"
 
 #define MAX_FRAMES 1024
 #define STACK_SIZE 1024
@@ -28,8 +29,12 @@ class VirtualMachine
     Frame frames[MAX_FRAMES];
     // Indicates the top level frame.
     Frame *active_frame = this->frames - 1; // It performs a pre-increment when a call is done.
+    // Stores the results table of each memoized function (indexed by its entry point).
+    std::unordered_map<size_t, MemoTable> memo_tables;
     // Runs the virtual machine.
     void run();
+    // Marks the virtual machine roots and performs a heap collection.
+    void collect_garbage();
     // Helpers to get the file, line and column.
     std::shared_ptr<const std::string> current_file();
     line_t current_line();
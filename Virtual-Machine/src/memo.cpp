@@ -0,0 +1,65 @@
+/**
+ * |------------------|
+ * | Nuua Memoization |
+ * |------------------|
+ *
+ * Copyright 2019 Erik Campobadal <soc@erik.cat>
+ * https://nuua.io
+ */
+#include "../include/memo.hpp"
+
+// Appends the bytes of a scalar to a key.
+template <typename T>
+static void append(std::string &key, const T &value)
+{
+    key.append(reinterpret_cast<const char *>(&value), sizeof(T));
+}
+
+std::string MemoTable::key(const Value *arguments, const size_t count)
+{
+    std::string key;
+    for (size_t i = 0; i < count; i++) {
+        const Value &argument = arguments[i];
+        // The variant index separates the types and the strings are prefixed by their length.
+        key += static_cast<char>(argument.value.index());
+        switch (argument.value.index()) {
+            case 0: { append(key, GETV(argument.value, nint_t)); break; }
+            case 1: { append(key, GETV(argument.value, nfloat_t)); break; }
+            case 2: { append(key, GETV(argument.value, nbool_t)); break; }
+            case 3: {
+                const nstring_t &string = GETV(argument.value, nstring_t);
+                append(key, string.length());
+                key += string;
+                break;
+            }
+            default: { /* Only the scalars are arguments of the memoized functions */ }
+        }
+    }
+    return key;
+}
+
+const Value *MemoTable::find(const std::string &key)
+{
+    const auto result = this->results.find(key);
+    if (result == this->results.end()) {
+        this->misses++;
+        return nullptr;
+    }
+    this->hits++;
+    return &result->second;
+}
+
+void MemoTable::store(const std::string &key, const Value &result)
+{
+    if (!this->results.emplace(key, result).second) return;
+    this->order.push_back(key);
+    if (this->order.size() <= MEMO_CAPACITY) return;
+    this->results.erase(this->order.front());
+    this->order.pop_front();
+    this->evictions++;
+}
+
+void MemoTable::report() const
+{
+    printf("%20s: %zu hits, %zu misses, %zu evictions, %zu stored\n", this->name.c_str(), this->hits, this->misses, this->evictions, this->results.size());
+}
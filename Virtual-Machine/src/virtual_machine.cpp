@@ -8,20 +8,22 @@
 #define END_PC (&this->program->memory->code.back())
 #define PC (this->program_counter)
 #define PC_AT(at) (PC + at)
-#define GLOBAL(at) (this->program->main_frame.registers.get() + *PC_AT(at))
+#define GLOBAL(at) (this->program->main_frame.registers + *PC_AT(at))
 #define LITERAL(at) (*PC_AT(at))
-#define REGISTER(at) (this->active_frame->registers.get() + *PC_AT(at))
+#define REGISTER(at) (this->active_frame->registers + *PC_AT(at))
 #define CONSTANT(at) (this->program->memory->constants.data() + *PC_AT(at))
-#define PROP(object_at, prop_at) (GETV(REGISTER(object_at)->value, std::shared_ptr<nobject_t>)->registers.get() + *PC_AT(prop_at))
+#define PROP(object_at, prop_at) (GETV(REGISTER(object_at)->value, nobject_t *)->registers + *PC_AT(prop_at))
 #define INC_PC(num) (PC += num)
 #define PUSH(value_ptr) ((value_ptr)->copy_to(this->top_stack++))
 #define POP(value_ptr) (--this->top_stack)->copy_to(value_ptr)
 #define CRASH(msg) logger->add_entity(this->current_file(), this->current_line(), this->current_column(), msg); exit(logger->crash())
+// Collects the garbage if needed. Must only be used once the new heap objects are stored in a register.
+#define GC_SAFEPOINT() if (heap->should_collect()) this->collect_garbage()
 
 // Safe cheks
-#define CHECK_OBJECT(object_at) if (!GETV(REGISTER(object_at)->value, std::shared_ptr<nobject_t>)) { \
+#define CHECK_OBJECT(object_at) if (!GETV(REGISTER(object_at)->value, nobject_t *)) { \
     CRASH("Segmentation fault: Uninitialized object '" + REGISTER(object_at)->to_string() + "'."); }
-#define CHECK_FUN(fun_at) if (!GETV(REGISTER(fun_at)->value, std::shared_ptr<nfun_t>)) { \
+#define CHECK_FUN(fun_at) if (!GETV(REGISTER(fun_at)->value, nfun_t *)) { \
     CRASH("Segmentation fault: Uninitialized function '" + REGISTER(fun_at)->to_string() + "'."); }
 
 static std::string key_order_to_string(const std::vector<std::string> &vec)
@@ -46,7 +48,7 @@ void VirtualMachine::run()
             case OP_PUSH_C: { PUSH(CONSTANT(1)); INC_PC(2); break; }
             case OP_POP: { POP(REGISTER(1)); INC_PC(2); break; }
             case OP_SGET: {
-                REGISTER(2)->type.copy_to(REGISTER(1)->type);
+                REGISTER(1)->type = REGISTER(2)->type;
                 const nint_t &index = GETV(REGISTER(3)->value, nint_t);
                 const nstring_t &str = GETV(REGISTER(2)->value, nstring_t);
                 if (index < 0 || static_cast<size_t>(index) > str.length()) {
@@ -73,20 +75,30 @@ void VirtualMachine::run()
                 break;
             }
             case OP_LPUSH: {
-                GETV(REGISTER(1)->value, std::shared_ptr<nlist_t>)->push_back(*REGISTER(2));
+                nlist_t *list = GETV(REGISTER(1)->value, nlist_t *);
+                const size_t footprint = list->footprint();
+                list->push_back(*REGISTER(2));
+                // Account the bytes if the list buffer grew.
+                heap->grow(list->footprint() - footprint);
+                GC_SAFEPOINT();
                 INC_PC(3);
                 break;
             }
             case OP_LPUSH_C: {
-                GETV(REGISTER(1)->value, std::shared_ptr<nlist_t>)->push_back(*CONSTANT(2));
+                nlist_t *list = GETV(REGISTER(1)->value, nlist_t *);
+                const size_t footprint = list->footprint();
+                list->push_back(*CONSTANT(2));
+                // Account the bytes if the list buffer grew.
+                heap->grow(list->footprint() - footprint);
+                GC_SAFEPOINT();
                 INC_PC(3);
                 break;
             }
             // case OP_LPOP: { INC_PC(2); break; }
             case OP_LGET: {
-                REGISTER(2)->type.inner_type->copy_to(REGISTER(1)->type);
+                REGISTER(1)->type = REGISTER(2)->type.inner();
                 nint_t index = GETV(REGISTER(3)->value, nint_t);
-                const std::shared_ptr<nlist_t> &list = GETV(REGISTER(2)->value, std::shared_ptr<nlist_t>);
+                nlist_t *list = GETV(REGISTER(2)->value, nlist_t *);
                 if (index < 0 || static_cast<size_t>(index) > list->size()) {
                     CRASH("Index out of range. The index at this point of execution must be between [0, " + std::to_string(list->size()) + "]");
                 }
@@ -94,8 +106,14 @@ void VirtualMachine::run()
                 INC_PC(4);
                 break;
             }
+            case OP_LGET_U: {
+                REGISTER(1)->type = REGISTER(2)->type.inner();
+                (*GETV(REGISTER(2)->value, nlist_t *))[GETV(REGISTER(3)->value, nint_t)].copy_to(REGISTER(1));
+                INC_PC(4);
+                break;
+            }
             case OP_LSET: {
-                const std::shared_ptr<nlist_t> &list = GETV(REGISTER(1)->value, std::shared_ptr<nlist_t>);
+                nlist_t *list = GETV(REGISTER(1)->value, nlist_t *);
                 const nint_t &index = GETV(REGISTER(2)->value, nint_t);
                 if (index < 0 || static_cast<size_t>(index) > list->size()) {
                     CRASH("Index out of range. The index at this point of execution must be between [0, " + std::to_string(list->size()) + "]");
@@ -104,8 +122,13 @@ void VirtualMachine::run()
                 INC_PC(4);
                 break;
             }
+            case OP_LSET_U: {
+                REGISTER(3)->copy_to(&(*GETV(REGISTER(1)->value, nlist_t *))[GETV(REGISTER(2)->value, nint_t)]);
+                INC_PC(4);
+                break;
+            }
             case OP_LDELETE: {
-                std::shared_ptr<nlist_t> &target = GETV(REGISTER(1)->value, std::shared_ptr<nlist_t>);
+                nlist_t *target = GETV(REGISTER(1)->value, nlist_t *);
                 const nint_t &index = GETV(REGISTER(2)->value, nint_t);
                 if (index < 0 || static_cast<size_t>(index) > target->size()) {
                     CRASH("Index out of range. The index at this point of execution must be between [0, " + std::to_string(target->size()) + "]");
@@ -115,7 +138,7 @@ void VirtualMachine::run()
                 break;
             }
             case OP_DKEY: {
-                const std::shared_ptr<ndict_t> &d = GETV(REGISTER(2)->value, std::shared_ptr<ndict_t>);
+                ndict_t *d = GETV(REGISTER(2)->value, ndict_t *);
                 const nint_t &index = GETV(REGISTER(3)->value, nint_t);
                 if (index < 0 || static_cast<size_t>(index) > d->key_order.size()) {
                     CRASH("Key index out of range. The index at this point of execution must be between [0, " + std::to_string(d->key_order.size()) + "]");
@@ -125,22 +148,29 @@ void VirtualMachine::run()
                 INC_PC(4);
                 break;
             }
+            case OP_DKEY_U: {
+                REGISTER(1)->value = GETV(REGISTER(2)->value, ndict_t *)->key_order[GETV(REGISTER(3)->value, nint_t)];
+                REGISTER(1)->retype(VALUE_STRING);
+                INC_PC(4);
+                break;
+            }
             case OP_DGET: {
-                const std::shared_ptr<ndict_t> &d = GETV(REGISTER(2)->value, std::shared_ptr<ndict_t>);
+                ndict_t *d = GETV(REGISTER(2)->value, ndict_t *);
                 const nstring_t &key = GETV(REGISTER(3)->value, nstring_t);
                 const auto el = std::find(d->key_order.begin(), d->key_order.end(), key);
                 if (el == d->key_order.end()) {
                     CRASH("Key '" + key + "' not found in dictionary. Current dictionary keys are: " + key_order_to_string(d->key_order));
                 }
-                REGISTER(2)->type.inner_type->copy_to(REGISTER(1)->type);
+                REGISTER(1)->type = REGISTER(2)->type.inner();
                 // REGISTER(1)->value = d.values.at(key);
                 d->values.at(key).copy_to(REGISTER(1));
                 INC_PC(4);
                 break;
             }
             case OP_DSET: {
-                const std::shared_ptr<ndict_t> &dict = GETV(REGISTER(1)->value, std::shared_ptr<ndict_t>);
+                ndict_t *dict = GETV(REGISTER(1)->value, ndict_t *);
                 const nstring_t &index = GETV(REGISTER(2)->value, nstring_t);
+                const size_t footprint = dict->footprint();
                 // Add the index to the key order if needed.
                 if (std::find(dict->key_order.begin(), dict->key_order.end(), index) == dict->key_order.end()) {
                     // Key not found, need to add it as well at the end.
@@ -148,11 +178,14 @@ void VirtualMachine::run()
                 }
                 // Add the value to the hashmap.
                 dict->values[index] = *REGISTER(3);
+                // Account the bytes if a new key was added.
+                heap->grow(dict->footprint() - footprint);
+                GC_SAFEPOINT();
                 INC_PC(4);
                 break;
             }
             case OP_DDELETE: {
-                std::shared_ptr<ndict_t> &target = GETV(REGISTER(1)->value, std::shared_ptr<ndict_t>);
+                ndict_t *target = GETV(REGISTER(1)->value, ndict_t *);
                 const nstring_t &index = GETV(REGISTER(2)->value, nstring_t);
                 const auto el = std::find(target->key_order.begin(), target->key_order.end(), index);
                 if (el == target->key_order.end()) {
@@ -165,7 +198,7 @@ void VirtualMachine::run()
             }
             case OP_CALL: {
                 CHECK_FUN(1);
-                const std::shared_ptr<nfun_t> &r = GETV(REGISTER(1)->value, std::shared_ptr<nfun_t>);
+                nfun_t *r = GETV(REGISTER(1)->value, nfun_t *);
                 // Set the new frame and allocate it's registers.
                 (++this->active_frame)->setup(r->registers, PC + 2);
                 // Change the program counter.
@@ -174,12 +207,39 @@ void VirtualMachine::run()
                 break;
             }
             case OP_RETURN: {
+                // Store the result of a memoized function.
+                if (this->active_frame->memo) {
+                    if (this->top_stack == this->active_frame->memo_stack + 1) {
+                        this->active_frame->memo->store(this->active_frame->memo_key, *(this->top_stack - 1));
+                    }
+                    this->active_frame->memo = nullptr;
+                }
 				// Delete the allocated memory
 				this->active_frame->free_registers();
                 // Drop the frame and reset the PC position.
                 PC = (this->active_frame--)->return_address;
                 break;
             }
+            case OP_MEMO: {
+                const size_t arguments = LITERAL(2);
+                MemoTable &table = this->memo_tables[PC - BASE_PC];
+                if (table.name.empty()) table.name = GETV(CONSTANT(1)->value, nstring_t);
+                std::string key = MemoTable::key(this->top_stack - arguments, arguments);
+                const Value *result = table.find(key);
+                if (result) {
+                    // Replace the arguments with the result and return.
+                    this->top_stack -= arguments;
+                    PUSH(result);
+                    this->active_frame->free_registers();
+                    PC = (this->active_frame--)->return_address;
+                    break;
+                }
+                this->active_frame->memo = &table;
+                this->active_frame->memo_key = std::move(key);
+                this->active_frame->memo_stack = this->top_stack - arguments;
+                INC_PC(3);
+                break;
+            }
             case OP_LPROP: {
                 CHECK_OBJECT(2);
                 PROP(2, 3)->copy_to(REGISTER(1));
@@ -192,6 +252,11 @@ void VirtualMachine::run()
                 INC_PC(4);
                 break;
             }
+            case OP_CHECK_OBJECT: {
+                CHECK_OBJECT(1);
+                INC_PC(2);
+                break;
+            }
             case OP_CAST_INT_FLOAT: {
                 REGISTER(1)->value = static_cast<nfloat_t>(GETV(REGISTER(2)->value, nint_t));
                 REGISTER(1)->retype(VALUE_FLOAT);
@@ -253,13 +318,13 @@ void VirtualMachine::run()
                 break;
             }
             case OP_CAST_LIST_BOOL: {
-                REGISTER(1)->value = static_cast<nbool_t>(GETV(REGISTER(2)->value, std::shared_ptr<nlist_t>)->size() != 0);
+                REGISTER(1)->value = static_cast<nbool_t>(GETV(REGISTER(2)->value, nlist_t *)->size() != 0);
                 REGISTER(1)->retype(VALUE_BOOL);
                 INC_PC(3);
                 break;
             }
             case OP_CAST_LIST_INT: {
-                REGISTER(1)->value = static_cast<nint_t>(GETV(REGISTER(2)->value, std::shared_ptr<nlist_t>)->size());
+                REGISTER(1)->value = static_cast<nint_t>(GETV(REGISTER(2)->value, nlist_t *)->size());
                 REGISTER(1)->retype(VALUE_INT);
                 INC_PC(3);
                 break;
@@ -271,13 +336,13 @@ void VirtualMachine::run()
                 break;
             }
             case OP_CAST_DICT_BOOL: {
-                REGISTER(1)->value = GETV(REGISTER(2)->value, std::shared_ptr<ndict_t>)->values.size() != 0;
+                REGISTER(1)->value = GETV(REGISTER(2)->value, ndict_t *)->values.size() != 0;
                 REGISTER(1)->retype(VALUE_BOOL);
                 INC_PC(3);
                 break;
             }
             case OP_CAST_DICT_INT: {
-                REGISTER(1)->value = static_cast<nint_t>(GETV(REGISTER(2)->value, std::shared_ptr<ndict_t>)->values.size());
+                REGISTER(1)->value = static_cast<nint_t>(GETV(REGISTER(2)->value, ndict_t *)->values.size());
                 REGISTER(1)->retype(VALUE_INT);
                 INC_PC(3);
                 break;
@@ -364,19 +429,20 @@ void VirtualMachine::run()
             }
             case OP_ADD_LIST: {
                 nlist_t res;
-                const std::shared_ptr<nlist_t> &a = GETV(REGISTER(2)->value, std::shared_ptr<nlist_t>);
-                const std::shared_ptr<nlist_t> &b = GETV(REGISTER(3)->value, std::shared_ptr<nlist_t>);
+                nlist_t *a = GETV(REGISTER(2)->value, nlist_t *);
+                nlist_t *b = GETV(REGISTER(3)->value, nlist_t *);
                 res.reserve(a->size() + b->size());
                 res.insert(res.end(), a->begin(), a->end());
                 res.insert(res.end(), b->begin(), b->end());
-                REGISTER(1)->value = std::make_shared<nlist_t>(res);
-                REGISTER(2)->type.copy_to(REGISTER(1)->type);
+                REGISTER(1)->value = heap->allocate<nlist_t>(std::move(res));
+                REGISTER(1)->type = REGISTER(2)->type;
+                GC_SAFEPOINT();
                 INC_PC(4);
                 break;
             }
             case OP_ADD_DICT: {
-                const std::shared_ptr<ndict_t> &a = GETV(REGISTER(2)->value, std::shared_ptr<ndict_t>);
-                const std::shared_ptr<ndict_t> &b = GETV(REGISTER(3)->value, std::shared_ptr<ndict_t>);
+                ndict_t *a = GETV(REGISTER(2)->value, ndict_t *);
+                ndict_t *b = GETV(REGISTER(3)->value, ndict_t *);
                 ndict_t res = ndict_t(*a);
                 for (const auto &[key, value] : b->values) {
                     // Add the key if it does not exist.
@@ -386,8 +452,9 @@ void VirtualMachine::run()
                     // Add the value
                     res.values[key] = value;
                 }
-                REGISTER(1)->value = std::make_shared<ndict_t>(res);
-                REGISTER(2)->type.copy_to(REGISTER(1)->type);
+                REGISTER(1)->value = heap->allocate<ndict_t>(std::move(res));
+                REGISTER(1)->type = REGISTER(2)->type;
+                GC_SAFEPOINT();
                 INC_PC(4);
                 break;
             }
@@ -453,27 +520,29 @@ void VirtualMachine::run()
             }
             case OP_MUL_INT_LIST: {
                 const nint_t &integer = GETV(REGISTER(2)->value, nint_t);
-                const std::shared_ptr<nlist_t> &list = GETV(REGISTER(3)->value, std::shared_ptr<nlist_t>);
+                nlist_t *list = GETV(REGISTER(3)->value, nlist_t *);
                 nlist_t res;
                 if (integer > 0) {
                     res.reserve(list->size() * integer);
                     for (size_t i = 0; i < static_cast<size_t>(integer); i++) res.insert(res.end(), list->begin(), list->end());
                 }
-                REGISTER(1)->value = std::make_shared<nlist_t>(res);
-                REGISTER(3)->type.copy_to(REGISTER(1)->type);
+                REGISTER(1)->value = heap->allocate<nlist_t>(std::move(res));
+                REGISTER(1)->type = REGISTER(3)->type;
+                GC_SAFEPOINT();
                 INC_PC(4);
                 break;
             }
             case OP_MUL_LIST_INT: {
                 const nint_t &integer = GETV(REGISTER(3)->value, nint_t);
-                const std::shared_ptr<nlist_t> &list = GETV(REGISTER(2)->value, std::shared_ptr<nlist_t>);
+                nlist_t *list = GETV(REGISTER(2)->value, nlist_t *);
                 nlist_t res;
                 if (integer > 0) {
                     res.reserve(list->size() * integer);
                     for (size_t i = 0; i < static_cast<size_t>(integer); i++) res.insert(res.end(), list->begin(), list->end());
                 }
-                REGISTER(1)->value = std::make_shared<nlist_t>(res);
-                REGISTER(2)->type.copy_to(REGISTER(1)->type);
+                REGISTER(1)->value = heap->allocate<nlist_t>(std::move(res));
+                REGISTER(1)->type = REGISTER(2)->type;
+                GC_SAFEPOINT();
                 INC_PC(4);
                 break;
             }
@@ -510,13 +579,14 @@ void VirtualMachine::run()
                         res.push_back({ s });
                     }
                 } else { CRASH("The string divisor must be greater than 0 -> " + std::to_string(string.length()) + " / " + std::to_string(integer)); }
-                REGISTER(1)->value = std::make_shared<nlist_t>(res);
+                REGISTER(1)->value = heap->allocate<nlist_t>(std::move(res));
                 REGISTER(1)->retype(VALUE_LIST, std::make_shared<Type>(VALUE_STRING));
+                GC_SAFEPOINT();
                 INC_PC(4);
                 break;
             }
             case OP_DIV_LIST_INT: {
-                const std::shared_ptr<nlist_t> &list = GETV(REGISTER(2)->value, std::shared_ptr<nlist_t>);
+                nlist_t *list = GETV(REGISTER(2)->value, nlist_t *);
                 const nint_t &integer = GETV(REGISTER(3)->value, nint_t);
                 size_t per_item = static_cast<size_t>(ceil(list->size() / static_cast<double>(abs(integer))));
                 nlist_t res;
@@ -527,11 +597,12 @@ void VirtualMachine::run()
                         for (size_t k = 0; k < per_item; k++) {
                             if (current_index < list->size()) l.push_back((*list)[current_index++]);
                         }
-                        res.push_back({ l, REGISTER(2)->type.inner_type });
+                        res.push_back({ l, REGISTER(2)->type->inner_type });
                     }
                 } else { CRASH("The list divisor must be greater than 0 -> " + std::to_string(list->size()) + " / " + std::to_string(integer)); }
-                REGISTER(1)->value = std::make_shared<nlist_t>(res);
-                REGISTER(1)->retype(VALUE_LIST, std::make_shared<Type>(REGISTER(2)->type));
+                REGISTER(1)->value = heap->allocate<nlist_t>(std::move(res));
+                REGISTER(1)->retype(VALUE_LIST, std::make_shared<Type>(*REGISTER(2)->type));
+                GC_SAFEPOINT();
                 INC_PC(4);
                 break;
             }
@@ -772,20 +843,26 @@ void VirtualMachine::run()
                 break;
             }
             case OP_RANGEE: {
-                REGISTER(1)->value = std::make_shared<nlist_t>();
-                for (int64_t i = GETV(REGISTER(2)->value, nint_t); i < GETV(REGISTER(3)->value, nint_t); i++) {
-                    GETV(REGISTER(1)->value, std::shared_ptr<nlist_t>)->push_back({ i });
-                }
+                const nint_t start = GETV(REGISTER(2)->value, nint_t);
+                const nint_t end = GETV(REGISTER(3)->value, nint_t);
+                nlist_t res;
+                if (end > start) res.reserve(end - start);
+                for (nint_t i = start; i < end; i++) res.push_back({ i });
+                REGISTER(1)->value = heap->allocate<nlist_t>(std::move(res));
                 REGISTER(1)->retype(VALUE_LIST, std::make_shared<Type>(VALUE_INT));
+                GC_SAFEPOINT();
                 INC_PC(4);
                 break;
             }
             case OP_RANGEI: {
-                REGISTER(1)->value = std::make_shared<nlist_t>();
-                for (int64_t i = GETV(REGISTER(2)->value, nint_t); i <= GETV(REGISTER(3)->value, nint_t); i++) {
-                    GETV(REGISTER(1)->value, std::shared_ptr<nlist_t>)->push_back({ i });
-                }
+                const nint_t start = GETV(REGISTER(2)->value, nint_t);
+                const nint_t end = GETV(REGISTER(3)->value, nint_t);
+                nlist_t res;
+                if (end >= start) res.reserve(end - start + 1);
+                for (nint_t i = start; i <= end; i++) res.push_back({ i });
+                REGISTER(1)->value = heap->allocate<nlist_t>(std::move(res));
                 REGISTER(1)->retype(VALUE_LIST, std::make_shared<Type>(VALUE_INT));
+                GC_SAFEPOINT();
                 INC_PC(4);
                 break;
             }
@@ -797,12 +874,14 @@ void VirtualMachine::run()
 
 void VirtualMachine::interpret(const char *file, const std::vector<std::string> &argv)
 {
+    // Set the heap growth factor.
+    heap->growth_factor = logger->gc_growth;
     // Compile the code.
     Compiler compiler = Compiler(this->program);
     reg_t main = compiler.compile(file);
     if (logger->show_references) this->program->memory->show_refs();
     // Call the main function.
-    const std::shared_ptr<nfun_t> &callee = GETV((this->program->main_frame.registers.get() + main)->value, std::shared_ptr<nfun_t>);
+    nfun_t *callee = GETV((this->program->main_frame.registers + main)->value, nfun_t *);
     // Push the argv of the main function.
     nlist_t args;
     for (const std::string arg : argv) {
@@ -816,6 +895,33 @@ void VirtualMachine::interpret(const char *file, const std::vector<std::string>
     PC = BASE_PC + callee->index;
     // Run the compiled code.
     this->run();
+    // Show the heap statistics.
+    if (logger->gc_stats) heap->report();
+    // Show the memoization statistics (in the order of the functions in the code).
+    if (logger->memo_stats) {
+        std::vector<std::pair<size_t, const MemoTable *>> tables;
+        for (const auto &[entry, table] : this->memo_tables) tables.push_back({ entry, &table });
+        std::sort(tables.begin(), tables.end());
+        printf("Memoization statistics:\n");
+        for (const auto &[entry, table] : tables) table->report();
+    }
+}
+
+void VirtualMachine::collect_garbage()
+{
+    heap->collect([this]() {
+        // Mark the values in the stack.
+        for (Value *value = this->stack; value < this->top_stack; value++) heap->mark(*value);
+        // Mark the registers of the active frames.
+        for (Frame *frame = this->frames; frame <= this->active_frame; frame++) {
+            for (registers_size_t i = 0; i < frame->registers_size; i++) heap->mark(frame->registers[i]);
+        }
+        // Mark the global registers.
+        const Frame &main_frame = this->program->main_frame;
+        for (registers_size_t i = 0; i < main_frame.registers_size; i++) heap->mark(main_frame.registers[i]);
+        // Mark the constants.
+        for (const Value &constant : this->program->memory->constants) heap->mark(constant);
+    });
 }
 
 /*